@@ -41,6 +41,9 @@ private:
    * 	- set the MVP matrix in a second configuration
    * 	- send its values to the corresponding uniform
    * 	- do the second draw call
+   *
+   * Once this works, the two draws may be merged into one with VAO::drawInstanced, the two
+   * MVP matrices then being per-instance attributes (see VAO::setInstanceVBO and rubik/RubikRenderer.cpp).
    */
   void renderFrame() override;
 
@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include "ObjLoader.hpp"
+#include "TextureCache.hpp"
 #include "utils.hpp"
 
 PA4Application::RenderObject::RenderObject(const std::shared_ptr<Program> & program, const glm::mat4 & modelWorld) : m_program(program), m_mw(modelWorld)
@@ -117,25 +118,23 @@ void PA4Application::RenderObject::loadWavefront(const std::string & objname)
 {
   ObjLoader objLoader(objname);
   const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vextexPositions = objLoader.vertexPositions();
-  const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
+  std::span<const glm::vec3> vextexPositions = objLoader.vertexPositions();
+  std::span<const glm::vec2> vertexUVs = objLoader.vertexUVs();
   // set up the VBOs of the master VAO
   std::shared_ptr<VAO> vao(new VAO(2));
   vao->setVBO(0, vextexPositions);
   vao->setVBO(1, vertexUVs);
   size_t nbParts = objLoader.nbIBOs();
   for (size_t k = 0; k < nbParts; k++) {
-    const std::vector<uint> & ibo = objLoader.ibo(k);
-    if (ibo.size() == 0) {
+    ObjLoader::IndexSpan ibo = objLoader.ibo(k);
+    if (std::visit([](auto indices) { return indices.empty(); }, ibo)) {
       continue;
     }
     std::shared_ptr<VAO> vaoSlave;
     vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
+    std::visit([&vaoSlave](auto indices) { vaoSlave->setIBO(indices); }, ibo);
     const SimpleMaterial & material = materials[k];
-    Image<> colorMap = objLoader.image(material.diffuseTexName);
-    std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-    texture->setData(colorMap);
+    std::shared_ptr<Texture> texture = TextureCache::shared().texture(objLoader, material.diffuseTexName);
     m_parts.push_back(RenderObjectPart(vaoSlave, m_program, material.diffuse, texture));
   }
   m_colormap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -281,7 +280,7 @@ void PA4Application::RenderObjectPart::draw(Sampler * colormap)
     colormap->attachToProgram(*m_program, "colorSampler", Sampler::DoNotBind);
   } else {
     const int unit = 0;
-    glActiveTexture(GL_TEXTURE0 + unit);
+    GLState::shared().activeTexture(unit);
     m_texture->bind();
     m_program->setUniform("colorSampler", unit);
   }
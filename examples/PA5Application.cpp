@@ -2,48 +2,93 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "PA5Application.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <glm/ext.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include "AssetLoader.hpp"
 #include "ObjLoader.hpp"
+#include "ProgramCache.hpp"
 #include "stb_image.h"
 #include "utils.hpp"
 
-PA5Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld)
+namespace
 {
-  m_diffusemap = std::unique_ptr<Sampler>(new Sampler(0));
-  m_normalmap = std::unique_ptr<Sampler>(new Sampler(1));
-  m_specularmap = std::unique_ptr<Sampler>(new Sampler(2));
+/// the interleaved attributes of the vertices drawn by shaders/simplemat.v.glsl
+VertexLayout simpleMaterialLayout()
+{
+  VertexLayout layout;
+  layout.add<glm::vec3>(0).add<glm::vec2>(1).add<glm::vec3>(2).add<glm::vec3>(3);
+  return layout;
+}
+
+/// appends the bytes of a value to interleaved vertices
+template <typename T> void appendBytes(std::vector<char> & vertices, const T & value)
+{
+  const char * bytes = reinterpret_cast<const char *>(&value);
+  vertices.insert(vertices.end(), bytes, bytes + sizeof(T));
+}
+} // namespace
+
+PA5Application::RenderObject::RenderObject(const glm::mat4 & modelWorld) : m_mw(modelWorld) {}
+
+void PA5Application::RenderObject::setSamplers(SamplerSettings settings)
+{
+  m_diffusemap = sharedSampler(0, settings);
+  m_normalmap = sharedSampler(1, settings);
+  m_specularmap = sharedSampler(2, settings);
+}
+
+std::shared_ptr<Sampler> PA5Application::RenderObject::sharedSampler(int unit, SamplerSettings settings)
+{
+  // the objects with the same settings share their samplers, so that their draws are grouped in the multi draw batch
+  static std::map<std::pair<int, SamplerSettings>, std::weak_ptr<Sampler>> samplers;
+  std::weak_ptr<Sampler> & cached = samplers[{unit, settings}];
+  std::shared_ptr<Sampler> sampler = cached.lock();
+  if (sampler) {
+    return sampler;
+  }
+  sampler = std::make_shared<Sampler>(unit);
+  if (settings == SamplerSettings::Wavefront) {
+    sampler->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    sampler->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    sampler->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    sampler->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+  } else if (unit == 0) {
+    sampler->enableAnisotropicFiltering();
+  }
+  cached = sampler;
+  return sampler;
 }
 
-std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createCheckerBoardPlaneInstance(const glm::mat4 & modelWorld)
+std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createCheckerBoardPlaneInstance(const glm::mat4 & modelWorld, MultiDrawBatch * batch)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
-  std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
   Image<> rgbMapImage;
   std::string rgbFilename = absolutename("meshes/checkerboardRGB.png");
   rgbMapImage.data = stbi_load(rgbFilename.c_str(), &rgbMapImage.width, &rgbMapImage.height, &rgbMapImage.channels, STBI_default);
-  texture->setData(rgbMapImage, true);
-
-  std::shared_ptr<Texture> stexture(new Texture(GL_TEXTURE_2D));
-  stexture->setData(rgbMapImage, true);
+  std::vector<char> rgbMap = compressTexture(rgbMapImage, TextureFormat::RGBA8);
 
-  std::shared_ptr<Texture> ntexture(new Texture(GL_TEXTURE_2D));
   Image<> normalMapImage;
   std::string nmFilename = absolutename("meshes/checkerboardNM.png");
   normalMapImage.data = stbi_load(nmFilename.c_str(), &normalMapImage.width, &normalMapImage.height, &normalMapImage.channels, STBI_default);
-  ntexture->setData(normalMapImage, true);
+  std::vector<char> normalMap = compressTexture(normalMapImage, TextureFormat::RGBA8);
 
-  object->m_diffusemap->enableAnisotropicFiltering();
+  // the specular map is the color map: both maps are packed in a single layer
+  BakedTexture rgbLayer{TextureFormat::RGBA8, {BakedTextureLevel{rgbMapImage.width, rgbMapImage.height, rgbMap}}};
+  BakedTexture normalLayer{TextureFormat::RGBA8, {BakedTextureLevel{normalMapImage.width, normalMapImage.height, normalMap}}};
+  std::vector<TextureArrayLayer> layers = packTextureArrays({rgbFilename, nmFilename, rgbFilename}, {rgbLayer, normalLayer, rgbLayer}, true);
 
-  std::shared_ptr<Program> program(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
+  object->setSamplers(SamplerSettings::CheckerBoard);
+
+  std::shared_ptr<Program> program = simpleMaterialProgram();
+  object->setupProgram(program);
   SimpleMaterial material;
   material.name = "checkerboard";
   material.ambient = {0.1, 0.1, 0.1};
   material.diffuse = {0.5, 0.5, 0.5};
   material.specular = {1, 1, 1};
   material.shininess = 90;
-  object->setProgramMaterial(program, material);
   std::shared_ptr<VAO> vao(new VAO(4));
   std::vector<glm::vec3> vertexPositions = {{-0.5, -0.5, 0}, {0.5, -0.5, 0}, {0.5, 0.5, 0}, {-0.5, 0.5, 0}};
   std::vector<glm::vec2> vertexUVs = {{0, 0}, {0, 40}, {40, 40}, {40, 0}};
@@ -60,106 +105,195 @@ std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::crea
   vao->setVBO(3, vertexTangents);
   vao->setIBO(ibo);
 
-  object->m_parts.emplace_back(vao, program, texture, ntexture, stexture);
+  uint mesh = 0;
+  if (batch) {
+    std::vector<char> vertices;
+    for (size_t k = 0; k < vertexPositions.size(); k++) {
+      appendBytes(vertices, vertexPositions[k]);
+      appendBytes(vertices, vertexUVs[k]);
+      appendBytes(vertices, vertexNormals[k]);
+      appendBytes(vertices, vertexTangents[k]);
+    }
+    mesh = batch->addMesh(batch->addVertices(vertices), std::span<const uint>(ibo));
+  }
+  BoundingVolume bounds = boundingVolume(std::span<const glm::vec3>(vertexPositions), std::span<const uint>(ibo));
+  object->m_parts.emplace_back(vao, program, material, layers[0], layers[1], layers[2], bounds, mesh);
   return object;
 }
 
-void PA5Application::RenderObject::draw()
+void PA5Application::RenderObject::addBounds(FrustumCuller & culler)
+{
+  // the volumes of the parts are consecutive
+  m_firstVolume = 0;
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    size_t volume = culler.add(m_parts[k].bounds(), m_mw);
+    if (k == 0) {
+      m_firstVolume = volume;
+    }
+  }
+}
+
+void PA5Application::RenderObject::submit(RenderQueue & queue, const glm::mat4 & view, const FrustumCuller & culler) const
 {
-  m_diffusemap->bind();
-  m_normalmap->bind();
-  m_specularmap->bind();
-  for (auto & part : m_parts) {
-    part.draw(m_diffusemap.get(), m_normalmap.get(), m_specularmap.get());
+  const Sampler * samplers[3] = {m_diffusemap.get(), m_normalmap.get(), m_specularmap.get()};
+  // the parts share the origin of the object
+  float depth = -(view * m_mw * glm::vec4(0, 0, 0, 1)).z;
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    if (culler.visible(m_firstVolume + k)) {
+      m_parts[k].submit(queue, samplers, m_mw, depth);
+    }
   }
-  m_diffusemap->unbind();
-  m_normalmap->unbind();
-  m_specularmap->unbind();
 }
 
-void PA5Application::RenderObject::update(const glm::mat4 & proj, const glm::mat4 & view)
+void PA5Application::RenderObject::addDraws(MultiDrawBatch & batch, TextureGroups & groups, Std140Writer & writer, const FrustumCuller & culler) const
 {
-  for (auto & part : m_parts) {
-    part.update(proj, view, m_mw, displayNormals);
+  const Sampler * samplers[3] = {m_diffusemap.get(), m_normalmap.get(), m_specularmap.get()};
+  for (size_t k = 0; k < m_parts.size(); k++) {
+    if (culler.visible(m_firstVolume + k)) {
+      m_parts[k].addDraw(batch, groups, samplers, m_mw, writer);
+    }
   }
 }
 
-std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld)
+void PA5Application::RenderObject::setModelWorld(const glm::mat4 & modelWorld)
+{
+  m_mw = modelWorld;
+}
+
+std::unique_ptr<PA5Application::RenderObject> PA5Application::RenderObject::createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld, MultiDrawBatch * batch)
 {
   std::unique_ptr<RenderObject> object(new RenderObject(modelWorld));
-  object->loadWavefront(objname);
+  object->loadWavefront(objname, batch);
   return object;
 }
 
-void PA5Application::RenderObject::setProgramMaterial(std::shared_ptr<Program> & program, const SimpleMaterial & material) const
+std::shared_ptr<Program> PA5Application::RenderObject::simpleMaterialProgram()
 {
+  // a single program is compiled and linked for all the parts of all the objects
+  return ProgramCache::shared().program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl");
+}
+
+void PA5Application::RenderObject::setupProgram(const std::shared_ptr<Program> & program) const
+{
+  program->setUniformBlockBinding("Camera", cameraBlockBinding);
+  program->setUniformBlockBinding("Lights", lightsBlockBinding);
   program->bind();
-  program->setUniform("lightsInWorld[0].direction", glm::normalize(glm::vec3(0, -1, 1)));
-  program->setUniform("lightsInWorld[0].intensity", glm::vec3(0.7, 0.7, 0.7));
-  program->setUniform("lightsInWorld[1].direction", glm::normalize(glm::vec3(0, 1, 0.5)));
-  program->setUniform("lightsInWorld[1].intensity", glm::vec3(0.5, 0.5, 0.5));
-  program->setUniform("lightsInWorld[2].direction", glm::normalize(glm::vec3(-1, 0, 1)));
-  program->setUniform("lightsInWorld[2].intensity", glm::vec3(0.6, 0.6, 0.6));
-  program->setUniform("material.ambient", material.ambient);
-  program->setUniform("material.diffuse", material.diffuse);
-  program->setUniform("material.specular", material.specular);
-  program->setUniform("material.shininess", material.shininess);
   m_diffusemap->attachToProgram(*program, "material.colormap", Sampler::DoNotBind);
   m_normalmap->attachToProgram(*program, "material.normalmap", Sampler::DoNotBind);
   m_specularmap->attachToProgram(*program, "material.specularmap", Sampler::DoNotBind);
   program->unbind();
 }
 
-void PA5Application::RenderObject::loadWavefront(const std::string & objname)
+void PA5Application::RenderObject::loadWavefront(const std::string & objname, MultiDrawBatch * batch)
 {
   ObjLoader objLoader(objname);
+  WavefrontParts parts = readWavefront(objLoader);
+  prepareWavefront(parts, batch);
+  while (not uploadTextureArray(parts)) {
+  }
+  for (size_t p = 0; p < parts.drawnParts.size(); p++) {
+    addWavefrontPart(objLoader, parts, p);
+  }
+}
+
+std::shared_future<void> PA5Application::RenderObject::loadWavefrontInstance(AssetLoader & loader, const std::string & objname, const glm::mat4 & modelWorld, MultiDrawBatch * batch,
+                                                                             std::vector<std::unique_ptr<RenderObject>> & objects)
+{
+  std::vector<std::unique_ptr<RenderObject>> * target = &objects;
+  return loader.load([objname, modelWorld, batch, target]() -> AssetLoader::UploadStep {
+    // parsed, interleaved, converted and hashed on the loader thread
+    std::shared_ptr<ObjLoader> objLoader = std::make_shared<ObjLoader>(objname);
+    struct Progress {
+      std::unique_ptr<RenderObject> created;
+      RenderObject * object = nullptr;
+      WavefrontParts parts;
+      size_t nextPart = 0;
+    };
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+    progress->parts = readWavefront(*objLoader);
+    // uploaded on the render thread: first the geometry, then an array texture at each step, then a part at each step
+    return [objLoader, progress, modelWorld, batch, target]() {
+      if (not progress->object) {
+        progress->created.reset(new RenderObject(modelWorld));
+        progress->object = progress->created.get();
+        progress->object->prepareWavefront(progress->parts, batch);
+        return false;
+      }
+      if (progress->created) {
+        if (not uploadTextureArray(progress->parts)) {
+          return false;
+        }
+        target->push_back(std::move(progress->created));
+      } else {
+        progress->object->addWavefrontPart(*objLoader, progress->parts, progress->nextPart++);
+      }
+      return progress->nextPart == progress->parts.drawnParts.size();
+    };
+  });
+}
+
+PA5Application::RenderObject::WavefrontParts PA5Application::RenderObject::readWavefront(const ObjLoader & objLoader)
+{
+  // no OpenGL call: this may run on the loader thread
   const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vertexPositions = objLoader.vertexPositions();
-  const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
-  std::vector<glm::vec3> vertexNormals = objLoader.vertexNormals();
-  std::vector<glm::vec3> vertexTangents = objLoader.vertexTangents();
-  // set up the VBOs of the master VAO
-  std::shared_ptr<VAO> vao(new VAO(4));
-  vao->setVBO(0, vertexPositions);
-  vao->setVBO(1, vertexUVs);
-  vao->setVBO(2, vertexNormals);
-  vao->setVBO(3, vertexTangents);
+  WavefrontParts parts;
+  parts.vertices = objLoader.interleavedVertices({VertexAttribute::Position, VertexAttribute::UV, VertexAttribute::Normal, VertexAttribute::Tangent});
   size_t nbParts = objLoader.nbIBOs();
+  std::vector<std::string> textureNames;
   for (size_t k = 0; k < nbParts; k++) {
-    const std::vector<uint> & ibo = objLoader.ibo(k);
-    if (ibo.size() == 0) {
-      continue;
+    if (not std::visit([](auto indices) { return indices.empty(); }, objLoader.ibo(k))) {
+      parts.drawnParts.push_back(k);
+      textureNames.insert(textureNames.end(), {materials[k].diffuseTexName, materials[k].normalTexName, materials[k].specularTexName});
     }
-    std::shared_ptr<VAO> vaoSlave;
-    vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
-
-    std::shared_ptr<Program> program(new Program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl"));
-    const SimpleMaterial & material = materials[k];
-    setProgramMaterial(program, material);
-    Image<> colorMap = objLoader.image(material.diffuseTexName);
-    std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-    texture->setData(colorMap);
-    Image<> normalMap = objLoader.image(material.normalTexName);
-    std::shared_ptr<Texture> ntexture(new Texture(GL_TEXTURE_2D));
-    ntexture->setData(normalMap);
-    Image<> specularMap = objLoader.image(material.specularTexName);
-    std::shared_ptr<Texture> stexture(new Texture(GL_TEXTURE_2D));
-    stexture->setData(specularMap);
-    m_parts.emplace_back(vaoSlave, program, texture, ntexture, stexture);
   }
-  m_diffusemap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_diffusemap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_diffusemap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_diffusemap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
-  m_normalmap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_normalmap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_normalmap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_normalmap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
-  m_specularmap->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  m_specularmap->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  m_specularmap->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-  m_specularmap->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // the maps of the same size are packed in the same array texture, so that consecutive parts share their textures
+  parts.textures = planTextureArrays(objLoader, textureNames);
+  return parts;
+}
+
+void PA5Application::RenderObject::prepareWavefront(WavefrontParts & parts, MultiDrawBatch * batch)
+{
+  // set up the master VAO with a single interleaved VBO (position, uv, normal, tangent)
+  parts.vao = std::make_shared<VAO>(4);
+  parts.vao->setInterleavedVBO(simpleMaterialLayout(), parts.vertices);
+  if (batch) {
+    parts.batch = batch;
+    parts.baseVertex = batch->addVertices(parts.vertices);
+  }
+  std::vector<char>().swap(parts.vertices);
+  setSamplers(SamplerSettings::Wavefront);
+  parts.program = simpleMaterialProgram();
+  setupProgram(parts.program);
+}
+
+bool PA5Application::RenderObject::uploadTextureArray(WavefrontParts & parts)
+{
+  if (parts.arrays.size() < parts.textures.arrays.size()) {
+    parts.arrays.push_back(::uploadTextureArray(parts.textures, parts.arrays.size()));
+  }
+  if (parts.arrays.size() < parts.textures.arrays.size()) {
+    return false;
+  }
+  if (parts.layers.empty()) {
+    parts.layers = textureArrayLayers(parts.textures, parts.arrays);
+  }
+  return true;
+}
+
+void PA5Application::RenderObject::addWavefrontPart(const ObjLoader & objLoader, const WavefrontParts & parts, size_t p)
+{
+  std::shared_ptr<VAO> vaoSlave;
+  vaoSlave = parts.vao->makeSlaveVAO();
+  std::visit([&vaoSlave](auto indices) { vaoSlave->setIBO(indices); }, objLoader.ibo(parts.drawnParts[p]));
+
+  uint mesh = 0;
+  if (parts.batch) {
+    std::visit([&parts, &mesh](auto indices) { mesh = parts.batch->addMesh(parts.baseVertex, indices); }, objLoader.ibo(parts.drawnParts[p]));
+  }
+
+  const SimpleMaterial & material = objLoader.materials()[parts.drawnParts[p]];
+  const BoundingVolume & bounds = objLoader.partBounds(parts.drawnParts[p]);
+  m_parts.emplace_back(vaoSlave, parts.program, material, parts.layers[3 * p], parts.layers[3 * p + 1], parts.layers[3 * p + 2], bounds, mesh);
 }
 
 bool PA5Application::displayNormals;
@@ -171,22 +305,46 @@ PA5Application::PA5Application(int windowWidth, int windowHeight) : Application(
   resize(window, windowWidth, windowHeight);
   computeView(true);
   glEnable(GL_DEPTH_TEST);
+  // three directional lights (defined in world space), shared by all the programs
+  Std140Writer lights;
+  lights.beginStruct().add(glm::normalize(glm::vec3(0, -1, 1))).add(glm::vec3(0.7, 0.7, 0.7)).endStruct();
+  lights.beginStruct().add(glm::normalize(glm::vec3(0, 1, 0.5))).add(glm::vec3(0.5, 0.5, 0.5)).endStruct();
+  lights.beginStruct().add(glm::normalize(glm::vec3(-1, 0, 1))).add(glm::vec3(0.6, 0.6, 0.6)).endStruct();
+  m_lightsBlock = std::make_unique<UniformBuffer>(lightsBlockBinding, lights.data().size());
+  m_lightsBlock->setData(lights.data());
+  updateCamera();
+  if (MultiDrawBatch::supported()) {
+    // all the parts of all the objects are also added to a single batch, drawn with a few multi draw calls
+    m_batch = std::make_unique<MultiDrawBatch>(simpleMaterialLayout(), drawIndexAttribute, materialsBlockBinding, drawMaterialSize);
+    m_batchProgram = ProgramCache::shared().program("shaders/simplemat.v.glsl", "shaders/simplemat.f.glsl", {"MULTI_DRAW"});
+    m_batchProgram->setUniformBlockBinding("Camera", cameraBlockBinding);
+    m_batchProgram->setUniformBlockBinding("Lights", lightsBlockBinding);
+    m_batchProgram->setStorageBlockBinding("Materials", materialsBlockBinding);
+    // the samplers of all the objects use the units 0, 1 and 2 (see RenderObject::RenderObject)
+    m_batchProgram->bind();
+    m_batchProgram->setUniform("material.colormap", 0);
+    m_batchProgram->setUniform("material.normalmap", 1);
+    m_batchProgram->setUniform("material.specularmap", 2);
+    m_batchProgram->unbind();
+    m_multiDraw = true;
+  }
   glm::mat4 mw(1);
   mw = glm::translate(mw, {0, 1.1, 0});
   mw = glm::scale(mw, glm::vec3(50, 50, 0.1));
-  m_objects.push_back(RenderObject::createCheckerBoardPlaneInstance(mw));
+  m_objects.push_back(RenderObject::createCheckerBoardPlaneInstance(mw, m_batch.get()));
   const float pi = glm::pi<float>();
   mw = glm::mat4(1);
   mw = glm::translate(mw, {1., 0, 0});
   mw = glm::rotate(mw, -pi / 2, {1, 0, 0});
   mw = glm::rotate(mw, -5 * pi / 6, {0, 1, 0});
   mw = glm::scale(mw, glm::vec3(0.25));
-  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Tron/TronLightCycle.obj", mw));
+  // the wavefront objects are parsed in the background, and appear as soon as they are uploaded
+  m_loadingObjects.push_back(RenderObject::loadWavefrontInstance(assetLoader(), "meshes/Tron/TronLightCycle.obj", mw, m_batch.get(), m_objects));
   // m_objects.push_back(RenderObject::createWavefrontInstance("tmp/tron.glitter", mw)); // TODO : Check this
   mw = glm::mat4(1);
   mw = glm::translate(mw, {2, 1, -0.1});
   mw = glm::rotate(mw, pi, {1, 0, 0});
-  m_objects.push_back(RenderObject::createWavefrontInstance("meshes/Pallet/Bswap_HPBake_Planks.obj", mw));
+  m_loadingObjects.push_back(RenderObject::loadWavefrontInstance(assetLoader(), "meshes/Pallet/Bswap_HPBake_Planks.obj", mw, m_batch.get(), m_objects));
   // m_objects.push_back(RenderObject::createWavefrontInstance("tmp/pallet.glitter", mw)); // TODO : Check this
 }
 
@@ -205,7 +363,10 @@ void PA5Application::usage(std::string & shortDescription, std::string & synopsi
                 "  The following key bindings are available to interact with thi application:\n"
                 "     <up> / <down>    increase / decrease latitude angle of the camera position\n"
                 "     <left> / <right> increase / decrease longitude angle of the camera position\n"
-                "     R                reset the view\n";
+                "     R                reset the view\n"
+                "     M                toggle the multi draw indirect batch (when supported) and the sorted render queue\n"
+                "     S                print the OpenGL bindings, state changes and culled parts of the last frame\n"
+                "  Setting the GLITTER_VALIDATE_GL_STATE environment variable checks the OpenGL bindings skipped by the GLState (slow).\n";
 }
 
 void PA5Application::renderFrame()
@@ -213,9 +374,48 @@ void PA5Application::renderFrame()
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT);
   glClear(GL_DEPTH_BUFFER_BIT);
+  cullParts();
+  if (m_multiDraw) {
+    drawBatch();
+    return;
+  }
+  for (auto & object : m_objects) {
+    object->submit(m_renderQueue, m_view, m_culler);
+  }
+  m_renderQueue.execute();
+}
+
+void PA5Application::cullParts()
+{
+  // the parts of all the objects are tested at once, before any of them is submitted
+  m_culler.begin(m_proj * m_view);
   for (auto & object : m_objects) {
-    object->draw();
+    object->addBounds(m_culler);
   }
+  m_culler.cull();
+}
+
+void PA5Application::drawBatch()
+{
+  TextureGroups groups;
+  m_batch->clear();
+  for (auto & object : m_objects) {
+    object->addDraws(*m_batch, groups, m_materialWriter, m_culler);
+  }
+  m_batch->upload();
+  // a single multi draw call per texture set
+  m_batchProgram->bind();
+  for (const auto & [textures, group] : groups) {
+    for (const RenderQueue::TextureBinding & binding : textures) {
+      if (binding.sampler) {
+        binding.sampler->bind();
+        binding.sampler->attachTexture(*binding.texture);
+      }
+    }
+    m_batch->draw(group);
+  }
+  m_batchProgram->unbind();
+  m_batchCalls = groups.size();
 }
 
 void PA5Application::update()
@@ -224,8 +424,16 @@ void PA5Application::update()
   m_currentTime = glfwGetTime();
   m_deltaTime = m_currentTime - prevTime;
   continuousKey();
-  for (auto & object : m_objects) {
-    object->update(m_proj, m_view);
+  updateCamera();
+  if (not m_loadingObjects.empty() and std::all_of(m_loadingObjects.begin(), m_loadingObjects.end(), [](const std::shared_future<void> & loading) {
+        return loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+      })) {
+    m_loadingObjects.clear();
+    const TextureCache::Statistics & statistics = TextureCache::shared().statistics();
+    std::cout << "Texture cache: " << statistics.hits << " hits, " << statistics.misses << " misses, " << statistics.uploadedBytes / (1024 * 1024) << " MB sent, "
+              << statistics.savedBytes / (1024 * 1024) << " MB saved" << std::endl;
+    const ProgramCache::Statistics & programs = ProgramCache::shared().statistics();
+    std::cout << "Program cache: " << programs.hits << " hits, " << programs.misses << " misses" << std::endl;
   }
 }
 
@@ -242,6 +450,17 @@ void PA5Application::computeView(bool reset)
   m_view = glm::lookAt(eyePos, center, up);
 }
 
+void PA5Application::updateCamera()
+{
+  m_cameraWriter.clear();
+  m_cameraWriter.add(m_view).add(m_proj).add(glm::vec3(glm::inverse(m_view) * glm::vec4(0, 0, 0, 1))).add(displayNormals);
+  if (not m_cameraBlock) {
+    m_cameraBlock = std::make_unique<UniformBuffer>(cameraBlockBinding, m_cameraWriter.data().size());
+  }
+  // a single update per frame, whatever the number of parts
+  m_cameraBlock->setData(m_cameraWriter.data());
+}
+
 void PA5Application::continuousKey()
 {
   GLFWwindow * window = glfwGetCurrentContext();
@@ -285,36 +504,83 @@ void PA5Application::keyCallback(GLFWwindow * window, int key, int /*scancode*/,
       displayNormals = not displayNormals;
     }
     break;
+  case 'M':
+    if (action == GLFW_PRESS and app.m_batch) {
+      app.m_multiDraw = not app.m_multiDraw;
+    }
+    break;
+  case 'S':
+    if (action == GLFW_PRESS) {
+      const GLState::Statistics & statistics = GLState::shared().lastFrame();
+      std::cout << "GL state: " << statistics.calls << " bindings sent, " << statistics.avoided << " avoided" << std::endl;
+      const FrustumCuller::Statistics & culling = app.m_culler.lastFrame();
+      std::cout << "Frustum culling: " << culling.visible << " parts visible, " << culling.culled << " culled" << std::endl;
+      if (app.m_multiDraw) {
+        std::cout << "Multi draw: " << app.m_batch->nbDraws() << " draws in " << app.m_batchCalls << " calls" << std::endl;
+      } else {
+        const RenderQueue::Statistics & queue = app.m_renderQueue.lastFrame();
+        std::cout << "Render queue: " << queue.packets << " draw calls, " << queue.sortedChanges << " state changes (" << queue.unsortedChanges << " unsorted)" << std::endl;
+      }
+    }
+    break;
   }
 }
 
-PA5Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture,
-                                                   std::shared_ptr<Texture> stexture)
-    : m_vao(vao), m_program(program), m_diffuseTexture(texture), m_normalTexture(ntexture), m_specularTexture(stexture)
+PA5Application::RenderObjectPart::RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, const SimpleMaterial & material, const TextureArrayLayer & texture,
+                                                   const TextureArrayLayer & ntexture, const TextureArrayLayer & stexture, const BoundingVolume & bounds, uint mesh)
+    : m_vao(vao), m_program(program), m_diffuseTexture(texture.texture), m_normalTexture(ntexture.texture), m_specularTexture(stexture.texture), m_ambient(material.ambient),
+      m_diffuse(material.diffuse), m_specular(material.specular), m_shininess(material.shininess), m_layers{texture.layer, ntexture.layer, stexture.layer}, m_bounds(bounds), m_mesh(mesh)
 {
+  m_mUniform = m_program->uniformHandle<glm::mat4>("M");
+  m_ambientUniform = m_program->uniformHandle<glm::vec3>("material.ambient");
+  m_diffuseUniform = m_program->uniformHandle<glm::vec3>("material.diffuse");
+  m_specularUniform = m_program->uniformHandle<glm::vec3>("material.specular");
+  m_shininessUniform = m_program->uniformHandle<float>("material.shininess");
+  m_layerUniforms[0] = m_program->uniformHandle<int>("material.colormapLayer");
+  m_layerUniforms[1] = m_program->uniformHandle<int>("material.normalmapLayer");
+  m_layerUniforms[2] = m_program->uniformHandle<int>("material.specularmapLayer");
 }
 
-void PA5Application::RenderObjectPart::draw(Sampler * colormap, Sampler * normalmap, Sampler * specularmap)
+const BoundingVolume & PA5Application::RenderObjectPart::bounds() const
 {
-  m_program->bind();
-  colormap->attachTexture(*m_diffuseTexture);
-  normalmap->attachTexture(*m_normalTexture);
-  specularmap->attachTexture(*m_specularTexture);
-  m_vao->draw();
-  m_program->unbind();
+  return m_bounds;
+}
+
+void PA5Application::RenderObjectPart::submit(RenderQueue & queue, const Sampler * samplers[3], const glm::mat4 & mw, float depth) const
+{
+  RenderQueue::Packet packet;
+  packet.program = m_program.get();
+  const Texture * textures[3] = {m_diffuseTexture.get(), m_normalTexture.get(), m_specularTexture.get()};
+  for (int k = 0; k < 3; k++) {
+    packet.textures[k] = {samplers[k], textures[k]};
+  }
+  packet.vao = m_vao.get();
+  packet.depth = depth;
+  // the program is shared: the object and the material are per-draw uniforms
+  const glm::mat4 * modelWorld = &mw;
+  packet.setUniforms = [this, modelWorld](const Program & program) {
+    program.setUniform(m_mUniform, *modelWorld);
+    program.setUniform(m_ambientUniform, m_ambient);
+    program.setUniform(m_diffuseUniform, m_diffuse);
+    program.setUniform(m_specularUniform, m_specular);
+    program.setUniform(m_shininessUniform, m_shininess);
+    for (int k = 0; k < 3; k++) {
+      program.setUniform(m_layerUniforms[k], m_layers[k]);
+    }
+  };
+  queue.submit(std::move(packet));
 }
 
-void PA5Application::RenderObjectPart::update(const glm::mat4 & proj, const glm::mat4 & view, const glm::mat4 & mw, bool displayNormals)
+void PA5Application::RenderObjectPart::addDraw(MultiDrawBatch & batch, TextureGroups & groups, const Sampler * samplers[3], const glm::mat4 & mw, Std140Writer & writer) const
 {
-  m_program->bind();
-  m_program->setUniform("M", mw);
-  m_program->setUniform("V", view);
-  m_program->setUniform("P", proj);
-  m_program->setUniform("positionCameraInWorld", glm::vec3(glm::inverse(view) * glm::vec4(0, 0, 0, 1)));
-  if (displayNormals) {
-    m_program->setUniform("displayNormals", 1);
-  } else {
-    m_program->setUniform("displayNormals", 0);
+  std::array<RenderQueue::TextureBinding, RenderQueue::nbTextures> textures;
+  const Texture * maps[3] = {m_diffuseTexture.get(), m_normalTexture.get(), m_specularTexture.get()};
+  for (int k = 0; k < 3; k++) {
+    textures[k] = {samplers[k], maps[k]};
   }
-  m_program->unbind();
+  uint group = groups.emplace(textures, groups.size()).first->second;
+  // laid out like the DrawMaterial struct of shaders/simplemat.v.glsl
+  writer.clear();
+  writer.beginStruct().add(mw).add(m_ambient).add(m_shininess).add(m_diffuse).add(m_layers[0]).add(m_specular).add(m_layers[1]).add(m_layers[2]).endStruct();
+  batch.addDraw(m_mesh, group, writer.data());
 }
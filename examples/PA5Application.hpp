@@ -1,12 +1,20 @@
 #ifndef __PA5_APPLICATION_H__
 #define __PA5_APPLICATION_H__
+#include <future>
+#include <map>
 #include <memory>
 struct GLFWwindow;
 #include "Application.hpp"
+#include "FrustumCuller.hpp"
+#include "MultiDrawBatch.hpp"
+#include "RenderQueue.hpp"
+#include "TextureArray.hpp"
 #include "glApi.hpp"
 
 // forward declarations
 struct SimpleMaterial;
+class ObjLoader;
+class AssetLoader;
 
 class PA5Application : public Application {
 public:
@@ -24,23 +32,44 @@ private:
   static void keyCallback(GLFWwindow * window, int key, int scancode, int action, int mods);
   void continuousKey();
   void computeView(bool reset = false);
+  void updateCamera();
+  void drawBatch();
+  void cullParts();
 
 private:
+  /// The groups of the draws of a MultiDrawBatch: the draws sharing their samplers and textures (the objects share their samplers, see RenderObject::sharedSampler)
+  typedef std::map<std::array<RenderQueue::TextureBinding, RenderQueue::nbTextures>, uint> TextureGroups;
+
   class RenderObjectPart {
   public:
     RenderObjectPart() = delete;
     RenderObjectPart(const RenderObjectPart &) = delete;
     RenderObjectPart(RenderObjectPart &&) = default;
-    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, std::shared_ptr<Texture> texture, std::shared_ptr<Texture> ntexture, std::shared_ptr<Texture> stexture);
-    void draw(Sampler * colormap, Sampler * normalmap, Sampler * specularmap);
-    void update(const glm::mat4 & proj, const glm::mat4 & view, const glm::mat4 & mw, bool displayNormals);
+    RenderObjectPart(std::shared_ptr<VAO> vao, std::shared_ptr<Program> program, const SimpleMaterial & material, const TextureArrayLayer & texture, const TextureArrayLayer & ntexture,
+                     const TextureArrayLayer & stexture, const BoundingVolume & bounds, uint mesh);
+    const BoundingVolume & bounds() const;
+    void submit(RenderQueue & queue, const Sampler * samplers[3], const glm::mat4 & mw, float depth) const;
+    void addDraw(MultiDrawBatch & batch, TextureGroups & groups, const Sampler * samplers[3], const glm::mat4 & mw, Std140Writer & writer) const;
 
   private:
     std::shared_ptr<VAO> m_vao;
-    std::shared_ptr<Program> m_program;
-    std::shared_ptr<Texture> m_diffuseTexture;
-    std::shared_ptr<Texture> m_normalTexture;
-    std::shared_ptr<Texture> m_specularTexture;
+    std::shared_ptr<Program> m_program;         ///< program shared by all the parts (the material is set before each draw call)
+    std::shared_ptr<Texture> m_diffuseTexture;  ///< array texture holding the diffuse map
+    std::shared_ptr<Texture> m_normalTexture;   ///< array texture holding the normal map
+    std::shared_ptr<Texture> m_specularTexture; ///< array texture holding the specular map
+    glm::vec3 m_ambient;                        ///< ambient color of the material
+    glm::vec3 m_diffuse;                        ///< diffuse color of the material
+    glm::vec3 m_specular;                       ///< specular color of the material
+    float m_shininess;                          ///< shininess of the material
+    int m_layers[3];                            ///< layers of the diffuse, normal and specular maps in their array textures
+    UniformHandle<glm::mat4> m_mUniform;        ///< handle of the modelWorld matrix
+    UniformHandle<glm::vec3> m_ambientUniform;  ///< handle of the ambient color
+    UniformHandle<glm::vec3> m_diffuseUniform;  ///< handle of the diffuse color
+    UniformHandle<glm::vec3> m_specularUniform; ///< handle of the specular color
+    UniformHandle<float> m_shininessUniform;    ///< handle of the shininess
+    UniformHandle<int> m_layerUniforms[3];      ///< handles of the layers of the maps
+    BoundingVolume m_bounds;                    ///< bounds of the part in object space
+    uint m_mesh;                                ///< mesh of the part in the MultiDrawBatch (if any)
   };
 
   /**
@@ -53,56 +82,134 @@ private:
     RenderObject() = delete;
     RenderObject(const RenderObject &) = delete;
 
-    static std::unique_ptr<RenderObject> createCheckerBoardPlaneInstance(const glm::mat4 & modelWorld);
+    static std::unique_ptr<RenderObject> createCheckerBoardPlaneInstance(const glm::mat4 & modelWorld, MultiDrawBatch * batch);
     /**
      * @brief creates an instance from a wavefront file and modelWorld matrix
      * @param objname the filename of the wavefront file
      * @param modelWorld the matrix transform between the object (a.k.a model) space and the world space
+     * @param batch the batch the parts are also added to (nullptr if multi draw indirect is not supported)
      * @return the created RenderObject as a smart pointer
      */
-    static std::unique_ptr<RenderObject> createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld);
+    static std::unique_ptr<RenderObject> createWavefrontInstance(const std::string & objname, const glm::mat4 & modelWorld, MultiDrawBatch * batch);
+
+    /**
+     * @brief loads an instance from a wavefront file in the background
+     * @param loader the asset loader parsing the file
+     * @param objname the filename of the wavefront file
+     * @param modelWorld the matrix transform between the object (a.k.a model) space and the world space
+     * @param batch the batch the parts are also added to (nullptr if multi draw indirect is not supported)
+     * @param objects the render objects the instance is appended to, as soon as its textures are uploaded
+     * @return a future that becomes ready once all the parts of the instance are uploaded
+     *
+     * The parts are uploaded one at a time (see AssetLoader::processUploads), so that the instance appears progressively.
+     */
+    static std::shared_future<void> loadWavefrontInstance(AssetLoader & loader, const std::string & objname, const glm::mat4 & modelWorld, MultiDrawBatch * batch,
+                                                          std::vector<std::unique_ptr<RenderObject>> & objects);
 
     /**
-     * @brief Sets all uniform variables related to material and lighting
-     * @param program
-     * @param material
+     * @brief Sets the uniform variables shared by all the parts (samplers and lighting)
+     * @param program the program shared by the parts
      *
-     * @note Besides the material, three directional lights (defined in world space) are passed to the GLSL program.
+     * @note The Camera and Lights uniform blocks of the program are associated with the uniform buffers of the
+     * application. The material and the modelWorld matrix are set by each part before its draw call.
+     */
+    void setupProgram(const std::shared_ptr<Program> & program) const;
+
+    /**
+     * @brief adds the bounds of the parts of this RenderObject to the volumes of the frame
+     * @param culler the frustum culler of the frame
      */
-    void setProgramMaterial(std::shared_ptr<Program> & program, const SimpleMaterial & material) const;
+    void addBounds(FrustumCuller & culler);
 
     /**
-     * @brief Draw this RenderObject
+     * @brief submits the visible parts of this RenderObject to a render queue
+     * @param queue the render queue of the frame
+     * @param view the worldView matrix (the parts are sorted front to back)
+     * @param culler the frustum culler of the frame, once the volumes added by RenderObject::addBounds are culled
      */
-    void draw();
+    void submit(RenderQueue & queue, const glm::mat4 & view, const FrustumCuller & culler) const;
 
     /**
-     * @brief update the program MVP uniform variable
-     * @param proj the projection matrix
-     * @param view the worldView matrix
+     * @brief adds the visible parts of this RenderObject to the draws of a multi draw batch
+     * @param batch the batch the parts were added to at load time
+     * @param groups the groups of the draws of the frame, by texture set
+     * @param writer scratch space for the materials of the parts
+     * @param culler the frustum culler of the frame, once the volumes added by RenderObject::addBounds are culled
      */
-    void update(const glm::mat4 & proj, const glm::mat4 & view);
+    void addDraws(MultiDrawBatch & batch, TextureGroups & groups, Std140Writer & writer, const FrustumCuller & culler) const;
+
+    /**
+     * @brief moves this RenderObject (the camera and lights are shared by all the objects, see PA5Application::updateCamera)
+     * @param modelWorld the matrix transform between the object (a.k.a model) space and the world space
+     */
+    void setModelWorld(const glm::mat4 & modelWorld);
+
+  private:
+    /// The state shared by the parts of a wavefront object
+    struct WavefrontParts {
+      std::vector<char> vertices;                   ///< the interleaved vertices (released once uploaded)
+      TextureArrayPlan textures;                    ///< the array textures of the maps
+      std::vector<std::shared_ptr<Texture>> arrays; ///< the array textures uploaded so far
+      std::shared_ptr<VAO> vao;                     ///< the master VAO
+      std::shared_ptr<Program> program;             ///< the program shared by the parts
+      std::vector<size_t> drawnParts;               ///< the indices of the non empty parts
+      std::vector<TextureArrayLayer> layers;        ///< the diffuse, normal and specular layers of each drawn part
+      MultiDrawBatch * batch = nullptr;             ///< the batch the parts are added to (if any)
+      int baseVertex = 0;                           ///< the base vertex of the parts in the batch
+    };
+
+    /// The settings of the samplers of the maps
+    enum class SamplerSettings {
+      CheckerBoard, ///< default filtering, anisotropic filtering of the diffuse map
+      Wavefront     ///< linear minification, nearest magnification, repeated coordinates
+    };
 
   private:
     RenderObject(const glm::mat4 & modelWorld);
-    void loadWavefront(const std::string & objname);
+    void setSamplers(SamplerSettings settings);
+    static std::shared_ptr<Sampler> sharedSampler(int unit, SamplerSettings settings);
+    void loadWavefront(const std::string & objname, MultiDrawBatch * batch);
+    static WavefrontParts readWavefront(const ObjLoader & objLoader);
+    void prepareWavefront(WavefrontParts & parts, MultiDrawBatch * batch);
+    static bool uploadTextureArray(WavefrontParts & parts);
+    void addWavefrontPart(const ObjLoader & objLoader, const WavefrontParts & parts, size_t p);
+    static std::shared_ptr<Program> simpleMaterialProgram();
 
   private:
-    glm::mat4 m_mw; ///< modelWorld matrix
+    glm::mat4 m_mw;           ///< modelWorld matrix
+    size_t m_firstVolume = 0; ///< index of the volume of the first part in the FrustumCuller of the frame
     std::vector<RenderObjectPart> m_parts;
-    std::unique_ptr<Sampler> m_diffusemap;
-    std::unique_ptr<Sampler> m_normalmap;
-    std::unique_ptr<Sampler> m_specularmap;
+    std::shared_ptr<Sampler> m_diffusemap;  ///< sampler of the diffuse maps (unit 0, shared by the objects with the same settings)
+    std::shared_ptr<Sampler> m_normalmap;   ///< sampler of the normal maps (unit 1, shared as well)
+    std::shared_ptr<Sampler> m_specularmap; ///< sampler of the specular maps (unit 2, shared as well)
   };
 
 private:
-  std::vector<std::unique_ptr<RenderObject>> m_objects; ///< render objects
-  glm::mat4 m_proj;                                     ///< Projection matrix
-  glm::mat4 m_view;                                     ///< worldView matrix
-  float m_eyePhi;                                       ///< Camera position longitude angle
-  float m_eyeTheta;                                     ///< Camera position latitude angle
-  float m_currentTime;                                  ///< elapsed time since first frame
-  float m_deltaTime;                                    ///< elapsed time since last frame
+  static const uint cameraBlockBinding = 0;    ///< binding point of the Camera uniform block
+  static const uint lightsBlockBinding = 1;    ///< binding point of the Lights uniform block
+  static const uint materialsBlockBinding = 2; ///< binding point of the Materials storage block of the multi draw program
+  static const uint drawIndexAttribute = 4;    ///< anchor point of the draw index of the multi draw program
+  static const size_t drawMaterialSize = 128;  ///< size of the DrawMaterial struct of the multi draw program
+
+private:
+  std::unique_ptr<UniformBuffer> m_cameraBlock;           ///< camera shared by all the programs (updated once per frame)
+  std::unique_ptr<UniformBuffer> m_lightsBlock;           ///< lights shared by all the programs
+  Std140Writer m_cameraWriter;                            ///< packs the camera block
+  RenderQueue m_renderQueue;                              ///< draw calls of the frame, sorted by state
+  std::unique_ptr<MultiDrawBatch> m_batch;                ///< all the parts of all the objects (if multi draw indirect is supported)
+  std::shared_ptr<Program> m_batchProgram;                ///< the program drawing the batch (materials in a storage block)
+  Std140Writer m_materialWriter;                          ///< packs the material of a draw of the batch
+  bool m_multiDraw = false;                               ///< whether the frames are drawn with the batch or with the render queue
+  size_t m_batchCalls = 0;                                ///< multi draw calls of the last frame
+  FrustumCuller m_culler;                                 ///< culls the parts outside the view frustum before they are drawn
+  std::vector<std::unique_ptr<RenderObject>> m_objects;   ///< render objects
+  std::vector<std::shared_future<void>> m_loadingObjects; ///< completion of the render objects loaded in the background
+  glm::mat4 m_proj;                                       ///< Projection matrix
+  glm::mat4 m_view;                                       ///< worldView matrix
+  float m_eyePhi;                                         ///< Camera position longitude angle
+  float m_eyeTheta;                                       ///< Camera position latitude angle
+  float m_currentTime;                                    ///< elapsed time since first frame
+  float m_deltaTime;                                      ///< elapsed time since last frame
 };
 
 #endif // !defined(__PA5_APPLICATION_H__)
@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include "ObjLoader.hpp"
+#include "TextureCache.hpp"
 #include "utils.hpp"
 
 ProjectApplication::ProjectApplication(int windowWidth, int windowHeight)
@@ -27,27 +28,26 @@ void ProjectApplication::loadWavefront(const std::string & objname)
 {
   ObjLoader objLoader(objname);
   const std::vector<SimpleMaterial> & materials = objLoader.materials();
-  std::vector<glm::vec3> vextexPositions = objLoader.vertexPositions();
-  const std::vector<glm::vec2> & vertexUVs = objLoader.vertexUVs();
+  std::span<const glm::vec3> vextexPositions = objLoader.vertexPositions();
+  std::span<const glm::vec2> vertexUVs = objLoader.vertexUVs();
   // set up the VBOs of the master VAO
   std::shared_ptr<VAO> vao(new VAO(2));
   vao->setVBO(0, vextexPositions);
   vao->setVBO(1, vertexUVs);
   size_t nbParts = objLoader.nbIBOs();
   for (size_t k = 0; k < nbParts; k++) {
-    const std::vector<uint> & ibo = objLoader.ibo(k);
-    if (ibo.size() == 0) {
+    ObjLoader::IndexSpan ibo = objLoader.ibo(k);
+    if (std::visit([](auto indices) { return indices.empty(); }, ibo)) {
       continue;
     }
     std::shared_ptr<VAO> vaoSlave;
     vaoSlave = vao->makeSlaveVAO();
-    vaoSlave->setIBO(ibo);
+    std::visit([&vaoSlave](auto indices) { vaoSlave->setIBO(indices); }, ibo);
     m_vaos.push_back(vaoSlave);
     const SimpleMaterial & material = materials[k];
-    Image<> colorMap = objLoader.image(material.diffuseTexName);
-    std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
-    texture->setData(colorMap);
+    std::shared_ptr<Texture> texture = TextureCache::shared().texture(objLoader, material.diffuseTexName);
     m_textures.push_back(texture);
+    m_bounds.push_back(objLoader.partBounds(k));
   }
 }
 
@@ -62,7 +62,15 @@ void ProjectApplication::renderFrame()
     m_colormap->attachToProgram(*m_program, "colorSampler", Sampler::DoNotBind);
     auto mw = glm::mat4(1);
     m_program->setUniform("M",mw);
+    m_culler.begin(m_proj * m_view);
+    for (const BoundingVolume & bounds : m_bounds) {
+        m_culler.add(bounds, mw);
+    }
+    m_culler.cull();
     for(uint k=0; k<m_vaos.size(); ++k){ 
+        if (not m_culler.visible(k)) {
+            continue;
+        }
          auto vao = m_vaos[k];
          auto texture = m_textures[k];
         m_colormap->attachTexture(*texture);
@@ -88,7 +96,8 @@ void ProjectApplication::usage(std::string & shortDescription, std::string & syn
                 "  The following key bindings are available to interact with thi application:\n"
                 "     <up> / <down>    increase / decrease latitude angle of the camera position\n"
                 "     <left> / <right> increase / decrease longitude angle of the camera position\n"
-                "     R                reset the view\n";
+                "     R                reset the view\n"
+                "     S                print the number of visible and culled parts of the last frame\n";
 }
 
 
@@ -145,13 +154,19 @@ void ProjectApplication::resize(GLFWwindow * window, int framebufferWidth, int f
   glViewport(0, 0, framebufferWidth, framebufferHeight);
 }
 
-void ProjectApplication::keyCallback(GLFWwindow * window, int key, int /*scancode*/, int /*action*/, int /*mods*/)
+void ProjectApplication::keyCallback(GLFWwindow * window, int key, int /*scancode*/, int action, int /*mods*/)
 {
   ProjectApplication & app = *static_cast<ProjectApplication *>(glfwGetWindowUserPointer(window));
   switch (key) {
   case 'R':
     app.computeView(true);
     break;
+  case 'S':
+    if (action == GLFW_PRESS) {
+      const FrustumCuller::Statistics & culling = app.m_culler.lastFrame();
+      std::cout << "Frustum culling: " << culling.visible << " parts visible, " << culling.culled << " culled" << std::endl;
+    }
+    break;
   }
 }
 
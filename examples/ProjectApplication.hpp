@@ -3,6 +3,7 @@
 #include <memory>
 struct GLFWwindow;
 #include "Application.hpp"
+#include "FrustumCuller.hpp"
 #include "glApi.hpp"
 
 class ProjectApplication : public Application {
@@ -27,6 +28,8 @@ private:
   std::shared_ptr<Sampler> m_colormap;                  ///< Sampler
   std::vector<std::shared_ptr<VAO>> m_vaos;             ///< list of VAOs
   std::vector<std::shared_ptr<Texture>> m_textures;     ///< list of Textures
+  std::vector<BoundingVolume> m_bounds;                 ///< bounds of the parts drawn by the VAOs
+  FrustumCuller m_culler;                               ///< culls the parts outside the view frustum
   glm::mat4 m_proj;                                     ///< Projection matrix
   glm::mat4 m_view;                                     ///< worldView matrix
   float m_eyePhi;                                       ///< Camera position longitude angle
@@ -1,21 +1,287 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 #include "ObjLoader.hpp"
+#include "Parallel.hpp"
 #include "Serialize.hpp"
+#include "TextureCompression.hpp"
+#include "VertexCompression.hpp"
 #include "utils.hpp"
 
 void printUsage(int /* argc */, char * argv[])
 {
-  std::cout << "Usage: " << argv[0] << " file.obj file.glitter\n";
+  std::cout << "Usage: " << argv[0] << " [--optimize] [--stream] [--compress] [--compress-textures] [--mipmaps|--kaiser-mipmaps] file.obj file.glitter\n"
+            << "       " << argv[0] << " --benchmark file.obj|file.glitter [repetitions]\n"
+            << "       " << argv[0] << " --benchmark-compression file.obj [repetitions]\n"
+            << "       " << argv[0] << " --benchmark-textures file.obj [repetitions]\n";
+}
+
+/// Measures the loading throughput of a .glitter file (in MB/s) for an increasing number of threads
+void loadBenchmark(const std::string & filename, unsigned int repetitions)
+{
+  unsigned int maxThreads = defaultThreadCount();
+  for (unsigned int nbThreads = 1;; nbThreads = std::min(2 * nbThreads, maxThreads)) {
+    double bestTime = 0;
+    size_t fileSize = 0;
+    for (unsigned int k = 0; k < repetitions; k++) {
+      ObjLoaderOptions options;
+      options.nbThreads = nbThreads;
+      ObjLoader objLoader(filename, options);
+      fileSize = objLoader.loadReport().fileSize;
+      if (k == 0 or objLoader.loadReport().loadTime < bestTime) {
+        bestTime = objLoader.loadReport().loadTime;
+      }
+    }
+    std::cout << std::setw(3) << nbThreads << " thread(s): " << std::fixed << std::setprecision(1) << "load " << fileSize / (1024. * 1024.) / bestTime << " MB/s\n";
+    if (nbThreads == maxThreads) {
+      break;
+    }
+  }
+}
+
+/// Measures the parsing and welding throughputs (in MB/s) and the texture decoding time for an increasing number of threads
+void benchmark(const std::string & filename, unsigned int repetitions)
+{
+  if (endsWith(filename, ".glitter")) {
+    loadBenchmark(filename, repetitions);
+    return;
+  }
+  unsigned int maxThreads = defaultThreadCount();
+  for (unsigned int nbThreads = 1;; nbThreads = std::min(2 * nbThreads, maxThreads)) {
+    double bestTime = 0;
+    double bestWeldTime = 0;
+    double bestDecodeTime = 0;
+    double bestWaitTime = 0;
+    size_t fileSize = 0;
+    for (unsigned int k = 0; k < repetitions; k++) {
+      ObjLoaderOptions options;
+      options.nbThreads = nbThreads;
+      ObjLoader objLoader(filename, options);
+      const ObjLoader::LoadReport & report = objLoader.loadReport();
+      fileSize = report.fileSize;
+      if (k == 0 or report.parseTime < bestTime) {
+        bestTime = report.parseTime;
+      }
+      if (k == 0 or report.weldTime < bestWeldTime) {
+        bestWeldTime = report.weldTime;
+      }
+      if (k == 0 or report.decodeTime < bestDecodeTime) {
+        bestDecodeTime = report.decodeTime;
+        bestWaitTime = report.decodeWaitTime;
+      }
+    }
+    double megabytes = fileSize / (1024. * 1024.);
+    std::cout << std::setw(3) << nbThreads << " thread(s): " << std::fixed << std::setprecision(1) << "parse " << megabytes / bestTime << " MB/s, weld " << megabytes / bestWeldTime << " MB/s, decode textures "
+              << 1000 * bestDecodeTime << " ms (" << 1000 * bestWaitTime << " ms not overlapped)\n";
+    if (nbThreads == maxThreads) {
+      break;
+    }
+  }
+}
+
+/// Decodes a compressed stream made of position, color, uv, normal and tangent, and returns the largest errors
+void decodeVertices(const ObjLoader & objLoader, const std::vector<char> & vertices, bool halfPositions, bool halfUVs, float errors[4])
+{
+  size_t positionSize = ObjLoader::encodedSize(VertexAttribute::Position, halfPositions ? VertexEncoding::Half : VertexEncoding::Float);
+  size_t uvSize = ObjLoader::encodedSize(VertexAttribute::UV, halfUVs ? VertexEncoding::Half : VertexEncoding::Float);
+  size_t stride = positionSize + sizeof(PackedUnorm8x4) + uvSize + 2 * sizeof(PackedSnorm16x2);
+  errors[0] = errors[1] = errors[2] = errors[3] = 0;
+  for (size_t k = 0; k < objLoader.vertexPositions().size(); k++) {
+    const char * vertex = vertices.data() + k * stride;
+    glm::vec3 position;
+    if (halfPositions) {
+      PackedHalf4 half;
+      memcpy(&half, vertex, sizeof(half));
+      position = glm::vec3(halfToFloat(half.x), halfToFloat(half.y), halfToFloat(half.z));
+    } else {
+      memcpy(&position, vertex, sizeof(position));
+    }
+    vertex += positionSize;
+    PackedUnorm8x4 color;
+    memcpy(&color, vertex, sizeof(color));
+    glm::vec4 decodedColor = decodeUnorm8(color);
+    vertex += sizeof(color);
+    glm::vec2 uv;
+    if (halfUVs) {
+      PackedHalf2 half;
+      memcpy(&half, vertex, sizeof(half));
+      uv = glm::vec2(halfToFloat(half.x), halfToFloat(half.y));
+    } else {
+      memcpy(&uv, vertex, sizeof(uv));
+    }
+    vertex += uvSize;
+    PackedSnorm16x2 normal, tangent;
+    memcpy(&normal, vertex, sizeof(normal));
+    memcpy(&tangent, vertex + sizeof(normal), sizeof(tangent));
+    glm::vec3 decodedNormal = decodeOctahedral(normal);
+    glm::vec3 decodedTangent = decodeOctahedral(tangent);
+    errors[0] = std::max(errors[0], glm::distance(position, objLoader.vertexPositions()[k]));
+    errors[1] = std::max(errors[1], glm::distance(decodedColor, objLoader.vertexColors()[k]));
+    errors[2] = std::max(errors[2], glm::distance(uv, objLoader.vertexUVs()[k]));
+    errors[3] = std::max(errors[3], std::max(glm::distance(decodedNormal, objLoader.vertexNormals()[k]), glm::distance(decodedTangent, objLoader.vertexTangents()[k])));
+  }
+}
+
+/// Measures the size reduction, the encoding and decoding throughputs (single thread, in MB/s of floats) and the errors of the compressed vertex format
+void compressionBenchmark(const std::string & filename, unsigned int repetitions)
+{
+  ObjLoaderOptions options;
+  options.nbThreads = 1;
+  ObjLoader objLoader(filename, options);
+  const float tolerance = 1e-3f;
+  bool halfPositions = objLoader.halfPrecisionAllows(VertexAttribute::Position, tolerance);
+  bool halfUVs = objLoader.halfPrecisionAllows(VertexAttribute::UV, tolerance);
+  std::vector<VertexAttribute> attributes = {VertexAttribute::Position, VertexAttribute::Color, VertexAttribute::UV, VertexAttribute::Normal, VertexAttribute::Tangent};
+  std::vector<VertexEncoding> encodings = {halfPositions ? VertexEncoding::Half : VertexEncoding::Float, VertexEncoding::Unorm8, halfUVs ? VertexEncoding::Half : VertexEncoding::Float,
+                                           VertexEncoding::Octahedral, VertexEncoding::Octahedral};
+
+  std::vector<char> floatVertices = objLoader.interleavedVertices(attributes);
+  std::vector<char> compressedVertices;
+  float errors[4];
+  double bestEncodeTime = 0;
+  double bestDecodeTime = 0;
+  for (unsigned int k = 0; k < repetitions; k++) {
+    auto startTime = std::chrono::steady_clock::now();
+    compressedVertices = objLoader.interleavedVertices(attributes, encodings);
+    auto encodedTime = std::chrono::steady_clock::now();
+    decodeVertices(objLoader, compressedVertices, halfPositions, halfUVs, errors);
+    double encodeTime = std::chrono::duration<double>(encodedTime - startTime).count();
+    double decodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - encodedTime).count();
+    if (k == 0 or encodeTime < bestEncodeTime) {
+      bestEncodeTime = encodeTime;
+    }
+    if (k == 0 or decodeTime < bestDecodeTime) {
+      bestDecodeTime = decodeTime;
+    }
+  }
+
+  double megabytes = floatVertices.size() / (1024. * 1024.);
+  std::cout << std::fixed << std::setprecision(2) << "positions: " << (halfPositions ? "half" : "float") << ", uvs: " << (halfUVs ? "half" : "float")
+            << ", colors: unorm8, normals/tangents: octahedral\n"
+            << "VBO size: " << megabytes << " MB -> " << compressedVertices.size() / (1024. * 1024.) << " MB (" << double(floatVertices.size()) / compressedVertices.size() << "x)\n"
+            << std::setprecision(1) << "encode " << megabytes / bestEncodeTime << " MB/s, decode " << megabytes / bestDecodeTime << " MB/s\n"
+            << std::scientific << "max errors: position " << errors[0] << ", color " << errors[1] << ", uv " << errors[2] << ", direction " << errors[3] << "\n";
+}
+
+/// Measures the block compression of the texture images (encoding throughput in MPixel/s, size reduction and PSNR) and the computation of their mipmaps
+void textureBenchmark(const std::string & filename, unsigned int repetitions)
+{
+  static const char * formatNames[] = {"RGBA8", "BC1", "BC3", "BC5"};
+  static const int comparedChannels[] = {4, 3, 4, 2};
+  ObjLoader objLoader(filename);
+  std::vector<std::string> names;
+  std::unordered_map<std::string, MipmapFilter> filters;
+  for (const SimpleMaterial & material : objLoader.materials()) {
+    for (const std::string & name : {material.diffuseTexName, material.normalTexName, material.specularTexName}) {
+      // the default 1x1 images of the loader (\"OBL:\" names) are skipped
+      if (not name.empty() and name.rfind("OBL:", 0) != 0 and std::find(names.begin(), names.end(), name) == names.end()) {
+        names.push_back(name);
+      }
+    }
+    filters.insert({material.diffuseTexName, MipmapFilter::SRGB});
+    filters[material.normalTexName] = MipmapFilter::NormalMap;
+  }
+  size_t totalRawSize = 0, totalCompressedSize = 0;
+  for (const std::string & name : names) {
+    Image<> image = objLoader.image(name);
+    MipmapFilter filter = filters.count(name) ? filters[name] : MipmapFilter::Linear;
+    TextureFormat format = chooseTextureFormat(image, filter == MipmapFilter::NormalMap);
+    std::vector<char> compressed;
+    double bestTime = 0;
+    double bestMipmapTime = 0;
+    for (unsigned int k = 0; k < repetitions; k++) {
+      auto startTime = std::chrono::steady_clock::now();
+      compressed = compressTexture(image, format, 1);
+      auto compressedTime = std::chrono::steady_clock::now();
+      generateMipmaps(image, filter, 1);
+      double time = std::chrono::duration<double>(compressedTime - startTime).count();
+      double mipmapTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - compressedTime).count();
+      if (k == 0 or time < bestTime) {
+        bestTime = time;
+      }
+      if (k == 0 or mipmapTime < bestMipmapTime) {
+        bestMipmapTime = mipmapTime;
+      }
+    }
+    int formatIndex = static_cast<int>(format);
+    std::vector<unsigned char> decoded = decompressTexture(compressed, format, image.width, image.height);
+    size_t rawSize = textureLevelSize(TextureFormat::RGBA8, image.width, image.height);
+    totalRawSize += rawSize;
+    totalCompressedSize += compressed.size();
+    std::cout << name << " (" << image.width << "x" << image.height << "x" << image.channels << "): " << formatNames[formatIndex] << ", " << std::fixed << std::setprecision(2)
+              << rawSize / (1024. * 1024.) << " MB -> " << compressed.size() / (1024. * 1024.) << " MB, " << std::setprecision(1) << image.width * double(image.height) / (1e6 * bestTime)
+              << " MPixel/s, PSNR " << peakSignalToNoiseRatio(image, decoded, comparedChannels[formatIndex]) << " dB, mipmaps " << 1000 * bestMipmapTime << " ms\n";
+  }
+  if (totalCompressedSize > 0) {
+    std::cout << std::fixed << std::setprecision(2) << "texture memory: " << totalRawSize / (1024. * 1024.) << " MB (RGBA8) -> " << totalCompressedSize / (1024. * 1024.) << " MB ("
+              << double(totalRawSize) / totalCompressedSize << "x)\n";
+  }
+}
+
+/// Prints the vertex cache statistics measured while optimizing
+void printCacheStatistics(const ObjLoader::LoadReport & report)
+{
+  std::cout << std::fixed << std::setprecision(3) << "ACMR " << report.cacheBefore.acmr << " -> " << report.cacheAfter.acmr << ", ATVR " << report.cacheBefore.atvr << " -> "
+            << report.cacheAfter.atvr << " (" << std::setprecision(1) << 1000 * report.optimizeTime << " ms)\n";
 }
 
 int main(int argc, char * argv[])
 {
-  if (argc != 3) {
+  if (argc >= 3 and std::string(argv[1]) == "--benchmark") {
+    benchmark(argv[2], (argc >= 4) ? std::max(1, atoi(argv[3])) : 3);
+    return 0;
+  }
+  if (argc >= 3 and std::string(argv[1]) == "--benchmark-compression") {
+    compressionBenchmark(argv[2], (argc >= 4) ? std::max(1, atoi(argv[3])) : 3);
+    return 0;
+  }
+  if (argc >= 3 and std::string(argv[1]) == "--benchmark-textures") {
+    textureBenchmark(argv[2], (argc >= 4) ? std::max(1, atoi(argv[3])) : 3);
+    return 0;
+  }
+  ObjLoaderOptions options;
+  bool stream = false;
+  bool compress = false;
+  int first = 1;
+  for (; first < argc and argv[first][0] == '-' and argv[first][1] == '-'; first++) {
+    std::string flag = argv[first];
+    if (flag == "--optimize") {
+      options.optimizeMesh = true;
+    } else if (flag == "--stream") {
+      stream = true;
+    } else if (flag == "--compress") {
+      compress = true;
+    } else if (flag == "--compress-textures") {
+      options.compressTextures = true;
+    } else if (flag == "--mipmaps") {
+      options.generateMipmaps = true;
+    } else if (flag == "--kaiser-mipmaps") {
+      options.generateMipmaps = true;
+      options.mipmapKernel = MipmapKernel::Kaiser;
+    } else {
+      break;
+    }
+  }
+  if (argc - first != 2) {
     printUsage(argc, argv);
     return 0;
   }
-  ObjLoader objLoader(argv[1]);
-  objLoader.saveBinaryFile(argv[2]);
+  if (stream) {
+    // bounded memory: the mesh is never entirely resident
+    ObjLoader::LoadReport report = ObjLoader::convertToBinaryFile(argv[first], argv[first + 1], options, 16 << 20, compress);
+    if (options.optimizeMesh) {
+      printCacheStatistics(report);
+    }
+    return 0;
+  }
+  ObjLoader objLoader(argv[first], options);
+  if (options.optimizeMesh) {
+    printCacheStatistics(objLoader.loadReport());
+  }
+  objLoader.saveBinaryFile(argv[first + 1], compress);
 }
@@ -6,6 +6,9 @@ function(checkLocalDependency  localPath)
     endif()
 endfunction()
 
+# threads
+find_package(Threads REQUIRED)
+
 # glfw
 set( ENV{PKG_CONFIG_PATH} "$ENV{PKG_CONFIG_PATH}:$ENV{HOME}/local_install/lib/pkgconfig")
 FIND_PACKAGE( PkgConfig REQUIRED )
@@ -94,6 +94,8 @@ RubikRenderer::RubikRenderer() : m_program("rubik/rubik.v.glsl", "rubik/rubik.f.
 void RubikRenderer::createTheVAO()
 {
   m_vao = InstancedVAO::makeARoundedCube(50, 50);
+  // the columns of the modelWorld matrix follow the position and the color
+  m_instanceLayout.add<glm::vec4>(2).add<glm::vec4>(3).add<glm::vec4>(4).add<glm::vec4>(5);
   for (int x = -1; x <= 1; x++) {
     for (int y = -1; y <= 1; y++) {
       for (int z = -1; z <= 1; z++) {
@@ -167,10 +169,14 @@ void RubikRenderer::renderFrame()
   const float pi = glm::pi<float>();
   view = glm::rotate(glm::mat4(1), pi / 7, {0, 1, 0});
   view = glm::rotate(glm::mat4(1), -pi / 4, {1, 0, 0}) * view * m_view;
+  // all the pieces are drawn at once, each one with its own modelWorld matrix
+  m_instances.clear();
   for (const auto & vao : m_vaos) {
-    vao->updateProgram(m_program, m_proj, view);
-    vao->draw();
+    vao->appendInstance(m_instances);
   }
+  m_vao->setInstanceVBO(m_instanceLayout, std::span<const char>(reinterpret_cast<const char *>(m_instances.data()), m_instances.size() * sizeof(glm::mat4)));
+  m_program.setUniform("VP", m_proj * view);
+  m_vao->drawInstanced(m_instances.size());
   m_program.unbind();
 }
 
@@ -235,18 +241,13 @@ std::shared_ptr<RubikRenderer::InstancedVAO> RubikRenderer::InstancedVAO::create
   return std::shared_ptr<InstancedVAO>(new InstancedVAO(vao, modelWorld));
 }
 
-void RubikRenderer::InstancedVAO::draw(GLenum mode) const
+void RubikRenderer::InstancedVAO::appendInstance(std::vector<glm::mat4> & instances) const
 {
   if (m_vao) {
-    m_vao->draw(mode);
+    instances.push_back(m_mw);
   }
 }
 
-void RubikRenderer::InstancedVAO::updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view) const
-{
-  prog.setUniform("MVP", proj * view * m_mw);
-}
-
 void RubikRenderer::InstancedVAO::launchRotation(const glm::vec3 & axis, float angle)
 {
   m_anim.startAnimation(m_mw, axis, angle);
@@ -85,17 +85,10 @@ private:
     static std::shared_ptr<InstancedVAO> createInstance(const std::shared_ptr<VAO> & vao, const glm::mat4 & modelWorld);
 
     /**
-     * @brief Draw this VAO
+     * @brief appends the modelWorld matrix of this instance to the per-instance attributes (if it has a VAO)
+     * @param instances the modelWorld matrices of the instances drawn
      */
-    void draw(GLenum mode = GL_TRIANGLES) const;
-
-    /**
-     * @brief update the program MVP uniform variable
-     * @param prog the target program
-     * @param proj the projection matrix
-     * @param view the worldView matrix
-     */
-    void updateProgram(Program & prog, const glm::mat4 & proj, const glm::mat4 & view = glm::mat4(1)) const;
+    void appendInstance(std::vector<glm::mat4> & instances) const;
 
     /// Launches a rotation animation.
     void launchRotation(const glm::vec3 & axis, float angle);
@@ -120,6 +113,8 @@ private:
 private:
   std::shared_ptr<InstancedVAO> m_vaos[27]; ///< List of instanced VAOs (VAO + modelView matrix)
   std::shared_ptr<VAO> m_vao;               ///< a unique VAO (shared by all instanced one)
+  VertexLayout m_instanceLayout;            ///< the per-instance modelWorld matrix (one anchor point per column)
+  std::vector<glm::mat4> m_instances;       ///< the modelWorld matrices of the pieces, updated every frame
   Program m_program;                        ///< A GLSL progam
   glm::mat4 m_proj;                         ///< Projection matrix
   glm::mat4 m_view;                         ///< worldView matrix
@@ -1,6 +1,8 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/ext.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include "Image.hpp"
 #include "TextPrinter.hpp"
 #include "stb_image.h"
@@ -19,12 +21,6 @@ TextPrinter::TextPrinter(uint width, uint height)
 
 void TextPrinter::printText(const std::string & text, uint x, uint y, uint fontsize, const glm::vec3 & fontColor, const glm::vec4 & fillColor, uint padding)
 {
-  m_colors.push_back(fontColor);
-  m_fillColors.push_back(fillColor);
-  m_vaos.push_back(std::unique_ptr<VAO>(new VAO(2)));
-  std::vector<glm::vec2> positions;
-  std::vector<glm::vec2> uvs;
-  std::vector<uint> ibo;
   uint & width = m_width;
   uint & height = m_height;
   uint & nbChar = m_nbChar;
@@ -37,36 +33,53 @@ void TextPrinter::printText(const std::string & text, uint x, uint y, uint fonts
     printText(paddingText, x, y, fontsize, fontColor, fillColor);
     message += paddingText;
   }
+  Line line{uint(m_vertices.size()), uint(6 * message.size()), fontColor, fillColor};
   for (char c : message) {
     glm::vec2 pos[4] = {toClip(x, y), toClip(x + 1, y), toClip(x + 1, y + 1), toClip(x, y + 1)};
     glm::vec2 uv[4] = {toUV(c, 0, 0), toUV(c, 1, 0), toUV(c, 1, 1), toUV(c, 0, 1)};
-    uint k = positions.size();
-    uint square[6] = {k, k + 2, k + 1, k, k + 3, k + 2};
-    ibo.insert(ibo.end(), square, square + 6);
-    positions.insert(positions.end(), pos, pos + 4);
-    uvs.insert(uvs.end(), uv, uv + 4);
+    for (uint k : {0, 2, 1, 0, 3, 2}) {
+      m_vertices.push_back(Vertex{pos[k], uv[k]});
+    }
     x += 1;
   }
-  m_vaos.back()->setIBO(ibo);
-  m_vaos.back()->setVBO(0, positions);
-  m_vaos.back()->setVBO(1, uvs);
+  m_lines.push_back(line);
+}
+
+void TextPrinter::clear()
+{
+  m_vertices.clear();
+  m_lines.clear();
 }
 
 void TextPrinter::draw()
 {
+  if (m_vertices.empty()) {
+    return;
+  }
+  size_t size = m_vertices.size() * sizeof(Vertex);
+  if (not m_vbo or m_vbo->regionSize() < size) {
+    // the storage is only reallocated when the text grows beyond its capacity
+    size_t capacity = m_vbo ? std::max(size, 2 * m_vbo->regionSize()) : std::max<size_t>(size, 1024 * sizeof(Vertex));
+    m_vbo = std::make_unique<StreamingBuffer>(GL_ARRAY_BUFFER, capacity);
+    VertexLayout layout;
+    layout.add<glm::vec2>(0).add<glm::vec2>(1);
+    m_vao = std::make_unique<VAO>(2);
+    m_vao->setStreamingVBO(layout, *m_vbo);
+  }
+  std::span<char> region = m_vbo->beginWrite();
+  memcpy(region.data(), m_vertices.data(), size);
+  uint first = m_vbo->endWrite(size) / sizeof(Vertex);
   m_program.bind();
   m_sampler.attachTexture(m_fontTexture);
   m_sampler.attachToProgram(m_program, "fontSampler", Sampler::DoNotBind);
   glEnable(GL_BLEND);
   m_program.setUniform("wOverH", m_wOverH);
-  for (uint k = 0; k < m_vaos.size(); ++k) {
-    auto & vao = m_vaos[k];
-    glm::vec3 fontColor = m_colors[k];
-    glm::vec4 fillColor = m_fillColors[k];
-    m_program.setUniform("fontColor", fontColor);
-    m_program.setUniform("fillColor", fillColor);
-    vao->draw();
+  for (const Line & line : m_lines) {
+    m_program.setUniform("fontColor", line.color);
+    m_program.setUniform("fillColor", line.fillColor);
+    m_vao->drawArrays(GL_TRIANGLES, first + line.first, line.count);
   }
+  m_vbo->fence();
   glDisable(GL_BLEND);
   m_program.unbind();
 }
@@ -14,7 +14,7 @@ public:
    */
   TextPrinter(uint width, uint height);
   /**
-   * @brief creates a VAO for displaying some text overlay
+   * @brief appends some text to the overlay
    * @param text
    * @param x
    * @param y
@@ -22,24 +22,43 @@ public:
    */
   void printText(const std::string & text, uint x, uint y, uint fontsize, const glm::vec3 & fontColor = glm::vec3(1, 1, 1), const glm::vec4 & fillColor = glm::vec4(1, 1, 1, 0), uint padding = 0);
 
-  /// Draws all the vaos created with printText
+  /// Removes all the text printed so far (e.g. to print text that changes every frame)
+  void clear();
+
+  /// Draws all the text printed with printText (the vertices are streamed to the GPU)
   void draw();
 
   /// sets the aspect ratio
   void setWOverH(float wOverH);
 
+private:
+  /// A vertex of a character
+  struct Vertex {
+    glm::vec2 position; ///< position in clip space
+    glm::vec2 uv;       ///< texture coordinates in the font texture
+  };
+
+  /// A text printed with printText
+  struct Line {
+    uint first;          ///< index of its first vertex
+    uint count;          ///< number of vertices
+    glm::vec3 color;     ///< font color
+    glm::vec4 fillColor; ///< fill color
+  };
+
 private:
   uint m_width;   ///< width of the viewport
   uint m_height;  ///< height of the viewport
   uint m_nbChar;  ///< number of characters per row (in the font texture)
   float m_wOverH; ///< aspect ratio
 
-  Program m_program;                        ///< GLSL program for displaying text
-  Texture m_fontTexture;                    ///< texture containing all the font characters
-  Sampler m_sampler;                        ///< Texture sampler
-  std::vector<std::unique_ptr<VAO>> m_vaos; ///< VAOs created by calling printText
-  std::vector<glm::vec3> m_colors;          ///< Font colors
-  std::vector<glm::vec4> m_fillColors;      ///< Fill colors
+  Program m_program;                      ///< GLSL program for displaying text
+  Texture m_fontTexture;                  ///< texture containing all the font characters
+  Sampler m_sampler;                      ///< Texture sampler
+  std::vector<Vertex> m_vertices;         ///< vertices of all the lines (two triangles per character)
+  std::vector<Line> m_lines;              ///< lines created by calling printText
+  std::unique_ptr<StreamingBuffer> m_vbo; ///< streams the vertices (grown when they do not fit)
+  std::unique_ptr<VAO> m_vao;             ///< VAO sourcing m_vbo
 };
 
 #endif // !defined(__TEXT_PRINTER_H__)
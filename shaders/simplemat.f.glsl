@@ -1,4 +1,7 @@
 #version 410
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 
 struct Geometry {
   vec4 position;  ///< homogeneous position in world space
@@ -17,8 +20,18 @@ struct DirLight {
   vec3 intensity;
 };
 
-uniform DirLight lightsInWorld[3];  ///< lights in world space
-uniform vec3 positionCameraInWorld; ///< camera center in worldSpace
+// lights (shared by all the programs)
+layout(std140) uniform Lights {
+  DirLight lightsInWorld[3]; ///< lights in world space
+};
+
+// camera (shared by all the programs, updated once per frame)
+layout(std140) uniform Camera {
+  mat4 V;                     ///< world view matrix
+  mat4 P;                     ///< projection matrix
+  vec3 positionCameraInWorld; ///< camera center in worldSpace
+  bool displayNormals;        ///< displays the normals instead of the shading
+};
 
 // Material properties uniforms
 struct Material {
@@ -27,14 +40,41 @@ struct Material {
   vec3 specular;
   float shininess;
 
-  // Diffuse and normal maps
-  sampler2D colormap;
-  sampler2D normalmap;
-  sampler2D specularmap;
+  // Diffuse, normal and specular maps (layers of array textures shared by the parts of an object)
+  sampler2DArray colormap;
+  sampler2DArray normalmap;
+  sampler2DArray specularmap;
+  int colormapLayer;
+  int normalmapLayer;
+  int specularmapLayer;
 };
 
 uniform Material material;
-uniform bool displayNormals;
+
+#ifdef MULTI_DRAW
+// material of each draw of a multi draw call (see MultiDrawBatch)
+struct DrawMaterial {
+  mat4 modelWorld;      ///< model world matrix
+  vec3 ambient;         ///< ambient color
+  float shininess;      ///< shininess
+  vec3 diffuse;         ///< diffuse color
+  int colormapLayer;    ///< layer of the diffuse map
+  vec3 specular;        ///< specular color
+  int normalmapLayer;   ///< layer of the normal map
+  int specularmapLayer; ///< layer of the specular map
+};
+
+layout(std430) buffer Materials {
+  DrawMaterial materials[]; ///< indexed by the draw index
+};
+
+flat in int drawIndex; ///< index of the draw
+
+// the values of the material come from the storage block, its maps are still uniforms
+#define MATERIAL_VALUE(name) materials[drawIndex].name
+#else
+#define MATERIAL_VALUE(name) material.name
+#endif
 
 // output color
 out vec4 fragColor;
@@ -78,7 +118,12 @@ vec3 computeLightSpecular(const in DirLight light, const in vec3 normal, const i
  * @return the "microscopic" object normal
  *
  * @note PA5 (part 3): you must use the normal map to disturb the input
- * macroscopic normal and get the microscopic one.
+ * macroscopic normal and get the microscopic one. The normal map is an array
+ * texture: sample it at vec3(uv, MATERIAL_VALUE(normalmapLayer)).
+ *
+ * @note Normal maps block compressed by obj2glitter (BC5) only store the x and y
+ * coordinates (the blue channel reads 0): the z coordinate must be reconstructed
+ * as sqrt(1 - dot(xy, xy)), which also holds for uncompressed normal maps.
  */
 vec3 computeMicroNormal(const in vec3 macroNormal, const in vec3 macroTangent, const in vec3 macroBitangent)
 {
@@ -99,14 +144,14 @@ void main()
     return;
   }
 
-  vec3 diffuse = material.diffuse * texture(material.colormap, uv).rgb;
-  vec3 specular = material.specular * texture(material.specularmap, uv).rgb;
+  vec3 diffuse = MATERIAL_VALUE(diffuse) * texture(material.colormap, vec3(uv, MATERIAL_VALUE(colormapLayer))).rgb;
+  vec3 specular = MATERIAL_VALUE(specular) * texture(material.specularmap, vec3(uv, MATERIAL_VALUE(specularmapLayer))).rgb;
   vec3 lambert = vec3(0);
   vec3 phong = vec3(0);
   vec3 directionToCamera = normalize(positionCameraInWorld - geomInWorld.position.xyz / geomInWorld.position.w);
   for (int k = 0; k < 3; k++) {
     lambert += computeLightLambert(lightsInWorld[k], microNormal, diffuse);
-    phong += computeLightSpecular(lightsInWorld[k], microNormal, directionToCamera, specular, material.shininess);
+    phong += computeLightSpecular(lightsInWorld[k], microNormal, directionToCamera, specular, MATERIAL_VALUE(shininess));
   }
-  fragColor = vec4(material.ambient + lambert + phong, 1);
+  fragColor = vec4(MATERIAL_VALUE(ambient) + lambert + phong, 1);
 }
@@ -1,4 +1,7 @@
 #version 410
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 
 // ins (vertex input attributes)
 layout(location = 0) in vec3 vertexPosition;
@@ -6,10 +9,39 @@ layout(location = 1) in vec2 vertexUV;
 layout(location = 2) in vec3 vertexNormal;
 layout(location = 3) in vec3 vertexTangent;
 
+#ifdef MULTI_DRAW
+layout(location = 4) in int vertexDrawIndex; ///< index of the draw (a per-instance attribute)
+
+// material of each draw of a multi draw call (see MultiDrawBatch)
+struct DrawMaterial {
+  mat4 modelWorld;      ///< model world matrix
+  vec3 ambient;         ///< ambient color
+  float shininess;      ///< shininess
+  vec3 diffuse;         ///< diffuse color
+  int colormapLayer;    ///< layer of the diffuse map
+  vec3 specular;        ///< specular color
+  int normalmapLayer;   ///< layer of the normal map
+  int specularmapLayer; ///< layer of the specular map
+};
+
+layout(std430) buffer Materials {
+  DrawMaterial materials[]; ///< indexed by the draw index
+};
+
+flat out int drawIndex; ///< index of the draw
+#define M materials[vertexDrawIndex].modelWorld
+#else
 // uniforms
 uniform mat4 M; ///< model world matrix
-uniform mat4 V; ///< world view matrix
-uniform mat4 P; ///< projection matrix
+#endif
+
+// camera (shared by all the programs, updated once per frame)
+layout(std140) uniform Camera {
+  mat4 V;                     ///< world view matrix
+  mat4 P;                     ///< projection matrix
+  vec3 positionCameraInWorld; ///< camera center in worldSpace
+  bool displayNormals;        ///< displays the normals instead of the shading
+};
 
 struct Geometry {
   vec4 position;  ///< homogeneous position in world space
@@ -43,4 +75,7 @@ void main()
   geomInWorld.tangent = normalize(mat3(M) * vertexTangent);
   geomInWorld.bitangent = cross(geomInWorld.normal, geomInWorld.tangent);
   uv = vertexUV;
+#ifdef MULTI_DRAW
+  drawIndex = vertexDrawIndex;
+#endif
 }
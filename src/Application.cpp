@@ -2,6 +2,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "AssetLoader.hpp"
+#include "glApi.hpp"
 #include "utils.hpp"
 
 Application::Application(int windowWidth, int windowHeight, const char * title)
@@ -11,9 +13,24 @@ Application::Application(int windowWidth, int windowHeight, const char * title)
 
 Application::~Application()
 {
+  // shutDown does not return: the loader thread must be stopped before
+  m_assetLoader.reset();
   shutDown(0);
 }
 
+AssetLoader & Application::assetLoader()
+{
+  if (not m_assetLoader) {
+    m_assetLoader = std::make_unique<AssetLoader>();
+  }
+  return *m_assetLoader;
+}
+
+void Application::setUploadBudget(double seconds)
+{
+  m_uploadBudget = seconds;
+}
+
 void Application::mainLoop()
 {
   GLFWwindow * window = glfwGetCurrentContext();
@@ -21,10 +38,15 @@ void Application::mainLoop()
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS or glfwGetKey(window, 'Q') == GLFW_PRESS) {
       break;
     }
+    // the objects uploaded now are updated before their first frame
+    if (m_assetLoader) {
+      m_assetLoader->processUploads(m_uploadBudget);
+    }
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE) {
       update();
     }
     renderFrame();
+    GLState::shared().endFrame();
     // swap back and front buffers
     glfwSwapBuffers(window);
     glfwPollEvents();
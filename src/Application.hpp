@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 struct GLFWwindow;
+class AssetLoader;
 
 /**
  * @brief An abstract class for the main application (Based on GLFW)
@@ -30,6 +31,19 @@ public:
    */
   void mainLoop();
 
+protected:
+  /**
+   * @brief gives access to the asset loader (its uploads are run by mainLoop before each frame)
+   * @return the asset loader of the application
+   */
+  AssetLoader & assetLoader();
+
+  /**
+   * @brief sets the time spent on asset uploads per frame
+   * @param seconds the time budget in seconds
+   */
+  void setUploadBudget(double seconds);
+
 private:
   /**
    * @brief updates the state of the application based on events
@@ -53,6 +67,10 @@ private:
    * @param return_code
    */
   void shutDown(int return_code);
+
+private:
+  std::unique_ptr<AssetLoader> m_assetLoader; ///< loads assets in the background (created on first use)
+  double m_uploadBudget = 0.004;              ///< time spent on asset uploads per frame, in seconds
 };
 
 #endif // !defined(__APPLICATION_H__)
@@ -0,0 +1,81 @@
+#include "AssetLoader.hpp"
+#include <chrono>
+#include <stdexcept>
+
+AssetLoader::AssetLoader() : m_thread(1) {}
+
+AssetLoader::~AssetLoader()
+{
+  m_cancelled = true;
+}
+
+std::shared_future<void> AssetLoader::load(LoadStage load)
+{
+  // the promise is shared by the job and the upload (std::function requires copyable jobs)
+  std::shared_ptr<std::promise<void>> completed = std::make_shared<std::promise<void>>();
+  std::shared_future<void> future = completed->get_future().share();
+  m_pending++;
+  m_thread.submit([this, load, completed]() {
+    if (m_cancelled) {
+      completed->set_exception(std::make_exception_ptr(std::runtime_error("AssetLoader: request cancelled")));
+      m_pending--;
+      return;
+    }
+    UploadStep step;
+    try {
+      step = load();
+    } catch (...) {
+      completed->set_exception(std::current_exception());
+      m_pending--;
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_uploads.push_back(Upload{std::move(step), std::move(*completed)});
+  });
+  return future;
+}
+
+size_t AssetLoader::processUploads(double budget)
+{
+  auto startTime = std::chrono::steady_clock::now();
+  size_t nbCompleted = 0;
+  while (true) {
+    // the uploads are run without holding the lock, so that the loader thread never waits for them
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_uploads.empty()) {
+      break;
+    }
+    Upload upload = std::move(m_uploads.front());
+    m_uploads.pop_front();
+    lock.unlock();
+    bool complete = true;
+    try {
+      complete = upload.step();
+      if (complete) {
+        upload.completed.set_value();
+      }
+    } catch (...) {
+      // a failed upload is complete: its future rethrows the exception
+      upload.completed.set_exception(std::current_exception());
+    }
+    if (complete) {
+      m_pending--;
+      nbCompleted++;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (not complete) {
+      // the unfinished upload goes on first at the next call
+      lock.lock();
+      m_uploads.push_front(std::move(upload));
+    }
+    if (elapsed >= budget) {
+      break;
+    }
+  }
+  return nbCompleted;
+}
+
+size_t AssetLoader::pendingCount() const
+{
+  return m_pending;
+}
@@ -0,0 +1,87 @@
+/** @file */
+#ifndef __GLITTER_ASSET_LOADER_H__
+#define __GLITTER_ASSET_LOADER_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include "Parallel.hpp"
+
+/**
+ * @brief Loads assets on a background thread, and finishes them on the thread owning the OpenGL context
+ *
+ * A request is made of two stages. The loading stage (parsing, decoding, ... anything but OpenGL calls)
+ * runs on the loader thread, and returns the upload stage. The upload stage runs on the render thread,
+ * through AssetLoader::processUploads, which is called once per frame (see Application::mainLoop) with a
+ * time budget. The upload stage may be split in steps (e.g. one per part of an object): it is called
+ * again at the next opportunity until it reports that it is complete, so that large assets appear
+ * progressively instead of freezing the window.
+ *
+ * Requests are loaded one at a time, in submission order (the loading stage may itself use the shared
+ * ThreadPool). Their uploads are performed in the order their loading completes.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class AssetLoader {
+public:
+  /// A step of an upload stage (run on the render thread), returns true once the upload is complete
+  typedef std::function<bool()> UploadStep;
+
+  /// The loading stage of a request (run on the loader thread), returns the upload stage
+  typedef std::function<UploadStep()> LoadStage;
+
+  /**
+   * @brief Starts the loader thread
+   */
+  AssetLoader();
+  AssetLoader(const AssetLoader &) = delete;
+  AssetLoader & operator=(const AssetLoader &) = delete;
+
+  /**
+   * @brief Destructor (the requests not started yet are cancelled, the one being loaded is waited for)
+   */
+  ~AssetLoader();
+
+  /**
+   * @brief queues a request
+   * @param load the loading stage
+   * @return a future that becomes ready once the upload stage is complete
+   *
+   * If a stage throws, the future holds the exception. If the request is cancelled
+   * (the loader is destroyed before it starts), the future holds a std::runtime_error.
+   * In both cases, the request no longer counts as pending.
+   */
+  std::shared_future<void> load(LoadStage load);
+
+  /**
+   * @brief runs upload steps until the time budget is spent (to be called by the render thread)
+   * @param budget the time budget in seconds (at least one step is run if an upload is ready)
+   * @return the number of uploads completed
+   */
+  size_t processUploads(double budget);
+
+  /**
+   * @brief counts the requests
+   * @return the number of requests whose upload is not complete yet
+   */
+  size_t pendingCount() const;
+
+private:
+  /// A request whose loading stage is complete
+  struct Upload {
+    UploadStep step;              ///< the upload stage
+    std::promise<void> completed; ///< fulfilled once the upload is complete
+  };
+
+private:
+  mutable std::mutex m_mutex;           ///< protects m_uploads
+  std::deque<Upload> m_uploads;         ///< the uploads ready to be run, in order
+  std::atomic<size_t> m_pending{0};     ///< number of requests whose upload is not complete
+  std::atomic<bool> m_cancelled{false}; ///< whether the requests not started yet must be skipped
+  ThreadPool m_thread;                  ///< the loader thread (last member: it is stopped first)
+};
+
+#endif // !defined(__GLITTER_ASSET_LOADER_H__)
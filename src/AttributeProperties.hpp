@@ -76,4 +76,60 @@ template <> struct AttributeProperties<glm::vec4> {
   static const GLuint components = 4;      ///< the number of components per attribute
 };
 
+/// Two half floats (IEEE 754 binary16), stored as raw bits
+struct PackedHalf2 {
+  glm::uint16 x, y;
+};
+
+/// Four half floats (IEEE 754 binary16), stored as raw bits
+struct PackedHalf4 {
+  glm::uint16 x, y, z, w;
+};
+
+/// Two signed 16 bits integers, mapped to [-1, 1] when fetched by the vertex shader
+struct PackedSnorm16x2 {
+  glm::int16 x, y;
+};
+
+/// Four unsigned bytes, mapped to [0, 1] when fetched by the vertex shader
+struct PackedUnorm8x4 {
+  glm::uint8 x, y, z, w;
+};
+
+/// Traits structure for attribute properties (PackedHalf2 specialization)
+template <> struct AttributeProperties<PackedHalf2> {
+  static const GLenum typeEnum = GL_HALF_FLOAT; ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 2;           ///< the number of components per attribute
+};
+
+/// Traits structure for attribute properties (PackedHalf4 specialization)
+template <> struct AttributeProperties<PackedHalf4> {
+  static const GLenum typeEnum = GL_HALF_FLOAT; ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 4;           ///< the number of components per attribute
+};
+
+/// Traits structure for attribute properties (PackedSnorm16x2 specialization)
+template <> struct AttributeProperties<PackedSnorm16x2> {
+  static const GLenum typeEnum = GL_SHORT;      ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 2;           ///< the number of components per attribute
+  static const GLboolean normalized = GL_TRUE;  ///< the components are normalized to [-1, 1]
+};
+
+/// Traits structure for attribute properties (PackedUnorm8x4 specialization)
+template <> struct AttributeProperties<PackedUnorm8x4> {
+  static const GLenum typeEnum = GL_UNSIGNED_BYTE; ///< The OpenGL enum representing the type of attribute components
+  static const GLuint components = 4;              ///< the number of components per attribute
+  static const GLboolean normalized = GL_TRUE;     ///< the components are normalized to [0, 1]
+};
+
+/// Whether the integer components of an attribute are normalized (GL_FALSE unless the traits specify it)
+template <typename T> constexpr GLboolean attributeNormalized()
+{
+  if constexpr (requires { AttributeProperties<T>::normalized; }) {
+    return AttributeProperties<T>::normalized;
+  } else {
+    return GL_FALSE;
+  }
+}
+
 #endif // __ATTRIBUTE_PROPERTIES_HPP
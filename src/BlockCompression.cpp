@@ -0,0 +1,250 @@
+#include "BlockCompression.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+/// Shortest match worth encoding
+const size_t minMatch = 4;
+
+/// Largest distance between a match and its source
+const size_t maxOffset = 65535;
+
+/// Number of bits of the hash of a 4-byte sequence
+const unsigned int hashBits = 14;
+
+std::uint32_t load32(const unsigned char * address)
+{
+  std::uint32_t value;
+  memcpy(&value, address, sizeof(value));
+  return value;
+}
+
+std::uint32_t hashSequence(std::uint32_t sequence)
+{
+  return (sequence * 2654435761u) >> (32 - hashBits);
+}
+
+/// appends a length that did not fit in a nibble (255 means that another byte follows)
+void writeLength(size_t length, std::vector<char> & output)
+{
+  while (length >= 255) {
+    output.push_back(char(255));
+    length -= 255;
+  }
+  output.push_back(char(length));
+}
+
+bool readLength(const unsigned char *& p, const unsigned char * end, size_t & length)
+{
+  unsigned char byte;
+  do {
+    if (p >= end) {
+      return false;
+    }
+    byte = *p++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/// appends a sequence (the match is omitted if @p matchLength is 0)
+void writeSequence(const unsigned char * literals, size_t nbLiterals, size_t offset, size_t matchLength, std::vector<char> & output)
+{
+  size_t matchCode = (matchLength > 0) ? matchLength - minMatch : 0;
+  output.push_back(char((std::min<size_t>(nbLiterals, 15) << 4) | std::min<size_t>(matchCode, 15)));
+  if (nbLiterals >= 15) {
+    writeLength(nbLiterals - 15, output);
+  }
+  output.insert(output.end(), literals, literals + nbLiterals);
+  if (matchLength > 0) {
+    output.push_back(char(offset & 0xff));
+    output.push_back(char(offset >> 8));
+    if (matchCode >= 15) {
+      writeLength(matchCode - 15, output);
+    }
+  }
+}
+
+/// reads a little endian number
+template <typename U> U loadWord(const char * address)
+{
+#ifdef IS_BIG_ENDIAN
+  U value = 0;
+  for (size_t b = 0; b < sizeof(U); b++) {
+    value |= U(static_cast<unsigned char>(address[b])) << (8 * b);
+  }
+  return value;
+#else
+  U value;
+  memcpy(&value, address, sizeof(U));
+  return value;
+#endif
+}
+
+/// writes a little endian number
+template <typename U> void storeWord(U value, char * address)
+{
+#ifdef IS_BIG_ENDIAN
+  for (size_t b = 0; b < sizeof(U); b++) {
+    address[b] = char(value >> (8 * b));
+  }
+#else
+  memcpy(address, &value, sizeof(U));
+#endif
+}
+
+template <typename U> void filter(const char * input, char * output, size_t nbElements, size_t wordsPerElement)
+{
+  size_t nbWords = nbElements * wordsPerElement;
+  for (size_t k = 0; k < nbWords; k++) {
+    U delta = loadWord<U>(input + k * sizeof(U));
+    if (k >= wordsPerElement) {
+      delta -= loadWord<U>(input + (k - wordsPerElement) * sizeof(U));
+    }
+    char bytes[sizeof(U)];
+    storeWord(delta, bytes);
+    for (size_t b = 0; b < sizeof(U); b++) {
+      output[b * nbWords + k] = bytes[b];
+    }
+  }
+}
+
+template <typename U> void unfilter(const char * input, char * output, size_t nbElements, size_t wordsPerElement)
+{
+  size_t nbWords = nbElements * wordsPerElement;
+  // two simple passes (gathering the bytes, then summing the deltas) are faster than a single one
+  for (size_t b = 0; b < sizeof(U); b++) {
+    const char * lane = input + b * nbWords;
+    for (size_t k = 0; k < nbWords; k++) {
+      output[k * sizeof(U) + b] = lane[k];
+    }
+  }
+  for (size_t k = wordsPerElement; k < nbWords; k++) {
+    storeWord(U(loadWord<U>(output + k * sizeof(U)) + loadWord<U>(output + (k - wordsPerElement) * sizeof(U))), output + k * sizeof(U));
+  }
+}
+
+} // namespace
+
+size_t compressBlock(std::span<const char> input, std::vector<char> & output)
+{
+  size_t initialSize = output.size();
+  const unsigned char * data = reinterpret_cast<const unsigned char *>(input.data());
+  size_t size = input.size();
+  std::vector<std::uint32_t> table(size_t(1) << hashBits, 0);
+  size_t anchor = 0;
+  size_t position = 0;
+  while (position + minMatch <= size) {
+    std::uint32_t sequence = load32(data + position);
+    std::uint32_t & slot = table[hashSequence(sequence)];
+    size_t candidate = slot;
+    slot = position;
+    if (candidate < position and position - candidate <= maxOffset and load32(data + candidate) == sequence) {
+      size_t length = minMatch;
+      while (position + length < size and data[candidate + length] == data[position + length]) {
+        length++;
+      }
+      writeSequence(data + anchor, position - anchor, position - candidate, length, output);
+      position += length;
+      anchor = position;
+    } else {
+      // skip faster and faster through incompressible data
+      position += 1 + ((position - anchor) >> 6);
+    }
+  }
+  writeSequence(data + anchor, size - anchor, 0, 0, output);
+  return output.size() - initialSize;
+}
+
+bool decompressBlock(std::span<const char> input, std::span<char> output)
+{
+  const unsigned char * p = reinterpret_cast<const unsigned char *>(input.data());
+  const unsigned char * end = p + input.size();
+  char * out = output.data();
+  char * outEnd = out + output.size();
+  while (true) {
+    if (p >= end) {
+      return false;
+    }
+    unsigned char token = *p++;
+    size_t nbLiterals = token >> 4;
+    if (nbLiterals == 15 and not readLength(p, end, nbLiterals)) {
+      return false;
+    }
+    if (nbLiterals > size_t(end - p) or nbLiterals > size_t(outEnd - out)) {
+      return false;
+    }
+    std::copy(p, p + nbLiterals, out);
+    p += nbLiterals;
+    out += nbLiterals;
+    // only the last sequence has no match
+    if (p == end) {
+      break;
+    }
+    if (end - p < 2) {
+      return false;
+    }
+    size_t offset = p[0] | (size_t(p[1]) << 8);
+    p += 2;
+    size_t length = token & 15;
+    if (length == 15 and not readLength(p, end, length)) {
+      return false;
+    }
+    length += minMatch;
+    if (offset == 0 or offset > size_t(out - output.data()) or length > size_t(outEnd - out)) {
+      return false;
+    }
+    const char * source = out - offset;
+    if (offset >= length) {
+      memcpy(out, source, length);
+      out += length;
+    } else {
+      // overlapping match: repeats the last offset bytes
+      for (size_t k = 0; k < length; k++) {
+        *out++ = source[k];
+      }
+    }
+  }
+  return out == outEnd;
+}
+
+void filterBlock(std::span<const char> input, std::span<char> output, size_t elementSize, size_t wordSize)
+{
+  assert(input.size() == output.size());
+  assert(elementSize > 0 and elementSize % wordSize == 0);
+  size_t nbElements = input.size() / elementSize;
+  switch (wordSize) {
+  case 4:
+    filter<std::uint32_t>(input.data(), output.data(), nbElements, elementSize / 4);
+    break;
+  case 2:
+    filter<std::uint16_t>(input.data(), output.data(), nbElements, elementSize / 2);
+    break;
+  default:
+    filter<std::uint8_t>(input.data(), output.data(), nbElements, elementSize);
+  }
+  size_t filteredSize = nbElements * elementSize;
+  std::copy(input.begin() + filteredSize, input.end(), output.begin() + filteredSize);
+}
+
+void unfilterBlock(std::span<const char> input, std::span<char> output, size_t elementSize, size_t wordSize)
+{
+  assert(input.size() == output.size());
+  assert(elementSize > 0 and elementSize % wordSize == 0);
+  size_t nbElements = input.size() / elementSize;
+  switch (wordSize) {
+  case 4:
+    unfilter<std::uint32_t>(input.data(), output.data(), nbElements, elementSize / 4);
+    break;
+  case 2:
+    unfilter<std::uint16_t>(input.data(), output.data(), nbElements, elementSize / 2);
+    break;
+  default:
+    unfilter<std::uint8_t>(input.data(), output.data(), nbElements, elementSize);
+  }
+  size_t filteredSize = nbElements * elementSize;
+  std::copy(input.begin() + filteredSize, input.end(), output.begin() + filteredSize);
+}
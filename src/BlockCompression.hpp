@@ -0,0 +1,54 @@
+/** @file */
+#ifndef __GLITTER_BLOCK_COMPRESSION_H__
+#define __GLITTER_BLOCK_COMPRESSION_H__
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/**
+ * @brief compresses a block with a byte oriented LZ77 codec
+ * @param input the bytes to be compressed
+ * @param output the buffer the compressed bytes are appended to
+ * @return the number of bytes appended to @p output
+ *
+ * The compressed block is a list of sequences, each one made of a token (number of
+ * literals in the high nibble, match length minus 4 in the low nibble), extra length
+ * bytes for the literals (if the nibble is 15), the literals, a 16 bits little endian
+ * match offset, and extra length bytes for the match. The last sequence only holds
+ * literals. The format favors decoding speed over compression ratio (like LZ4).
+ */
+size_t compressBlock(std::span<const char> input, std::vector<char> & output);
+
+/**
+ * @brief decompresses a block produced by ::compressBlock
+ * @param input the compressed bytes
+ * @param output the decompressed bytes (its size must be the exact size of the original block)
+ * @return false if the block is corrupted
+ */
+bool decompressBlock(std::span<const char> input, std::span<char> output);
+
+/**
+ * @brief applies a lossless filter that makes arrays of numbers easier to compress
+ * @param input the array
+ * @param output the filtered array (same size as @p input)
+ * @param elementSize the size of an element of the array in bytes (e.g. 12 for a glm::vec3)
+ * @param wordSize the size of the numbers in the elements (1, 2 or 4 bytes, must divide @p elementSize)
+ *
+ * Each number is replaced by its (wrapping) difference with the same number in the previous
+ * element, and the bytes are then shuffled so that the bytes of the same rank of all the
+ * numbers are contiguous. Slowly varying floats thus produce long runs of similar bytes.
+ * The trailing bytes that do not form a whole element are copied as is.
+ */
+void filterBlock(std::span<const char> input, std::span<char> output, size_t elementSize, size_t wordSize);
+
+/**
+ * @brief reverts ::filterBlock
+ * @param input the filtered array
+ * @param output the original array (same size as @p input)
+ * @param elementSize the size of an element of the array in bytes
+ * @param wordSize the size of the numbers in the elements
+ */
+void unfilterBlock(std::span<const char> input, std::span<char> output, size_t elementSize, size_t wordSize);
+
+#endif // !defined(__GLITTER_BLOCK_COMPRESSION_H__)
@@ -0,0 +1,56 @@
+/** @file */
+#ifndef __GLITTER_BOUNDING_VOLUME_H__
+#define __GLITTER_BOUNDING_VOLUME_H__
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <limits>
+#include <span>
+
+/**
+ * @brief The bounding volumes of a part of a mesh: an axis aligned box and a sphere
+ *
+ * The sphere is centered on the box, its radius being the distance to the farthest vertex (which is
+ * usually tighter than the half diagonal of the box). Both volumes are tested by FrustumCuller, since
+ * each one is tighter than the other one for some shapes.
+ *
+ * @note The struct is made of 10 floats, so that it can be stored as is in a .glitter file (see GlitterSection::PartBounds).
+ */
+struct BoundingVolume {
+  glm::vec3 min = glm::vec3(0);    ///< lower corner of the box
+  glm::vec3 max = glm::vec3(0);    ///< upper corner of the box
+  glm::vec3 center = glm::vec3(0); ///< center of the sphere (the center of the box)
+  float radius = 0;                ///< radius of the sphere
+};
+
+/**
+ * @brief computes the bounding volumes of the vertices referenced by an IBO
+ * @param positions the positions of the vertices
+ * @param indices the indices of the triangles
+ * @return the bounding volumes (empty ones, at the origin, if there is no index)
+ */
+template <typename T> BoundingVolume boundingVolume(std::span<const glm::vec3> positions, std::span<const T> indices)
+{
+  BoundingVolume bounds;
+  if (indices.empty()) {
+    return bounds;
+  }
+  bounds.min = glm::vec3(std::numeric_limits<float>::max());
+  bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+  for (T index : indices) {
+    bounds.min = glm::min(bounds.min, positions[index]);
+    bounds.max = glm::max(bounds.max, positions[index]);
+  }
+  // a second pass finds the farthest vertex from the center of the box
+  bounds.center = 0.5f * (bounds.min + bounds.max);
+  float squaredRadius = 0;
+  for (T index : indices) {
+    glm::vec3 offset = positions[index] - bounds.center;
+    squaredRadius = std::max(squaredRadius, glm::dot(offset, offset));
+  }
+  bounds.radius = std::sqrt(squaredRadius);
+  return bounds;
+}
+
+#endif // !defined(__GLITTER_BOUNDING_VOLUME_H__)
@@ -0,0 +1,115 @@
+#include "FrustumCuller.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#if defined(__SSE__) or defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+void FrustumCuller::begin(const glm::mat4 & viewProjection)
+{
+  // the planes are combinations of the rows of the matrix (Gribb and Hartmann): left, right, bottom, top, near and far
+  glm::mat4 rows = glm::transpose(viewProjection);
+  for (int k = 0; k < 6; k++) {
+    glm::vec4 plane = rows[3] + ((k % 2) ? -rows[k / 2] : rows[k / 2]);
+    m_planes[k] = plane / glm::length(glm::vec3(plane));
+  }
+  for (int k = 0; k < 3; k++) {
+    m_centers[k].clear();
+    m_extents[k].clear();
+  }
+  m_radii.clear();
+  m_visible.clear();
+}
+
+size_t FrustumCuller::add(const BoundingVolume & bounds, const glm::mat4 & modelWorld)
+{
+  glm::vec3 center(modelWorld * glm::vec4(bounds.center, 1));
+  glm::vec3 extent = 0.5f * (bounds.max - bounds.min);
+  float scale = 0;
+  for (int k = 0; k < 3; k++) {
+    // the box around the transformed box (Arvo), and the sphere scaled by the largest scale factor
+    glm::vec3 row(modelWorld[0][k], modelWorld[1][k], modelWorld[2][k]);
+    m_centers[k].push_back(center[k]);
+    m_extents[k].push_back(glm::dot(glm::abs(row), extent));
+    scale = std::max(scale, glm::length(glm::vec3(modelWorld[k])));
+  }
+  m_radii.push_back(scale * bounds.radius);
+  return m_radii.size() - 1;
+}
+
+void FrustumCuller::cull()
+{
+  size_t count = m_radii.size();
+  // the padding volumes are tested with the others, then ignored
+  size_t padded = (count + 3) & ~size_t(3);
+  for (int k = 0; k < 3; k++) {
+    m_centers[k].resize(padded, 0);
+    m_extents[k].resize(padded, 0);
+  }
+  m_radii.resize(padded, 0);
+  m_visible.resize(padded);
+  // a volume is outside a plane when the distance from its center is below -min(radius, projected half size of the box)
+  float absNormals[6][3];
+  for (int p = 0; p < 6; p++) {
+    for (int k = 0; k < 3; k++) {
+      absNormals[p][k] = std::fabs(m_planes[p][k]);
+    }
+  }
+#if defined(__SSE__) or defined(_M_X64)
+  const __m128 zero = _mm_setzero_ps();
+  for (size_t first = 0; first < padded; first += 4) {
+    __m128 centers[3], extents[3];
+    for (int k = 0; k < 3; k++) {
+      centers[k] = _mm_loadu_ps(m_centers[k].data() + first);
+      extents[k] = _mm_loadu_ps(m_extents[k].data() + first);
+    }
+    __m128 radii = _mm_loadu_ps(m_radii.data() + first);
+    __m128 outside = zero;
+    for (int p = 0; p < 6; p++) {
+      __m128 distance = _mm_set1_ps(m_planes[p].w);
+      __m128 boxRadius = zero;
+      for (int k = 0; k < 3; k++) {
+        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(m_planes[p][k]), centers[k]));
+        boxRadius = _mm_add_ps(boxRadius, _mm_mul_ps(_mm_set1_ps(absNormals[p][k]), extents[k]));
+      }
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(radii, boxRadius)), zero));
+    }
+    int mask = _mm_movemask_ps(outside);
+    for (int j = 0; j < 4; j++) {
+      m_visible[first + j] = not(mask & (1 << j));
+    }
+  }
+#else
+  for (size_t first = 0; first < padded; first += 4) {
+    bool outside[4] = {false, false, false, false};
+    for (int p = 0; p < 6; p++) {
+      for (int j = 0; j < 4; j++) {
+        float distance = m_planes[p].w;
+        float boxRadius = 0;
+        for (int k = 0; k < 3; k++) {
+          distance += m_planes[p][k] * m_centers[k][first + j];
+          boxRadius += absNormals[p][k] * m_extents[k][first + j];
+        }
+        outside[j] = outside[j] or (distance + std::min(m_radii[first + j], boxRadius) < 0);
+      }
+    }
+    for (int j = 0; j < 4; j++) {
+      m_visible[first + j] = not outside[j];
+    }
+  }
+#endif
+  m_lastFrame.visible = std::count(m_visible.begin(), m_visible.begin() + count, 1);
+  m_lastFrame.culled = count - m_lastFrame.visible;
+}
+
+bool FrustumCuller::visible(size_t volume) const
+{
+  assert(volume < m_visible.size() && "FrustumCuller::visible(): the volumes were not culled");
+  return m_visible[volume];
+}
+
+const FrustumCuller::Statistics & FrustumCuller::lastFrame() const
+{
+  return m_lastFrame;
+}
@@ -0,0 +1,86 @@
+/** @file */
+#ifndef __GLITTER_FRUSTUM_CULLER_H__
+#define __GLITTER_FRUSTUM_CULLER_H__
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "BoundingVolume.hpp"
+
+/**
+ * @brief Tests the bounding volumes of the parts drawn in a frame against the view frustum
+ *
+ * Every frame, the bounding volumes of all the parts are added (and moved to world space), then
+ * FrustumCuller::cull tests them against the 6 planes of the frustum, 4 volumes at a time (with SSE
+ * when available, the scalar version computing the same values otherwise). The volumes are stored
+ * as a structure of arrays, one array per coordinate. A volume is culled when its sphere or its box
+ * lies entirely on the outer side of one of the planes. The volumes that cross the frustum corners
+ * without touching it are thus drawn, which is conservative.
+ * @code
+ * culler.begin(proj * view);
+ * for (const Part & part : parts) {
+ *   part.volume = culler.add(part.bounds, part.modelWorld);
+ * }
+ * culler.cull();
+ * for (const Part & part : parts) {
+ *   if (culler.visible(part.volume)) {
+ *     part.draw();
+ *   }
+ * }
+ * @endcode
+ */
+class FrustumCuller {
+public:
+  /**
+   * @brief Counters of a frame
+   */
+  struct Statistics {
+    size_t visible = 0; ///< volumes intersecting the frustum
+    size_t culled = 0;  ///< volumes outside the frustum
+  };
+
+  FrustumCuller() {}
+  FrustumCuller(const FrustumCuller &) = delete;
+  FrustumCuller & operator=(const FrustumCuller &) = delete;
+
+  /**
+   * @brief starts a new frame (the volumes of the previous frame are forgotten)
+   * @param viewProjection the projection matrix times the worldView matrix
+   */
+  void begin(const glm::mat4 & viewProjection);
+
+  /**
+   * @brief adds a bounding volume to the current frame
+   * @param bounds the bounding volumes in object space
+   * @param modelWorld the matrix transform between the object space and the world space
+   * @return the index of the volume, to be given to FrustumCuller::visible
+   */
+  size_t add(const BoundingVolume & bounds, const glm::mat4 & modelWorld);
+
+  /**
+   * @brief tests all the volumes of the current frame against the frustum
+   */
+  void cull();
+
+  /**
+   * @brief tells whether a volume intersects the frustum
+   * @param volume the index returned by FrustumCuller::add
+   * @return false if the volume is culled (only valid after FrustumCuller::cull)
+   */
+  bool visible(size_t volume) const;
+
+  /**
+   * @brief getter for the counters of the last frame
+   * @return the counters of the last call to FrustumCuller::cull
+   */
+  const Statistics & lastFrame() const;
+
+private:
+  glm::vec4 m_planes[6];                ///< the planes of the frustum in world space, normalized, the normals pointing inside
+  std::vector<float> m_centers[3];      ///< the x, y and z coordinates of the world space centers
+  std::vector<float> m_extents[3];      ///< the half sizes of the world space boxes along x, y and z
+  std::vector<float> m_radii;           ///< the world space radii of the spheres
+  std::vector<unsigned char> m_visible; ///< whether each volume intersects the frustum (padded to a multiple of 4)
+  Statistics m_lastFrame;               ///< the counters of the last frame
+};
+
+#endif // !defined(__GLITTER_FRUSTUM_CULLER_H__)
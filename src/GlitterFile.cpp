@@ -0,0 +1,403 @@
+#include "GlitterFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include "BlockCompression.hpp"
+#include "Parallel.hpp"
+
+namespace
+{
+/// size of the fixed header: magic (16B), version (4B), section count (4B), directory offset (8B), padding
+const std::uint64_t headerSize = GLITTER_SECTION_ALIGNMENT;
+
+/// version 3 adds the compression fields to the directory entries (version 2 files remain readable)
+const glm::uint32 formatVersion = 3;
+
+/// size of a directory entry in a version 2 file (without the compression fields) and in the current version
+const size_t entrySizeV2 = 4 + 4 + 8 + 8 + 8;
+const size_t entrySize = entrySizeV2 + 4 + 4 + 4 + 4 + 8;
+
+/// reads a value stored in little endian at a given address
+template <typename T> T readValue(const char * address)
+{
+  T value;
+  memcpy(&value, address, sizeof(T));
+  swapEndianness(value);
+  return value;
+}
+} // namespace
+
+GlitterWriter::GlitterWriter(const std::string & filename, bool compress, unsigned int nbThreads)
+    : m_file(filename.c_str(), std::ios::binary), m_compress(compress), m_nbThreads(nbThreads ? nbThreads : defaultThreadCount())
+{
+  if (!m_file) {
+    std::cerr << "Unable to create file: " << filename << std::endl;
+    exit(1);
+  }
+  // placeholder header, patched by close()
+  char header[headerSize];
+  memset(header, 0, headerSize);
+  m_file.write(header, headerSize);
+}
+
+GlitterWriter::~GlitterWriter()
+{
+  if (m_file.is_open()) {
+    close();
+  }
+}
+
+void GlitterWriter::align()
+{
+  static const char padding[GLITTER_SECTION_ALIGNMENT] = {0};
+  std::uint64_t position = m_file.tellp();
+  std::uint64_t remainder = position % GLITTER_SECTION_ALIGNMENT;
+  if (remainder != 0) {
+    m_file.write(padding, GLITTER_SECTION_ALIGNMENT - remainder);
+  }
+}
+
+void GlitterWriter::writeSection(GlitterSection type, const char * data, std::uint64_t size, std::uint64_t count)
+{
+  beginSection(type);
+  appendToSection(data, size, count);
+  endSection();
+}
+
+void GlitterWriter::beginSection(GlitterSection type, glm::uint32 elementSize, glm::uint32 wordSize)
+{
+  assert(not m_sectionOpen && "GlitterWriter::beginSection(): a section is already open");
+  align();
+  m_openSection.type = static_cast<glm::uint32>(type);
+  m_openSection.index = 0;
+  for (const GlitterSectionEntry & other : m_directory) {
+    if (other.type == m_openSection.type) {
+      m_openSection.index++;
+    }
+  }
+  m_openSection.offset = m_file.tellp();
+  m_openSection.size = 0;
+  m_openSection.count = 0;
+  m_openSection.codec = static_cast<glm::uint32>(m_compress ? GlitterCodec::LZ : GlitterCodec::None);
+  m_openSection.elementSize = m_compress ? elementSize : 0;
+  m_openSection.wordSize = m_compress ? wordSize : 0;
+  m_openSection.blockSize = 0;
+  if (m_compress) {
+    // blocks are made of whole elements, so that they can be filtered independently
+    m_openSection.blockSize = (elementSize > 0) ? std::max<glm::uint32>(1, GLITTER_BLOCK_SIZE / elementSize) * elementSize : GLITTER_BLOCK_SIZE;
+  }
+  m_openSection.storedSize = 0;
+  m_pendingBytes.clear();
+  m_blockSizes.clear();
+  m_sectionOpen = true;
+}
+
+void GlitterWriter::appendToSection(const char * data, std::uint64_t size, std::uint64_t count)
+{
+  assert(m_sectionOpen && "GlitterWriter::appendToSection(): no open section");
+  m_openSection.size += size;
+  m_openSection.count += count;
+  if (m_openSection.codec == static_cast<glm::uint32>(GlitterCodec::None)) {
+    m_file.write(data, size);
+    m_openSection.storedSize += size;
+    return;
+  }
+  m_pendingBytes.insert(m_pendingBytes.end(), data, data + size);
+  // enough blocks to keep every thread busy
+  if (m_pendingBytes.size() >= size_t(m_nbThreads) * m_openSection.blockSize) {
+    flushBlocks(false);
+  }
+}
+
+void GlitterWriter::flushBlocks(bool all)
+{
+  size_t blockSize = m_openSection.blockSize;
+  size_t nbBlocks = all ? (m_pendingBytes.size() + blockSize - 1) / blockSize : m_pendingBytes.size() / blockSize;
+  std::vector<std::vector<char>> compressedBlocks(nbBlocks);
+  parallelFor(
+      nbBlocks,
+      [&](size_t b) {
+        std::span<const char> block(m_pendingBytes.data() + b * blockSize, std::min(blockSize, m_pendingBytes.size() - b * blockSize));
+        std::vector<char> filtered;
+        if (m_openSection.elementSize > 0) {
+          filtered.resize(block.size());
+          filterBlock(block, filtered, m_openSection.elementSize, m_openSection.wordSize);
+          block = filtered;
+        }
+        compressBlock(block, compressedBlocks[b]);
+        // incompressible blocks are stored as is
+        if (compressedBlocks[b].size() >= block.size()) {
+          compressedBlocks[b].assign(block.begin(), block.end());
+        }
+      },
+      m_nbThreads);
+  for (const std::vector<char> & compressed : compressedBlocks) {
+    m_file.write(compressed.data(), compressed.size());
+    m_blockSizes.push_back(compressed.size());
+    m_openSection.storedSize += compressed.size();
+  }
+  m_pendingBytes.erase(m_pendingBytes.begin(), m_pendingBytes.begin() + std::min(nbBlocks * blockSize, m_pendingBytes.size()));
+}
+
+void GlitterWriter::endSection()
+{
+  assert(m_sectionOpen && "GlitterWriter::endSection(): no open section");
+  if (m_openSection.codec != static_cast<glm::uint32>(GlitterCodec::None)) {
+    flushBlocks(true);
+    for (glm::uint32 blockSize : m_blockSizes) {
+      write(blockSize, m_file);
+    }
+    m_openSection.storedSize += m_blockSizes.size() * sizeof(glm::uint32);
+  }
+  m_directory.push_back(m_openSection);
+  m_sectionOpen = false;
+}
+
+void GlitterWriter::close()
+{
+  if (m_sectionOpen) {
+    endSection();
+  }
+  align();
+  std::uint64_t directoryOffset = m_file.tellp();
+  for (const GlitterSectionEntry & entry : m_directory) {
+    write(entry.type, m_file);
+    write(entry.index, m_file);
+    write(entry.offset, m_file);
+    write(entry.size, m_file);
+    write(entry.count, m_file);
+    write(entry.codec, m_file);
+    write(entry.elementSize, m_file);
+    write(entry.wordSize, m_file);
+    write(entry.blockSize, m_file);
+    write(entry.storedSize, m_file);
+  }
+  m_file.seekp(0);
+  m_file.write(GLITTER_BINFILE_MAGIC_V2, strlen(GLITTER_BINFILE_MAGIC_V2));
+  glm::uint32 sectionCount = m_directory.size();
+  write(formatVersion, m_file);
+  write(sectionCount, m_file);
+  write(directoryOffset, m_file);
+  m_file.close();
+}
+
+#ifdef IS_BIG_ENDIAN
+GlitterFile::GlitterFile(const std::string & filename, unsigned int nbThreads, bool prefetch) : m_file(filename, true)
+#else
+GlitterFile::GlitterFile(const std::string & filename, unsigned int nbThreads, bool prefetch) : m_file(filename)
+#endif
+{
+  const char * data = m_file.data();
+  size_t magicLength = strlen(GLITTER_BINFILE_MAGIC_V2);
+  if (m_file.size() < headerSize or memcmp(data, GLITTER_BINFILE_MAGIC_V2, magicLength)) {
+    std::cerr << "GlitterFile: wrong file magic number in " << filename << std::endl;
+    exit(1);
+  }
+  glm::uint32 version = readValue<glm::uint32>(data + magicLength);
+  glm::uint32 sectionCount = readValue<glm::uint32>(data + magicLength + 4);
+  std::uint64_t directoryOffset = readValue<std::uint64_t>(data + magicLength + 8);
+  size_t versionEntrySize = (version == 2) ? entrySizeV2 : entrySize;
+  // the bounds are checked without sums, that a corrupted offset could overflow
+  std::uint64_t directorySize = std::uint64_t(sectionCount) * versionEntrySize;
+  if ((version != 2 and version != formatVersion) or directorySize > m_file.size() or directoryOffset > m_file.size() - directorySize) {
+    std::cerr << "GlitterFile: corrupted header in " << filename << std::endl;
+    exit(1);
+  }
+
+  m_directory.resize(sectionCount);
+  const char * address = data + directoryOffset;
+  for (GlitterSectionEntry & entry : m_directory) {
+    entry.type = readValue<glm::uint32>(address);
+    entry.index = readValue<glm::uint32>(address + 4);
+    entry.offset = readValue<std::uint64_t>(address + 8);
+    entry.size = readValue<std::uint64_t>(address + 16);
+    entry.count = readValue<std::uint64_t>(address + 24);
+    entry.codec = static_cast<glm::uint32>(GlitterCodec::None);
+    entry.elementSize = entry.wordSize = entry.blockSize = 0;
+    entry.storedSize = entry.size;
+    if (version != 2) {
+      entry.codec = readValue<glm::uint32>(address + 32);
+      entry.elementSize = readValue<glm::uint32>(address + 36);
+      entry.wordSize = readValue<glm::uint32>(address + 40);
+      entry.blockSize = readValue<glm::uint32>(address + 44);
+      entry.storedSize = readValue<std::uint64_t>(address + 48);
+    }
+    address += versionEntrySize;
+    if (entry.storedSize > m_file.size() or entry.offset > m_file.size() - entry.storedSize) {
+      std::cerr << "GlitterFile: section out of bounds in " << filename << std::endl;
+      exit(1);
+    }
+  }
+  loadSections(filename, nbThreads, prefetch);
+  swapSections();
+}
+
+void GlitterFile::loadSections(const std::string & filename, unsigned int nbThreads, bool prefetch)
+{
+  // a range of the payload of a section: a compressed block, or a range of raw bytes to be prefetched
+  struct Block {
+    size_t entry;
+    const char * data;
+    size_t storedSize;
+    size_t offset;
+    size_t size;
+  };
+  std::vector<Block> blocks;
+  bool corrupted = false;
+  m_decompressed.resize(m_directory.size());
+  for (size_t k = 0; k < m_directory.size() and not corrupted; k++) {
+    const GlitterSectionEntry & entry = m_directory[k];
+    const char * data = m_file.data() + entry.offset;
+    if (entry.codec == static_cast<glm::uint32>(GlitterCodec::None)) {
+      for (size_t offset = 0; prefetch and offset < entry.size; offset += GLITTER_BLOCK_SIZE) {
+        size_t size = std::min<size_t>(GLITTER_BLOCK_SIZE, entry.size - offset);
+        blocks.push_back({k, data + offset, size, offset, size});
+      }
+      continue;
+    }
+    bool validFilter = (entry.elementSize == 0) or ((entry.wordSize == 1 or entry.wordSize == 2 or entry.wordSize == 4) and entry.elementSize % entry.wordSize == 0);
+    if (entry.codec != static_cast<glm::uint32>(GlitterCodec::LZ) or entry.blockSize == 0 or not validFilter) {
+      corrupted = true;
+      break;
+    }
+    size_t nbBlocks = (entry.size + entry.blockSize - 1) / entry.blockSize;
+    size_t tableSize = nbBlocks * sizeof(glm::uint32);
+    if (tableSize > entry.storedSize) {
+      corrupted = true;
+      break;
+    }
+    const char * table = data + entry.storedSize - tableSize;
+    size_t storedOffset = 0;
+    for (size_t b = 0; b < nbBlocks; b++) {
+      Block block = {k, data + storedOffset, readValue<glm::uint32>(table + b * sizeof(glm::uint32)), b * entry.blockSize, 0};
+      block.size = std::min<size_t>(entry.blockSize, entry.size - block.offset);
+      storedOffset += block.storedSize;
+      corrupted = corrupted or (block.storedSize > block.size);
+      blocks.push_back(block);
+    }
+    corrupted = corrupted or (storedOffset != entry.storedSize - tableSize);
+    m_decompressed[k].resize(entry.size);
+  }
+
+  // all the blocks of all the sections (e.g. the texture images) are independent
+  std::atomic<bool> invalidBlock(corrupted);
+  if (not corrupted) {
+    parallelFor(
+        blocks.size(),
+        [&](size_t b) {
+          const Block & block = blocks[b];
+          const GlitterSectionEntry & entry = m_directory[block.entry];
+          if (entry.codec == static_cast<glm::uint32>(GlitterCodec::None)) {
+            m_file.prefetch(block.data - m_file.data(), block.size);
+            return;
+          }
+          std::span<const char> stored(block.data, block.storedSize);
+          std::span<char> output(m_decompressed[block.entry].data() + block.offset, block.size);
+          std::vector<char> filtered(entry.elementSize > 0 ? block.size : 0);
+          std::span<char> decompressed = (entry.elementSize > 0) ? std::span<char>(filtered) : output;
+          if (block.storedSize == block.size) {
+            std::copy(stored.begin(), stored.end(), decompressed.begin());
+          } else if (not decompressBlock(stored, decompressed)) {
+            invalidBlock = true;
+            return;
+          }
+          if (entry.elementSize > 0) {
+            unfilterBlock(filtered, output, entry.elementSize, entry.wordSize);
+          }
+        },
+        nbThreads);
+  }
+  if (invalidBlock) {
+    std::cerr << "GlitterFile: corrupted compressed section in " << filename << std::endl;
+    exit(1);
+  }
+}
+
+bool GlitterFile::isVersion2(const std::string & filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  char magicBuffer[sizeof(GLITTER_BINFILE_MAGIC_V2)];
+  memset(magicBuffer, 0, sizeof(magicBuffer));
+  file.read(magicBuffer, strlen(GLITTER_BINFILE_MAGIC_V2));
+  return !strcmp(magicBuffer, GLITTER_BINFILE_MAGIC_V2);
+}
+
+const GlitterSectionEntry * GlitterFile::findEntry(GlitterSection type, size_t index) const
+{
+  for (const GlitterSectionEntry & entry : m_directory) {
+    if (entry.type == static_cast<glm::uint32>(type) and entry.index == index) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+size_t GlitterFile::fileSize() const
+{
+  return m_file.size();
+}
+
+size_t GlitterFile::sectionCount(GlitterSection type) const
+{
+  size_t count = 0;
+  for (const GlitterSectionEntry & entry : m_directory) {
+    if (entry.type == static_cast<glm::uint32>(type)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+std::span<const char> GlitterFile::rawSection(GlitterSection type, size_t index) const
+{
+  const GlitterSectionEntry * entry = findEntry(type, index);
+  if (not entry) {
+    return {};
+  }
+  return std::span<const char>(payload(*entry), entry->size);
+}
+
+const char * GlitterFile::payload(const GlitterSectionEntry & entry) const
+{
+  const std::vector<char> & decompressed = m_decompressed[&entry - m_directory.data()];
+  return decompressed.empty() ? m_file.data() + entry.offset : decompressed.data();
+}
+
+size_t GlitterFile::elementSize(GlitterSection type, size_t index) const
+{
+  const GlitterSectionEntry * entry = findEntry(type, index);
+  if (not entry or entry->count == 0) {
+    return 0;
+  }
+  return entry->size / entry->count;
+}
+
+template <typename T> void GlitterFile::swapSections(GlitterSection type)
+{
+  for (const GlitterSectionEntry & entry : m_directory) {
+    // sections of the same type may use different element sizes (e.g. 16 or 32 bits IBOs)
+    if (entry.type == static_cast<glm::uint32>(type) and entry.size == entry.count * sizeof(T)) {
+      // either a decompressed buffer or the (copy-on-write) mapping
+      T * values = reinterpret_cast<T *>(const_cast<char *>(payload(entry)));
+      for (size_t k = 0; k < entry.size / sizeof(T); k++) {
+        swapEndianness(values[k]);
+      }
+    }
+  }
+}
+
+void GlitterFile::swapSections()
+{
+#ifdef IS_BIG_ENDIAN
+  // the mapping is private (copy-on-write), so that the values can be swapped in place
+  swapSections<glm::vec3>(GlitterSection::VertexPositions);
+  swapSections<glm::vec4>(GlitterSection::VertexColors);
+  swapSections<glm::vec2>(GlitterSection::VertexUVs);
+  swapSections<glm::vec3>(GlitterSection::VertexNormals);
+  swapSections<glm::vec3>(GlitterSection::VertexTangents);
+  swapSections<glm::uint16>(GlitterSection::IBO);
+  swapSections<glm::uint32>(GlitterSection::IBO);
+#endif
+}
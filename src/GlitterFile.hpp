@@ -0,0 +1,320 @@
+/** @file */
+#ifndef __GLITTER_GLITTER_FILE_H__
+#define __GLITTER_GLITTER_FILE_H__
+
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "Serialize.hpp"
+
+/// Magic number of the legacy (version 1, stream based) .glitter files
+#define GLITTER_BINFILE_MAGIC "GLITTER_BIN_OBJ\n"
+
+/// Magic number of the version 2 (sectioned, mappable) .glitter files
+#define GLITTER_BINFILE_MAGIC_V2 "GLITTER_BINOBJ2\n"
+
+/// Alignment (in bytes) of every section payload in a version 2 .glitter file
+#define GLITTER_SECTION_ALIGNMENT 64
+
+/// Size (in bytes) of the uncompressed blocks of a compressed section (rounded down to a multiple of the element size)
+#define GLITTER_BLOCK_SIZE (1 << 18)
+
+/**
+ * @brief Types of the sections stored in a version 2 .glitter file
+ *
+ * Several sections may share the same type (e.g. one IBO per material), they
+ * are then distinguished by their rank of appearance.
+ */
+enum class GlitterSection : glm::uint32
+{
+  VertexPositions = 1, ///< glm::vec3 array
+  VertexColors,        ///< glm::vec4 array
+  VertexUVs,           ///< glm::vec2 array
+  VertexNormals,       ///< glm::vec3 array
+  VertexTangents,      ///< glm::vec3 array
+  IBO,                 ///< glm::uint16 or glm::uint32 array (one section per material, see GlitterFile::elementSize)
+  TextureImageTable,   ///< serialized names and dimensions of the texture images
+  TextureImage,        ///< raw pixels (one section per entry of the TextureImageTable)
+  SimpleMaterials,     ///< serialized list of materials
+  BakedTextureTable,   ///< serialized names, formats and level dimensions of the textures prepared offline (see ::compressTexture)
+  BakedTexture,        ///< the levels of a texture prepared offline, one after the other (one section per entry of the BakedTextureTable)
+  PartBounds,          ///< glm::float32 array, the BoundingVolume of every IBO (10 floats each, missing in older files)
+};
+
+/**
+ * @brief Compression of the payload of a section
+ *
+ * A compressed payload is made of independent blocks (see ::compressBlock) of GlitterSectionEntry::blockSize
+ * uncompressed bytes, followed by the table of their compressed sizes (32 bits each). A block whose
+ * compressed size equals its uncompressed size is stored as is. If GlitterSectionEntry::elementSize is
+ * not 0, the blocks are filtered (see ::filterBlock) before being compressed.
+ */
+enum class GlitterCodec : glm::uint32
+{
+  None = 0, ///< raw payload (mappable without any copy)
+  LZ,       ///< block compressed payload
+};
+
+/**
+ * @brief An entry of the section directory of a version 2 .glitter file
+ */
+struct GlitterSectionEntry {
+  glm::uint32 type;         ///< the section type (see ::GlitterSection)
+  glm::uint32 index;        ///< rank of the section among the sections of the same type
+  std::uint64_t offset;     ///< offset of the payload from the beginning of the file (multiple of GLITTER_SECTION_ALIGNMENT)
+  std::uint64_t size;       ///< size of the payload in bytes (once decompressed)
+  std::uint64_t count;      ///< number of elements in the payload
+  glm::uint32 codec;        ///< compression of the payload (see ::GlitterCodec)
+  glm::uint32 elementSize;  ///< size of the elements given to the filter (0 if the payload is not filtered)
+  glm::uint32 wordSize;     ///< size of the numbers within the elements given to the filter
+  glm::uint32 blockSize;    ///< size of the uncompressed blocks in bytes (0 if the payload is not compressed)
+  std::uint64_t storedSize; ///< size of the payload in the file
+};
+
+/**
+ * @brief Writer for version 2 .glitter files
+ *
+ * The file starts with a fixed size header (magic number, version, section count
+ * and offset of the directory), followed by the section payloads, each one aligned
+ * on GLITTER_SECTION_ALIGNMENT bytes. The section directory is written at the end
+ * of the file and the header is patched when the writer is closed.
+ * All values are stored in little endian.
+ *
+ * A section may also be streamed (GlitterWriter::beginSection, GlitterWriter::appendToSection,
+ * GlitterWriter::endSection), so that its payload never has to be resident in memory.
+ * Only one section can be open at a time.
+ *
+ * If compression is enabled, the payloads are cut into blocks that are filtered and compressed
+ * on several threads (see ::GlitterCodec). Compressed sections are no longer mappable: GlitterFile
+ * decompresses them when the file is opened.
+ */
+class GlitterWriter {
+public:
+  /**
+   * @brief Opens a file and writes a placeholder header
+   * @param filename the name of the output file
+   * @param compress whether the sections are compressed (see ::GlitterCodec)
+   * @param nbThreads the number of threads compressing the blocks (0 means ::defaultThreadCount)
+   */
+  GlitterWriter(const std::string & filename, bool compress = false, unsigned int nbThreads = 0);
+  GlitterWriter(const GlitterWriter &) = delete;
+  GlitterWriter & operator=(const GlitterWriter &) = delete;
+
+  /**
+   * @brief Destructor (closes the file if it was not already done)
+   */
+  ~GlitterWriter();
+
+  /**
+   * @brief appends a section made of an array of values
+   * @param type the section type
+   * @param values the payload
+   */
+  template <typename T> void writeSection(GlitterSection type, const std::vector<T> & values);
+
+  /**
+   * @brief appends a section made of raw bytes
+   * @param type the section type
+   * @param data the payload
+   * @param size the size of the payload in bytes
+   * @param count the number of elements in the payload
+   */
+  void writeSection(GlitterSection type, const char * data, std::uint64_t size, std::uint64_t count);
+
+  /**
+   * @brief starts a streamed section
+   * @param type the section type
+   * @param elementSize the size of the elements given to the compression filter (0 disables the filter)
+   * @param wordSize the size of the numbers within the elements (1, 2 or 4 bytes)
+   */
+  void beginSection(GlitterSection type, glm::uint32 elementSize = 0, glm::uint32 wordSize = 1);
+
+  /**
+   * @brief starts a streamed section made of an array of values
+   * @param type the section type
+   */
+  template <typename T> void beginSection(GlitterSection type);
+
+  /**
+   * @brief appends values to the streamed section
+   * @param values a chunk of the payload
+   */
+  template <typename T> void appendToSection(std::span<const T> values);
+
+  /**
+   * @brief appends raw bytes to the streamed section
+   * @param data a chunk of the payload
+   * @param size the size of the chunk in bytes
+   * @param count the number of elements in the chunk
+   */
+  void appendToSection(const char * data, std::uint64_t size, std::uint64_t count);
+
+  /**
+   * @brief ends the streamed section and adds it to the directory
+   */
+  void endSection();
+
+  /**
+   * @brief writes the section directory and patches the header
+   */
+  void close();
+
+private:
+  /// pads the file so that the next write is aligned on GLITTER_SECTION_ALIGNMENT
+  void align();
+
+  /// compresses and writes the pending blocks (including the last incomplete one if @p all)
+  void flushBlocks(bool all);
+
+private:
+  std::ofstream m_file;                          ///< the output file
+  std::vector<GlitterSectionEntry> m_directory;  ///< the sections written so far
+  GlitterSectionEntry m_openSection;             ///< the streamed section (if any)
+  bool m_sectionOpen = false;                    ///< whether a section is being streamed
+  bool m_compress;                               ///< whether the sections are compressed
+  unsigned int m_nbThreads;                      ///< number of threads compressing the blocks
+  std::vector<char> m_pendingBytes;              ///< bytes of the open section not compressed yet
+  std::vector<glm::uint32> m_blockSizes;         ///< compressed sizes of the blocks of the open section
+};
+
+/**
+ * @brief Mapping reader for version 2 .glitter files
+ *
+ * The file is mapped in memory and the section payloads are exposed as spans
+ * pointing directly into the mapping, so that reading a section does not copy it
+ * (the span uploads of glApi copy the values before sending them). The blocks of the compressed sections are decompressed
+ * in parallel into buffers owned by this instance. The spans remain valid as long as
+ * this instance is alive.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class GlitterFile {
+public:
+  /**
+   * @brief Maps a version 2 .glitter file, reads its section directory and loads the sections
+   * @param filename the name of the file
+   * @param nbThreads the number of threads loading the sections (0 means ::defaultThreadCount)
+   * @param prefetch whether the raw sections are read right away (otherwise their pages are only read when accessed)
+   *
+   * Thanks to the directory, every section (and every block of a compressed section) is loaded
+   * independently: the blocks of all the sections are dispatched together to the threads.
+   */
+  GlitterFile(const std::string & filename, unsigned int nbThreads = 0, bool prefetch = true);
+  GlitterFile(const GlitterFile &) = delete;
+  GlitterFile & operator=(const GlitterFile &) = delete;
+
+  /**
+   * @brief checks whether a file starts with the version 2 magic number
+   * @param filename the name of the file
+   */
+  static bool isVersion2(const std::string & filename);
+
+  /**
+   * @brief fileSize
+   * @return the size of the file in bytes
+   */
+  size_t fileSize() const;
+
+  /**
+   * @brief counts the sections of a given type
+   * @param type the section type
+   * @return the number of sections of type @p type
+   */
+  size_t sectionCount(GlitterSection type) const;
+
+  /**
+   * @brief retrieves the raw payload of a section
+   * @param type the section type
+   * @param index the rank of the section among the sections of the same type
+   * @return the payload bytes (empty if there is no such section)
+   */
+  std::span<const char> rawSection(GlitterSection type, size_t index = 0) const;
+
+  /**
+   * @brief provides the size of the elements of a section
+   * @param type the section type
+   * @param index the rank of the section among the sections of the same type
+   * @return the size of an element in bytes (0 if there is no such section or if it is empty)
+   */
+  size_t elementSize(GlitterSection type, size_t index = 0) const;
+
+  /**
+   * @brief retrieves the payload of a section as an array of values
+   * @param type the section type
+   * @param index the rank of the section among the sections of the same type
+   * @return the values (empty if there is no such section)
+   */
+  template <typename T> std::span<const T> section(GlitterSection type, size_t index = 0) const;
+
+private:
+  /// finds an entry of the directory (or nullptr)
+  const GlitterSectionEntry * findEntry(GlitterSection type, size_t index) const;
+
+  /// provides the (decompressed) payload of an entry of the directory
+  const char * payload(const GlitterSectionEntry & entry) const;
+
+  /// decompresses the blocks of the compressed sections and prefetches the other sections (if @p prefetch) on the shared thread pool
+  void loadSections(const std::string & filename, unsigned int nbThreads, bool prefetch);
+
+  /// converts the typed sections to the host endianness (big endian hosts only)
+  void swapSections();
+
+  /// converts the values of all sections of a given type to the host endianness
+  template <typename T> void swapSections(GlitterSection type);
+
+private:
+  MappedFile m_file;                             ///< the memory mapping
+  std::vector<GlitterSectionEntry> m_directory;  ///< the section directory
+  std::vector<std::vector<char>> m_decompressed; ///< payloads of the compressed sections (one per entry of the directory)
+};
+
+/*
+ * Definition of method templates
+ */
+template <typename T> void GlitterWriter::writeSection(GlitterSection type, const std::vector<T> & values)
+{
+  static_assert(SerializationTraits<T>::IsSerializable, "GlitterWriter::writeSection(): Element type is not serializable");
+  beginSection<T>(type);
+#ifdef IS_BIG_ENDIAN
+  std::vector<T> duplicate = values;
+  for (T & value : duplicate) {
+    swapEndianness(value);
+  }
+  appendToSection(reinterpret_cast<const char *>(duplicate.data()), duplicate.size() * sizeof(T), duplicate.size());
+#else
+  appendToSection(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T), values.size());
+#endif
+  endSection();
+}
+
+template <typename T> void GlitterWriter::beginSection(GlitterSection type)
+{
+  // the numbers within the elements: glm vectors are made of 4 bytes components
+  glm::uint32 wordSize = (sizeof(T) % 4 == 0) ? 4 : (sizeof(T) % 2 == 0) ? 2 : 1;
+  beginSection(type, sizeof(T), wordSize);
+}
+
+template <typename T> void GlitterWriter::appendToSection(std::span<const T> values)
+{
+  static_assert(SerializationTraits<T>::IsSerializable, "GlitterWriter::appendToSection(): Element type is not serializable");
+#ifdef IS_BIG_ENDIAN
+  std::vector<T> duplicate(values.begin(), values.end());
+  for (T & value : duplicate) {
+    swapEndianness(value);
+  }
+  appendToSection(reinterpret_cast<const char *>(duplicate.data()), duplicate.size() * sizeof(T), duplicate.size());
+#else
+  appendToSection(reinterpret_cast<const char *>(values.data()), values.size_bytes(), values.size());
+#endif
+}
+
+template <typename T> std::span<const T> GlitterFile::section(GlitterSection type, size_t index) const
+{
+  std::span<const char> bytes = rawSection(type, index);
+  return std::span<const T>(reinterpret_cast<const T *>(bytes.data()), bytes.size() / sizeof(T));
+}
+
+#endif // !defined(__GLITTER_GLITTER_FILE_H__)
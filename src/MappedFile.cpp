@@ -0,0 +1,96 @@
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#define GLITTER_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string & filename, bool copyOnWrite) : m_data(nullptr), m_size(0)
+{
+#ifdef GLITTER_HAS_MMAP
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Unable to open file: " << filename << std::endl;
+    exit(1);
+  }
+  struct stat status;
+  if (fstat(fd, &status) < 0) {
+    std::cerr << "Unable to stat file: " << filename << std::endl;
+    exit(1);
+  }
+  m_size = status.st_size;
+  if (m_size > 0) {
+    int protection = copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void * address = mmap(nullptr, m_size, protection, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      std::cerr << "Unable to map file: " << filename << std::endl;
+      exit(1);
+    }
+    m_data = static_cast<char *>(address);
+  }
+  // the mapping remains valid once the descriptor is closed
+  close(fd);
+#else
+  (void)copyOnWrite;
+  std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Unable to open file: " << filename << std::endl;
+    exit(1);
+  }
+  m_size = file.tellg();
+  m_buffer.resize(m_size);
+  file.seekg(0);
+  file.read(m_buffer.data(), m_size);
+  m_data = m_buffer.data();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef GLITTER_HAS_MMAP
+  if (m_data) {
+    munmap(m_data, m_size);
+  }
+#endif
+}
+
+const char * MappedFile::data() const
+{
+  return m_data;
+}
+
+char * MappedFile::mutableData()
+{
+  return m_data;
+}
+
+size_t MappedFile::size() const
+{
+  return m_size;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const
+{
+#ifdef GLITTER_HAS_MMAP
+  size = std::min(size, m_size - std::min(offset, m_size));
+  if (size == 0) {
+    return;
+  }
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t begin = offset - offset % pageSize;
+  madvise(m_data + begin, offset + size - begin, MADV_WILLNEED);
+  // reading a byte of every page waits until the page is resident
+  volatile char sink = 0;
+  for (size_t position = begin; position < offset + size; position += pageSize) {
+    sink = sink + m_data[position];
+  }
+#else
+  (void)offset;
+  (void)size;
+#endif
+}
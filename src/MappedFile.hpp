@@ -0,0 +1,67 @@
+#ifndef __GLITTER_MAPPED_FILE_H__
+#define __GLITTER_MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A read-only view of a whole file mapped in memory.
+ *
+ * On POSIX systems the file is mapped with ::mmap, so that its pages are only
+ * loaded when they are accessed (and shared with the page cache). On other
+ * systems the content of the file is read in a heap buffer.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class MappedFile {
+public:
+  /**
+   * @brief Maps a file in memory
+   * @param filename the name of the file to be mapped
+   * @param copyOnWrite if true, the mapping is private and writable (modifications are not written back to the file)
+   */
+  MappedFile(const std::string & filename, bool copyOnWrite = false);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  /**
+   * @brief Destructor (unmaps the file)
+   */
+  ~MappedFile();
+
+  /**
+   * @brief data
+   * @return the address of the first byte of the file
+   */
+  const char * data() const;
+
+  /**
+   * @brief mutableData
+   * @return the address of the first byte of the file (only valid for copy-on-write mappings)
+   */
+  char * mutableData();
+
+  /**
+   * @brief size
+   * @return the size of the file in bytes
+   */
+  size_t size() const;
+
+  /**
+   * @brief loads the pages of a range of the file in memory, so that later accesses do not wait for the storage
+   * @param offset the first byte of the range
+   * @param size the size of the range in bytes
+   *
+   * Prefetching several ranges from several threads keeps several reads in flight.
+   * Does nothing if the file was read in a heap buffer.
+   */
+  void prefetch(size_t offset, size_t size) const;
+
+private:
+  char * m_data;               ///< first byte of the mapping
+  size_t m_size;               ///< size of the mapping
+  std::vector<char> m_buffer;  ///< fallback storage when memory mapping is not available
+};
+
+#endif // !defined(__GLITTER_MAPPED_FILE_H__)
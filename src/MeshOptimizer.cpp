@@ -0,0 +1,219 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include "Parallel.hpp"
+
+namespace
+{
+/// size of the LRU cache used to score the vertices
+const int scoringCacheSize = 32;
+
+/// largest number of remaining triangles distinguished by the valence scores
+const unsigned int maxValence = 64;
+
+/// scores tabulated by cache position (-1 for vertices out of the cache) and number of remaining triangles
+class ScoreTable {
+public:
+  ScoreTable()
+  {
+    for (int position = -1; position < scoringCacheSize; position++) {
+      for (unsigned int valence = 0; valence <= maxValence; valence++) {
+        m_scores[position + 1][valence] = computeScore(position, valence);
+      }
+    }
+  }
+
+  float operator()(int position, unsigned int valence) const
+  {
+    return m_scores[position + 1][std::min(valence, maxValence)];
+  }
+
+private:
+  static float computeScore(int position, unsigned int valence)
+  {
+    if (valence == 0) {
+      return -1;
+    }
+    float score = 0;
+    if (position >= 0 and position < 3) {
+      // the vertices of the last triangle get a fixed score, so that strips are not favoured over fans
+      score = 0.75f;
+    } else if (position >= 3) {
+      score = std::pow(1 - float(position - 3) / (scoringCacheSize - 3), 1.5f);
+    }
+    // vertices with few remaining triangles are boosted, so that they are not left alone
+    return score + 2.f / std::sqrt(float(valence));
+  }
+
+private:
+  float m_scores[scoringCacheSize + 1][maxValence + 1];
+};
+
+const unsigned int noTriangle = ~0u;
+} // namespace
+
+MeshOptimizer::MeshOptimizer(unsigned int cacheSize, unsigned int nbThreads) : m_cacheSize(cacheSize), m_nbThreads(nbThreads) {}
+
+VertexCacheStatistics MeshOptimizer::analyze(const std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices) const
+{
+  // a vertex is in the FIFO if fewer than m_cacheSize misses occurred since it was inserted
+  std::vector<size_t> insertionTime(nbVertices, 0);
+  std::vector<bool> referenced(nbVertices, false);
+  size_t misses = 0;
+  size_t time = m_cacheSize + 1;
+  size_t nbTriangles = 0;
+  for (const std::vector<unsigned int> & ibo : ibos) {
+    for (unsigned int index : ibo) {
+      if (time - insertionTime[index] > m_cacheSize) {
+        insertionTime[index] = time++;
+        misses++;
+      }
+      referenced[index] = true;
+    }
+    nbTriangles += ibo.size() / 3;
+    // flushes the cache between draw calls
+    time += m_cacheSize + 1;
+  }
+  size_t nbReferenced = std::count(referenced.begin(), referenced.end(), true);
+
+  VertexCacheStatistics statistics;
+  statistics.acmr = nbTriangles ? double(misses) / nbTriangles : 0;
+  statistics.atvr = nbReferenced ? double(misses) / nbReferenced : 0;
+  return statistics;
+}
+
+void MeshOptimizer::optimizeTriangleOrder(std::vector<std::vector<unsigned int>> & ibos) const
+{
+  parallelFor(ibos.size(), [&](size_t k) { optimizeTriangleOrder(ibos[k]); }, m_nbThreads);
+}
+
+void MeshOptimizer::optimizeTriangleOrder(std::vector<unsigned int> & indices) const
+{
+  static const ScoreTable score;
+  size_t nbTriangles = indices.size() / 3;
+  if (nbTriangles == 0) {
+    return;
+  }
+
+  // compact numbering of the vertices referenced by this IBO
+  std::vector<unsigned int> vertices(indices);
+  std::sort(vertices.begin(), vertices.end());
+  vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+  size_t nbVertices = vertices.size();
+  std::vector<unsigned int> corners(3 * nbTriangles);
+  for (size_t c = 0; c < corners.size(); c++) {
+    corners[c] = std::lower_bound(vertices.begin(), vertices.end(), indices[c]) - vertices.begin();
+  }
+
+  // triangles adjacent to every vertex, the live ones being kept at the front of each list
+  std::vector<unsigned int> liveTriangles(nbVertices, 0);
+  for (unsigned int v : corners) {
+    liveTriangles[v]++;
+  }
+  std::vector<unsigned int> adjacencyOffsets(nbVertices + 1, 0);
+  for (size_t v = 0; v < nbVertices; v++) {
+    adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+  }
+  std::vector<unsigned int> adjacency(corners.size());
+  std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+  for (size_t c = 0; c < corners.size(); c++) {
+    adjacency[fill[corners[c]]++] = c / 3;
+  }
+
+  std::vector<int> cachePositions(nbVertices, -1);
+  std::vector<float> vertexScores(nbVertices);
+  for (size_t v = 0; v < nbVertices; v++) {
+    vertexScores[v] = score(-1, liveTriangles[v]);
+  }
+  std::vector<float> triangleScores(nbTriangles);
+  for (size_t t = 0; t < nbTriangles; t++) {
+    triangleScores[t] = vertexScores[corners[3 * t]] + vertexScores[corners[3 * t + 1]] + vertexScores[corners[3 * t + 2]];
+  }
+
+  std::vector<bool> emitted(nbTriangles, false);
+  std::vector<unsigned int> cache;
+  std::vector<unsigned int> newCache;
+  cache.reserve(scoringCacheSize + 3);
+  newCache.reserve(scoringCacheSize + 3);
+  std::vector<unsigned int> result;
+  result.reserve(3 * nbTriangles);
+  size_t cursor = 0;
+  unsigned int bestTriangle = noTriangle;
+  while (result.size() < 3 * nbTriangles) {
+    if (bestTriangle == noTriangle) {
+      // no live triangle around the cache: restarts from the first triangle left
+      while (emitted[cursor]) {
+        cursor++;
+      }
+      bestTriangle = cursor;
+    }
+    emitted[bestTriangle] = true;
+    newCache.clear();
+    for (int c = 0; c < 3; c++) {
+      result.push_back(indices[3 * bestTriangle + c]);
+      unsigned int v = corners[3 * bestTriangle + c];
+      // removes the triangle from the live part of the adjacency list
+      unsigned int * begin = adjacency.data() + adjacencyOffsets[v];
+      unsigned int * last = begin + liveTriangles[v] - 1;
+      std::swap(*std::find(begin, last + 1, bestTriangle), *last);
+      liveTriangles[v]--;
+      if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+        newCache.push_back(v);
+      }
+    }
+    for (unsigned int v : cache) {
+      if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+        newCache.push_back(v);
+      }
+    }
+
+    // updates the scores of the vertices whose cache position or valence changed
+    for (size_t position = 0; position < newCache.size(); position++) {
+      unsigned int v = newCache[position];
+      cachePositions[v] = (position < scoringCacheSize) ? int(position) : -1;
+      float newScore = score(cachePositions[v], liveTriangles[v]);
+      float delta = newScore - vertexScores[v];
+      vertexScores[v] = newScore;
+      for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + liveTriangles[v]; a++) {
+        triangleScores[adjacency[a]] += delta;
+      }
+    }
+    newCache.resize(std::min<size_t>(newCache.size(), scoringCacheSize));
+    cache.swap(newCache);
+
+    // the next triangle is the best one around the cache
+    bestTriangle = noTriangle;
+    float bestScore = -1;
+    for (unsigned int v : cache) {
+      for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + liveTriangles[v]; a++) {
+        unsigned int t = adjacency[a];
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          bestTriangle = t;
+        }
+      }
+    }
+  }
+  indices.swap(result);
+}
+
+std::vector<unsigned int> MeshOptimizer::optimizeVertexOrder(std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices) const
+{
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> newIndices(nbVertices, unused);
+  unsigned int nextIndex = 0;
+  for (std::vector<unsigned int> & ibo : ibos) {
+    for (unsigned int & index : ibo) {
+      if (newIndices[index] == unused) {
+        newIndices[index] = nextIndex++;
+      }
+      index = newIndices[index];
+    }
+  }
+  for (unsigned int & newIndex : newIndices) {
+    if (newIndex == unused) {
+      newIndex = nextIndex++;
+    }
+  }
+  return newIndices;
+}
@@ -0,0 +1,66 @@
+/** @file */
+#ifndef __GLITTER_MESH_OPTIMIZER_H__
+#define __GLITTER_MESH_OPTIMIZER_H__
+
+#include <span>
+#include <vector>
+
+/**
+ * @brief Post-transform vertex cache statistics of a list of IBOs
+ */
+struct VertexCacheStatistics {
+  double acmr = 0; ///< average cache miss ratio (transformed vertices per triangle, 0.5 is optimal for large grids)
+  double atvr = 0; ///< average transformed vertex ratio (transformed vertices per referenced vertex, 1 is optimal)
+};
+
+/**
+ * @brief Reorders triangles and vertices for the GPU caches
+ *
+ * The triangles of every IBO are reordered with the algorithm of Tom Forsyth
+ * ("Linear-speed vertex cache optimisation"): the next triangle is greedily
+ * chosen among the triangles adjacent to the vertices of a simulated LRU cache,
+ * favouring recently used vertices and vertices with few remaining triangles.
+ * The vertices are then renumbered in their order of first use, so that the
+ * vertex fetches become (almost) sequential.
+ */
+class MeshOptimizer {
+public:
+  /**
+   * @brief Constructor
+   * @param cacheSize size of the FIFO cache simulated by MeshOptimizer::analyze
+   * @param nbThreads number of threads (the IBOs are optimized independently, 0 means one per hardware thread)
+   */
+  MeshOptimizer(unsigned int cacheSize = 16, unsigned int nbThreads = 0);
+
+  /**
+   * @brief simulates a FIFO post-transform cache (reset between IBOs)
+   * @param ibos the triangle lists
+   * @param nbVertices the number of vertices referenced by @p ibos
+   * @return the cache statistics
+   */
+  VertexCacheStatistics analyze(const std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices) const;
+
+  /**
+   * @brief reorders the triangles of every IBO in place
+   * @param ibos the triangle lists
+   */
+  void optimizeTriangleOrder(std::vector<std::vector<unsigned int>> & ibos) const;
+
+  /**
+   * @brief renumbers the vertices in their order of first use (IBOs are processed in order)
+   * @param ibos the triangle lists, whose indices are updated
+   * @param nbVertices the number of vertices
+   * @return for every vertex, its new index (unreferenced vertices are moved at the end)
+   */
+  std::vector<unsigned int> optimizeVertexOrder(std::vector<std::vector<unsigned int>> & ibos, size_t nbVertices) const;
+
+private:
+  /// reorders the triangles of a single IBO
+  void optimizeTriangleOrder(std::vector<unsigned int> & indices) const;
+
+private:
+  unsigned int m_cacheSize; ///< size of the simulated FIFO cache
+  unsigned int m_nbThreads; ///< number of threads
+};
+
+#endif // !defined(__GLITTER_MESH_OPTIMIZER_H__)
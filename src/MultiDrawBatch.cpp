@@ -0,0 +1,140 @@
+#include "MultiDrawBatch.hpp"
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace
+{
+/// writes bytes to the current region of a streaming buffer (reallocated with larger regions when they do not fit), returns the offset of the region
+size_t stream(std::unique_ptr<StreamingBuffer> & buffer, GLenum target, std::span<const char> bytes, size_t granularity)
+{
+  if (not buffer or buffer->regionSize() < bytes.size()) {
+    // the regions are multiples of the granularity, and so are their offsets
+    size_t capacity = buffer ? std::max(bytes.size(), 2 * buffer->regionSize()) : std::max<size_t>(bytes.size(), 4096);
+    capacity = (capacity + granularity - 1) / granularity * granularity;
+    buffer = std::make_unique<StreamingBuffer>(target, capacity);
+  }
+  std::span<char> region = buffer->beginWrite();
+  std::copy(bytes.begin(), bytes.end(), region.begin());
+  return buffer->endWrite(bytes.size());
+}
+} // namespace
+
+MultiDrawBatch::MultiDrawBatch(const VertexLayout & layout, uint drawIndexAttribute, uint materialBinding, size_t materialSize)
+    : m_layout(std::make_shared<const VertexLayout>(layout)), m_drawIndexAttribute(drawIndexAttribute), m_materialBinding(materialBinding), m_materialSize(materialSize)
+{
+  uint nbVBO = 0;
+  for (const VertexLayout::Attribute & attribute : layout.attributes()) {
+    nbVBO = std::max(nbVBO, attribute.index + 1);
+  }
+  m_vao = std::make_unique<VAO>(nbVBO);
+  GLint alignment = 1;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  m_materialAlignment = std::max(alignment, 1);
+}
+
+bool MultiDrawBatch::supported()
+{
+  return GLEW_ARB_multi_draw_indirect and GLEW_ARB_shader_storage_buffer_object;
+}
+
+int MultiDrawBatch::addVertices(std::span<const char> vertices)
+{
+  assert(vertices.size() % m_layout->stride() == 0);
+  int baseVertex = m_vertices.size() / m_layout->stride();
+  m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+  return baseVertex;
+}
+
+void MultiDrawBatch::addDraw(uint mesh, uint group, std::span<const char> material)
+{
+  assert(mesh < m_meshes.size() and material.size() == m_materialSize);
+  m_draws.push_back(Draw{mesh, group});
+  m_materials.insert(m_materials.end(), material.begin(), material.end());
+}
+
+void MultiDrawBatch::upload()
+{
+  // the new meshes are appended in place, the geometry is only sent again when it outgrows the buffers (twice as large each time)
+  if (m_vertices.size() > m_vertexCapacity) {
+    m_vertexCapacity = std::max(m_vertices.size(), 2 * m_vertexCapacity);
+    std::vector<char> vertices(m_vertices);
+    vertices.resize(m_vertexCapacity);
+    m_vao->setInterleavedVBO(*m_layout, vertices);
+  } else if (m_vertices.size() > m_uploadedVertices) {
+    m_vao->updateInterleavedVBO(m_uploadedVertices, std::span<const char>(m_vertices).subspan(m_uploadedVertices));
+  }
+  m_uploadedVertices = m_vertices.size();
+  if (m_indices.size() > m_indexCapacity) {
+    // 32 bits indices (see VAO::updateIBO)
+    m_indexCapacity = std::max(m_indices.size(), 2 * m_indexCapacity);
+    std::vector<uint> indices(m_indices);
+    indices.resize(m_indexCapacity);
+    m_vao->setIBO(indices);
+  } else if (m_indices.size() > m_uploadedIndices) {
+    m_vao->updateIBO(m_uploadedIndices, std::span<const uint>(m_indices).subspan(m_uploadedIndices));
+  }
+  m_uploadedIndices = m_indices.size();
+  m_groupOffsets.clear();
+  if (m_draws.empty()) {
+    return;
+  }
+  if (m_draws.size() > m_nbDrawIndices) {
+    // the index of a draw is the per-instance attribute fetched at its base instance
+    m_nbDrawIndices = std::max<uint>(2 * m_nbDrawIndices, m_draws.size());
+    std::vector<int> drawIndices(m_nbDrawIndices);
+    std::iota(drawIndices.begin(), drawIndices.end(), 0);
+    VertexLayout drawIndexLayout;
+    drawIndexLayout.add<int>(m_drawIndexAttribute);
+    m_vao->setInstanceVBO(drawIndexLayout, std::span<const char>(reinterpret_cast<const char *>(drawIndices.data()), drawIndices.size() * sizeof(int)));
+  }
+  // counting sort of the draws by group (the materials stay in submission order)
+  uint nbGroups = 0;
+  for (const Draw & draw : m_draws) {
+    nbGroups = std::max(nbGroups, draw.group + 1);
+  }
+  m_groupOffsets.assign(nbGroups + 1, 0);
+  for (const Draw & draw : m_draws) {
+    m_groupOffsets[draw.group + 1]++;
+  }
+  std::partial_sum(m_groupOffsets.begin(), m_groupOffsets.end(), m_groupOffsets.begin());
+  std::vector<uint> next(m_groupOffsets.begin(), m_groupOffsets.end() - 1);
+  m_commands.resize(m_draws.size());
+  for (uint d = 0; d < m_draws.size(); d++) {
+    const Mesh & mesh = m_meshes[m_draws[d].mesh];
+    m_commands[next[m_draws[d].group]++] = DrawElementsIndirectCommand{mesh.count, 1, mesh.firstIndex, mesh.baseVertex, d};
+  }
+  // the commands and the materials are written to the regions of the frame, without reallocating any storage
+  std::span<const char> commands(reinterpret_cast<const char *>(m_commands.data()), m_commands.size() * sizeof(DrawElementsIndirectCommand));
+  m_firstCommand = stream(m_commandBuffer, GL_DRAW_INDIRECT_BUFFER, commands, sizeof(DrawElementsIndirectCommand)) / sizeof(DrawElementsIndirectCommand);
+  size_t materialOffset = stream(m_materialBuffer, GL_SHADER_STORAGE_BUFFER, m_materials, m_materialAlignment);
+  m_materialBuffer->bindRange(m_materialBinding, materialOffset, m_materials.size());
+  m_streamed = true;
+}
+
+void MultiDrawBatch::draw(uint group, GLenum mode) const
+{
+  if (group + 1 >= m_groupOffsets.size() or m_groupOffsets[group] == m_groupOffsets[group + 1]) {
+    return;
+  }
+  m_commandBuffer->bind();
+  m_vao->multiDrawIndirect(m_firstCommand + m_groupOffsets[group], m_groupOffsets[group + 1] - m_groupOffsets[group], mode);
+  m_commandBuffer->unbind();
+}
+
+void MultiDrawBatch::clear()
+{
+  if (m_streamed) {
+    // the draw calls of the frame are issued: their regions are reused once they are executed
+    m_commandBuffer->fence();
+    m_materialBuffer->fence();
+    m_streamed = false;
+  }
+  m_draws.clear();
+  m_materials.clear();
+}
+
+size_t MultiDrawBatch::nbDraws() const
+{
+  return m_draws.size();
+}
@@ -0,0 +1,151 @@
+/** @file */
+#ifndef __GLITTER_MULTI_DRAW_BATCH_H__
+#define __GLITTER_MULTI_DRAW_BATCH_H__
+
+#include <memory>
+#include <span>
+#include <vector>
+#include "glApi.hpp"
+
+/**
+ * @brief Meshes sharing a single VAO, drawn by a handful of ::glMultiDrawElementsIndirect calls
+ *
+ * The vertices of all the meshes are appended to one interleaved VBO, and their indices to one
+ * IBO (the indices of a mesh are relative to its own vertices, the base vertex being added by
+ * OpenGL). The VBO and the IBO grow geometrically: the meshes added since the last upload are
+ * appended in place, the whole geometry being sent again only when it outgrows them. Every frame,
+ * the draws are described on the CPU by a DrawElementsIndirectCommand and a material (a struct
+ * of the Materials shader storage block), then written to a region of a StreamingBuffer.
+ *
+ * The draws are split into groups (e.g. by texture set): all the draws of a group are made by a
+ * single call to MultiDrawBatch::draw. Each draw is a single instance whose base instance is the
+ * index of the draw, so that its index can be read from a per-instance attribute (without
+ * ::gl_DrawID, which requires OpenGL 4.6) and used to fetch its material:
+ * @code
+ * layout(location = 4) in int vertexDrawIndex;
+ * layout(std430) buffer Materials {
+ *   DrawMaterial materials[];
+ * };
+ * @endcode
+ *
+ * @note The batch must only be used by the thread owning the OpenGL context.
+ */
+class MultiDrawBatch {
+public:
+  /**
+   * @brief Constructor
+   * @param layout the interleaved attributes of the vertices
+   * @param drawIndexAttribute the anchor point of the (int) index of the draw
+   * @param materialBinding the binding point of the Materials shader storage block (see Program::setStorageBlockBinding)
+   * @param materialSize the size of a material (a std430 struct, e.g. written with a Std140Writer when the layouts agree)
+   */
+  MultiDrawBatch(const VertexLayout & layout, uint drawIndexAttribute, uint materialBinding, size_t materialSize);
+
+  MultiDrawBatch(const MultiDrawBatch &) = delete;
+  MultiDrawBatch & operator=(const MultiDrawBatch &) = delete;
+
+  /**
+   * @brief tells whether the OpenGL context supports multi draw indirect and shader storage buffers (OpenGL 4.3)
+   * @return true if the batch can be used
+   */
+  static bool supported();
+
+  /**
+   * @brief appends vertices to the VBO
+   * @param vertices the packed vertices (whose size is a multiple of the stride of the layout)
+   * @return the base vertex of the meshes made of these vertices
+   */
+  int addVertices(std::span<const char> vertices);
+
+  /**
+   * @brief appends a mesh to the IBO
+   * @param baseVertex the base vertex returned by MultiDrawBatch::addVertices
+   * @param indices the indices of the triangles, relative to the base vertex
+   * @return the mesh, to be drawn with MultiDrawBatch::addDraw
+   */
+  template <typename T> uint addMesh(int baseVertex, std::span<const T> indices);
+
+  /**
+   * @brief adds a draw to the current frame
+   * @param mesh the mesh returned by MultiDrawBatch::addMesh
+   * @param group the group of the draw (e.g. the index of its texture set)
+   * @param material the material of the draw (of the size given at construction)
+   */
+  void addDraw(uint mesh, uint group, std::span<const char> material);
+
+  /**
+   * @brief sends the new meshes, and the draws and materials of the current frame
+   *
+   * The Materials block is then attached to its binding point (the range of the current frame).
+   */
+  void upload();
+
+  /**
+   * @brief draws a group of the current frame, with a single ::glMultiDrawElementsIndirect call
+   * @param group the group
+   * @param mode primitive type
+   *
+   * @note The program and the textures of the group must be bound.
+   */
+  void draw(uint group, GLenum mode = GL_TRIANGLES) const;
+
+  /**
+   * @brief forgets the draws of the current frame (the meshes are kept)
+   *
+   * The regions read by the draw calls issued since the last upload are protected until they are executed (see StreamingBuffer::fence).
+   */
+  void clear();
+
+  /**
+   * @brief counts the draws of the current frame
+   * @return the number of draws
+   */
+  size_t nbDraws() const;
+
+private:
+  /// A mesh of the batch
+  struct Mesh {
+    uint firstIndex; ///< index of its first index in the IBO
+    uint count;      ///< number of indices
+    int baseVertex;  ///< index of its first vertex in the VBO
+  };
+
+  /// A draw of the current frame
+  struct Draw {
+    uint mesh;  ///< the mesh drawn
+    uint group; ///< the group of the draw
+  };
+
+private:
+  std::shared_ptr<const VertexLayout> m_layout;        ///< the layout of the vertices
+  uint m_drawIndexAttribute;                           ///< anchor point of the index of the draw
+  uint m_materialBinding;                              ///< binding point of the Materials block
+  size_t m_materialSize;                               ///< size of a material
+  size_t m_materialAlignment = 1;                      ///< alignment of the offsets of the materials in their storage buffer (queried once)
+  std::vector<char> m_vertices;                        ///< the vertices of all the meshes (sent again when the VBO grows)
+  std::vector<uint> m_indices;                         ///< the indices of all the meshes (sent again when the IBO grows)
+  std::vector<Mesh> m_meshes;                          ///< the meshes
+  size_t m_uploadedVertices = 0;                       ///< number of bytes of m_vertices in the VBO
+  size_t m_vertexCapacity = 0;                         ///< size of the VBO in bytes
+  size_t m_uploadedIndices = 0;                        ///< number of indices of m_indices in the IBO
+  size_t m_indexCapacity = 0;                          ///< size of the IBO in indices
+  std::vector<Draw> m_draws;                           ///< the draws of the current frame
+  std::vector<char> m_materials;                       ///< the materials of the draws of the current frame
+  std::vector<DrawElementsIndirectCommand> m_commands; ///< the commands of the current frame, sorted by group
+  std::vector<uint> m_groupOffsets;                    ///< index of the first command of each group (and the number of commands)
+  uint m_nbDrawIndices = 0;                            ///< number of draw indices in the per-instance VBO
+  uint m_firstCommand = 0;                             ///< index of the first command of the current frame in m_commandBuffer
+  bool m_streamed = false;                             ///< whether the current frame was written to the streaming buffers
+  std::unique_ptr<VAO> m_vao;                          ///< the VAO of all the meshes
+  std::unique_ptr<StreamingBuffer> m_commandBuffer;    ///< the GL_DRAW_INDIRECT_BUFFER (grown when the commands do not fit)
+  std::unique_ptr<StreamingBuffer> m_materialBuffer;   ///< the GL_SHADER_STORAGE_BUFFER of the materials (grown when they do not fit)
+};
+
+template <typename T> uint MultiDrawBatch::addMesh(int baseVertex, std::span<const T> indices)
+{
+  m_meshes.push_back(Mesh{uint(m_indices.size()), uint(indices.size()), baseVertex});
+  m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+  return m_meshes.size() - 1;
+}
+
+#endif // !defined(__GLITTER_MULTI_DRAW_BATCH_H__)
@@ -1,10 +1,24 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <string_view>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "ObjLoader.hpp"
+#include <sstream>
+#include "GlitterFile.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
 #include "Serialize.hpp"
+#include "VertexCompression.hpp"
+#include "VertexWelder.hpp"
 #include "utils.hpp"
 
 static glm::vec3 calcNormal(const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 & v2)
@@ -16,22 +30,420 @@ static glm::vec3 calcNormal(const glm::vec3 & v0, const glm::vec3 & v1, const gl
   return glm::normalize(n);
 }
 
+namespace
+{
+/// marks a missing index in an ObjCorner
+const int missingIndex = std::numeric_limits<int>::min();
+
+/// Minimum size (in bytes) of the chunks parsed in parallel
+const size_t minChunkSize = 1 << 20;
+
+/// A face corner, as written in a wavefront file (with 0-based indices)
+struct ObjCorner {
+  int position;           ///< position index
+  int uv;                 ///< uv index (or missingIndex)
+  int normal;             ///< normal index (or missingIndex)
+  unsigned char relative; ///< bit k is set if the k-th index was negative in the file (i.e. relative to the chunk)
+};
+
+/// The statements found in a chunk of lines of a wavefront file
+struct ObjChunk {
+  const char * begin;                    ///< first character of the chunk
+  const char * end;                      ///< past-the-end character of the chunk
+  std::vector<glm::vec3> positions;      ///< v statements (positions)
+  std::vector<glm::vec3> colors;         ///< v statements (optional colors)
+  std::vector<glm::vec2> uvs;            ///< vt statements
+  std::vector<glm::vec3> normals;        ///< vn statements
+  std::vector<ObjCorner> corners;        ///< f statements, three corners per (fan triangulated) face
+  std::vector<int> materialSlots;        ///< per face: index in usedMaterials, or -1 for the material active when the chunk starts
+  std::vector<std::string> usedMaterials; ///< usemtl statements, in order of appearance
+  std::string mtllibs;                   ///< mtllib statements
+  std::vector<int> materialIds;          ///< per face: the resolved material index
+  std::vector<size_t> materialCounts;    ///< number of faces per material
+};
+
+bool isSpace(char c)
+{
+  return c == ' ' or c == '\t' or c == '\r';
+}
+
+const char * skipSpaces(const char * p, const char * end)
+{
+  while (p < end and isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+bool parseFloat(const char *& p, const char * end, float & value)
+{
+  const char * q = skipSpaces(p, end);
+  if (q < end and *q == '+') {
+    q++;
+  }
+  std::from_chars_result result = std::from_chars(q, end, value);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  p = result.ptr;
+  return true;
+}
+
+/// parses a (1-based, possibly negative) wavefront index, and converts it to a 0-based one
+bool parseIndex(const char *& p, const char * end, size_t localCount, int & index, bool & relative)
+{
+  int value = 0;
+  std::from_chars_result result = std::from_chars(p, end, value);
+  if (result.ec != std::errc() or value == 0) {
+    return false;
+  }
+  p = result.ptr;
+  relative = (value < 0);
+  index = relative ? int(localCount) + value : value - 1;
+  return true;
+}
+
+/// parses a face corner of the form v, v/vt, v//vn or v/vt/vn
+bool parseCorner(const char *& p, const char * end, const ObjChunk & chunk, ObjCorner & corner)
+{
+  bool relative = false;
+  corner.uv = corner.normal = missingIndex;
+  corner.relative = 0;
+  if (not parseIndex(p, end, chunk.positions.size(), corner.position, relative)) {
+    return false;
+  }
+  corner.relative |= relative ? 1 : 0;
+  if (p < end and *p == '/') {
+    p++;
+    if (p < end and *p != '/' and parseIndex(p, end, chunk.uvs.size(), corner.uv, relative)) {
+      corner.relative |= relative ? 2 : 0;
+    }
+    if (p < end and *p == '/') {
+      p++;
+      if (parseIndex(p, end, chunk.normals.size(), corner.normal, relative)) {
+        corner.relative |= relative ? 4 : 0;
+      }
+    }
+  }
+  return true;
+}
+
+/// extracts all the statements of a chunk (the chunk must start at the beginning of a line)
+void tokenizeChunk(ObjChunk & chunk)
+{
+  std::vector<ObjCorner> polygon;
+  const char * p = chunk.begin;
+  while (p < chunk.end) {
+    const char * lineEnd = std::find(p, chunk.end, '\n');
+    const char * token = skipSpaces(p, lineEnd);
+    p = (lineEnd < chunk.end) ? lineEnd + 1 : lineEnd;
+    const char * keywordEnd = token;
+    while (keywordEnd < lineEnd and not isSpace(*keywordEnd)) {
+      keywordEnd++;
+    }
+    std::string_view keyword(token, keywordEnd - token);
+    token = keywordEnd;
+    if (keyword == "v") {
+      glm::vec3 position;
+      parseFloat(token, lineEnd, position.x);
+      parseFloat(token, lineEnd, position.y);
+      parseFloat(token, lineEnd, position.z);
+      glm::vec3 color(1, 1, 1);
+      glm::vec3 parsedColor;
+      if (parseFloat(token, lineEnd, parsedColor.x) and parseFloat(token, lineEnd, parsedColor.y) and parseFloat(token, lineEnd, parsedColor.z)) {
+        color = parsedColor;
+      }
+      chunk.positions.push_back(position);
+      chunk.colors.push_back(color);
+    } else if (keyword == "vt") {
+      glm::vec2 uv;
+      parseFloat(token, lineEnd, uv.x);
+      parseFloat(token, lineEnd, uv.y);
+      chunk.uvs.push_back(uv);
+    } else if (keyword == "vn") {
+      glm::vec3 normal;
+      parseFloat(token, lineEnd, normal.x);
+      parseFloat(token, lineEnd, normal.y);
+      parseFloat(token, lineEnd, normal.z);
+      chunk.normals.push_back(normal);
+    } else if (keyword == "f") {
+      polygon.clear();
+      ObjCorner corner;
+      token = skipSpaces(token, lineEnd);
+      while (token < lineEnd and parseCorner(token, lineEnd, chunk, corner)) {
+        polygon.push_back(corner);
+        token = skipSpaces(token, lineEnd);
+      }
+      int slot = static_cast<int>(chunk.usedMaterials.size()) - 1;
+      for (size_t k = 2; k < polygon.size(); k++) {
+        chunk.corners.push_back(polygon[0]);
+        chunk.corners.push_back(polygon[k - 1]);
+        chunk.corners.push_back(polygon[k]);
+        chunk.materialSlots.push_back(slot);
+      }
+    } else if (keyword == "usemtl") {
+      token = skipSpaces(token, lineEnd);
+      const char * nameEnd = token;
+      while (nameEnd < lineEnd and not isSpace(*nameEnd)) {
+        nameEnd++;
+      }
+      chunk.usedMaterials.emplace_back(token, nameEnd);
+    } else if (keyword == "mtllib") {
+      chunk.mtllibs.append(keyword.data(), lineEnd);
+      chunk.mtllibs += '\n';
+    }
+  }
+}
+
+/// encodes the values [begin, end) of an attribute array into a strided stream
+template <typename T, typename Encoder> void encodeStream(std::span<const T> values, size_t begin, size_t end, char * destination, size_t stride, Encoder encode)
+{
+  for (size_t k = begin; k < end; k++) {
+    auto encoded = encode(values[k]);
+    memcpy(destination + k * stride, &encoded, sizeof(encoded));
+  }
+}
+
+/// a view on the components of an array of glm vectors
+template <typename T> std::span<const float> floatComponents(std::span<const T> values)
+{
+  return std::span<const float>(reinterpret_cast<const float *>(values.data()), values.size() * T::length());
+}
+
+/// writes the name and the dimensions of an image in the TextureImageTable section
+void writeImageTableEntry(const std::string & name, const Image<> & image, std::ostream & imageTable)
+{
+  write(name, imageTable);
+  write(glm::int32(image.width), imageTable);
+  write(glm::int32(image.height), imageTable);
+  write(glm::int32(image.depth), imageTable);
+  write(glm::int32(image.channels), imageTable);
+}
+
+/// writes the pixels of an image in a TextureImage section (delta filtered pixel by pixel if the writer compresses)
+void writeImageSection(const Image<> & image, GlitterWriter & writer)
+{
+  std::uint64_t dataSize = std::uint64_t(image.width) * image.height * image.depth * image.channels;
+  writer.beginSection(GlitterSection::TextureImage, image.channels, 1);
+  writer.appendToSection(reinterpret_cast<const char *>(image.data), dataSize, dataSize);
+  writer.endSection();
+}
+
+/// writes the name, the format and the level dimensions of a baked texture in the BakedTextureTable section
+void writeBakedTableEntry(const std::string & name, const BakedTexture & texture, std::ostream & bakedTable)
+{
+  write(name, bakedTable);
+  write(glm::uint32(texture.format), bakedTable);
+  write(glm::uint32(texture.levels.size()), bakedTable);
+  for (const BakedTextureLevel & level : texture.levels) {
+    write(glm::int32(level.width), bakedTable);
+    write(glm::int32(level.height), bakedTable);
+    write(std::uint64_t(level.data.size()), bakedTable);
+  }
+}
+
+/// writes the levels of a baked texture in a BakedTexture section (not filtered: blocks do not benefit from deltas)
+void writeBakedSection(const BakedTexture & texture, GlitterWriter & writer)
+{
+  writer.beginSection(GlitterSection::BakedTexture);
+  for (const BakedTextureLevel & level : texture.levels) {
+    writer.appendToSection(level.data.data(), level.data.size(), level.data.size());
+  }
+  writer.endSection();
+}
+
+/// converts an image (block compressed if @p compress, with its mipmap chain if @p mipmaps) to a texture whose levels are appended to @p storage
+BakedTexture bakeTexture(const Image<> & image, MipmapFilter filter, bool compress, bool mipmaps, MipmapKernel kernel, unsigned int nbThreads, std::vector<std::vector<char>> & storage)
+{
+  BakedTexture texture;
+  texture.format = compress ? chooseTextureFormat(image, filter == MipmapFilter::NormalMap) : TextureFormat::RGBA8;
+  // the spans survive the reallocations of the storage since moving a vector keeps its buffer
+  storage.push_back(compressTexture(image, texture.format, nbThreads));
+  texture.levels.push_back(BakedTextureLevel{image.width, image.height, std::span<const char>(storage.back())});
+  if (mipmaps) {
+    int width = image.width;
+    int height = image.height;
+    for (std::vector<unsigned char> & level : generateMipmaps(image, filter, nbThreads, kernel)) {
+      width = std::max(1, width / 2);
+      height = std::max(1, height / 2);
+      storage.push_back(compressTexture(Image<>(level.data(), width, height, 4), texture.format, nbThreads));
+      texture.levels.push_back(BakedTextureLevel{width, height, std::span<const char>(storage.back())});
+    }
+  }
+  return texture;
+}
+
+/// writes the SimpleMaterials section
+void writeMaterialsSection(const std::vector<SimpleMaterial> & materials, GlitterWriter & writer)
+{
+  std::ostringstream stream;
+  std::uint64_t count = materials.size();
+  write(count, stream);
+  for (const SimpleMaterial & material : materials) {
+    write(material.name, stream);
+    write(material.ambient, stream);
+    write(material.diffuse, stream);
+    write(material.specular, stream);
+    write(material.shininess, stream);
+    write(material.diffuseTexName, stream);
+    write(material.normalTexName, stream);
+    write(material.specularTexName, stream);
+  }
+  std::string bytes = stream.str();
+  writer.writeSection(GlitterSection::SimpleMaterials, bytes.data(), bytes.size(), count);
+}
+
+/// writes the PartBounds section (the volumes are flattened, so that the floats are written in the file byte order)
+void writeBoundsSection(const std::vector<BoundingVolume> & bounds, GlitterWriter & writer)
+{
+  static_assert(sizeof(BoundingVolume) == 10 * sizeof(glm::float32), "writeBoundsSection(): BoundingVolume is not made of 10 floats");
+  const glm::float32 * values = reinterpret_cast<const glm::float32 *>(bounds.data());
+  writer.writeSection(GlitterSection::PartBounds, std::vector<glm::float32>(values, values + 10 * bounds.size()));
+}
+
+/// A face corner whose indices are absolute (0-based, or -1 if missing)
+struct ResolvedCorner {
+  glm::int32 position; ///< position index
+  glm::int32 uv;       ///< uv index
+  glm::int32 normal;   ///< normal index
+};
+
+/// A temporary file holding an array that is not kept in memory (removed at destruction)
+class SpillFile {
+public:
+  SpillFile(const std::string & filename) : m_filename(filename), m_file(filename.c_str(), std::ios::binary | std::ios::trunc), m_size(0)
+  {
+    if (!m_file) {
+      std::cerr << "Unable to create file: " << filename << std::endl;
+      exit(1);
+    }
+  }
+  SpillFile(const SpillFile &) = delete;
+  SpillFile & operator=(const SpillFile &) = delete;
+
+  ~SpillFile()
+  {
+    m_file.close();
+    std::remove(m_filename.c_str());
+  }
+
+  /// appends values (in the host endianness)
+  template <typename T> void append(std::span<const T> values)
+  {
+    m_file.write(reinterpret_cast<const char *>(values.data()), values.size_bytes());
+    m_size += values.size_bytes();
+  }
+
+  /// closes the file so that it can be read back, and returns its name
+  const std::string & close()
+  {
+    m_file.close();
+    return m_filename;
+  }
+
+  /// the number of values of type T in the file
+  template <typename T> size_t count() const
+  {
+    return m_size / sizeof(T);
+  }
+
+private:
+  std::string m_filename; ///< the name of the file
+  std::ofstream m_file;   ///< the file
+  size_t m_size;          ///< the size of the file
+};
+
+/// maps a closed spill file as an array of values
+template <typename T> std::span<const T> mappedValues(const MappedFile & file)
+{
+  return std::span<const T>(reinterpret_cast<const T *>(file.data()), file.size() / sizeof(T));
+}
+
+/// the largest extent of the bounding box of some positions (0 if there is none)
+float largestExtent(std::span<const glm::vec3> positions)
+{
+  if (positions.empty()) {
+    return 0;
+  }
+  glm::vec3 min = positions[0], max = positions[0];
+  for (const glm::vec3 & position : positions) {
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+  glm::vec3 extent = max - min;
+  return std::max(extent.x, std::max(extent.y, extent.z));
+}
+
+/// copies a spill file into a new section of a .glitter file, block by block (values are converted from T to U)
+template <typename T, typename U = T> void copySpill(SpillFile & spill, GlitterSection type, GlitterWriter & writer)
+{
+  const size_t blockSize = 1 << 16;
+  std::ifstream file(spill.close().c_str(), std::ios::binary);
+  std::vector<T> block(blockSize);
+  std::vector<U> converted;
+  writer.beginSection<U>(type);
+  for (size_t remaining = spill.count<T>(); remaining > 0;) {
+    size_t count = std::min(remaining, blockSize);
+    file.read(reinterpret_cast<char *>(block.data()), count * sizeof(T));
+    converted.assign(block.begin(), block.begin() + count);
+    writer.appendToSection(std::span<const U>(converted));
+    remaining -= count;
+  }
+  writer.endSection();
+}
+
+/// moves every value to its new index
+template <typename T> void permute(std::vector<T> & values, const std::vector<unsigned int> & newIndices)
+{
+  std::vector<T> permuted(values.size());
+  for (size_t k = 0; k < values.size(); k++) {
+    permuted[newIndices[k]] = values[k];
+  }
+  values.swap(permuted);
+}
+} // namespace
+
 std::string ObjLoader::defaultDiffuseName = "OBL:default_diffuse";
 std::string ObjLoader::defaultNormalName = "OBL:default_normal";
 unsigned char ObjLoader::bluish[4] = {128, 128, 255, 255};
 unsigned char ObjLoader::white[4] = {255, 255, 255, 255};
 
-ObjLoader::ObjLoader(const std::string & filename)
+ObjLoader::ObjLoader(const std::string & filename, const ObjLoaderOptions & options) : m_options(options)
 {
+  if (m_options.nbThreads == 0) {
+    m_options.nbThreads = defaultThreadCount();
+  }
   std::string absolutepath = absolutename(filename);
   m_rootDir = basename(absolutepath);
-  m_images.add(defaultDiffuseName, Image<>(white, 1, 1, 4));
-  m_images.add(defaultNormalName, Image<>(bluish, 1, 1, 4));
-  if (endsWith(absolutepath, ".glitter")) {
+  m_images.add(defaultDiffuseName, Image<>(white, 1, 1, 4), false);
+  m_images.add(defaultNormalName, Image<>(bluish, 1, 1, 4), false);
+  if (endsWith(absolutepath, ".glitter") and GlitterFile::isVersion2(absolutepath)) {
+    loadMappedFile(absolutepath);
+  } else if (endsWith(absolutepath, ".glitter")) {
     loadBinaryFile(absolutepath);
   } else {
     parseFile(absolutepath);
   }
+  if (m_options.optimizeMesh and not m_mappedFile) {
+    optimizeMesh();
+  }
+  if ((m_options.compressTextures or m_options.generateMipmaps) and not m_mappedFile) {
+    bakeTextures();
+  }
+  if (not m_mappedFile) {
+    narrowIBOs();
+  }
+  // the .glitter files written before the PartBounds section existed get their bounds computed as well
+  if (not m_mappedFile or m_mappedFile->sectionCount(GlitterSection::PartBounds) == 0) {
+    computePartBounds();
+  }
+}
+
+ObjLoader::~ObjLoader() {}
+
+const ObjLoader::LoadReport & ObjLoader::loadReport() const
+{
+  return m_loadReport;
 }
 
 const std::vector<SimpleMaterial> & ObjLoader::materials() const
@@ -44,78 +456,270 @@ Image<> ObjLoader::image(const std::string & name) const
   return m_images[name];
 }
 
+const BakedTexture * ObjLoader::bakedTexture(const std::string & name) const
+{
+  auto it = m_bakedTextures.find(name);
+  return (it != m_bakedTextures.end()) ? &it->second : nullptr;
+}
+
+std::string ObjLoader::imagePath(const std::string & name) const
+{
+  return (name == defaultDiffuseName or name == defaultNormalName) ? name : m_rootDir + name;
+}
+
 size_t ObjLoader::nbIBOs() const
 {
+  if (m_mappedFile) {
+    return m_mappedFile->sectionCount(GlitterSection::IBO);
+  }
   return m_ibos.size();
 }
 
-const std::vector<glm::vec3> & ObjLoader::vertexPositions() const
+std::span<const glm::vec3> ObjLoader::vertexPositions() const
 {
+  if (m_mappedFile) {
+    return m_mappedFile->section<glm::vec3>(GlitterSection::VertexPositions);
+  }
   return m_vertexPositions;
 }
 
-const std::vector<glm::vec4> & ObjLoader::vertexColors() const
+std::span<const glm::vec4> ObjLoader::vertexColors() const
 {
+  if (m_mappedFile) {
+    return m_mappedFile->section<glm::vec4>(GlitterSection::VertexColors);
+  }
   return m_vertexColors;
 }
 
-const std::vector<glm::vec2> & ObjLoader::vertexUVs() const
+std::span<const glm::vec2> ObjLoader::vertexUVs() const
 {
+  if (m_mappedFile) {
+    return m_mappedFile->section<glm::vec2>(GlitterSection::VertexUVs);
+  }
   return m_vertexUVs;
 }
 
-const std::vector<glm::vec3> & ObjLoader::vertexNormals() const
+std::span<const glm::vec3> ObjLoader::vertexNormals() const
 {
+  if (m_mappedFile) {
+    return m_mappedFile->section<glm::vec3>(GlitterSection::VertexNormals);
+  }
   return m_vertexNormals;
 }
 
-const std::vector<glm::vec3> & ObjLoader::vertexTangents() const
+std::span<const glm::vec3> ObjLoader::vertexTangents() const
 {
+  if (m_mappedFile) {
+    return m_mappedFile->section<glm::vec3>(GlitterSection::VertexTangents);
+  }
   return m_vertexTangents;
 }
 
-const std::vector<unsigned int> & ObjLoader::ibo(unsigned int materialIndex) const
+size_t ObjLoader::encodedSize(VertexAttribute attribute, VertexEncoding encoding)
 {
-  return m_ibos[materialIndex];
+  switch (encoding) {
+  case VertexEncoding::Float:
+    if (attribute == VertexAttribute::Color) {
+      return sizeof(glm::vec4);
+    }
+    return (attribute == VertexAttribute::UV) ? sizeof(glm::vec2) : sizeof(glm::vec3);
+  case VertexEncoding::Half:
+    return (attribute == VertexAttribute::UV) ? sizeof(PackedHalf2) : sizeof(PackedHalf4);
+  case VertexEncoding::Octahedral:
+    return (attribute == VertexAttribute::Normal or attribute == VertexAttribute::Tangent) ? sizeof(PackedSnorm16x2) : 0;
+  case VertexEncoding::Unorm8:
+    return (attribute == VertexAttribute::Color) ? sizeof(PackedUnorm8x4) : 0;
+  }
+  return 0;
 }
 
-void ObjLoader::loadImage(std::string texture_filename)
+void ObjLoader::encodeAttribute(VertexAttribute attribute, VertexEncoding encoding, size_t begin, size_t end, char * destination, size_t stride) const
 {
-  std::string key = texture_filename;
-  if (texture_filename.length() > 0) {
-    // Only load the texture if it is not already loaded
-    if (not m_images.find(key)) {
-      texture_filename = m_rootDir + texture_filename;
-      if (!fileExists(texture_filename)) {
-        std::cerr << "Unable to find file: " << texture_filename << std::endl;
-        exit(1);
-      }
+  switch (attribute) {
+  case VertexAttribute::Position:
+    if (encoding == VertexEncoding::Half) {
+      encodeStream(vertexPositions(), begin, end, destination, stride, [](const glm::vec3 & p) { return encodeHalf4(p, 1); });
+    } else {
+      encodeStream(vertexPositions(), begin, end, destination, stride, [](const glm::vec3 & p) { return p; });
+    }
+    break;
+  case VertexAttribute::Color:
+    if (encoding == VertexEncoding::Half) {
+      encodeStream(vertexColors(), begin, end, destination, stride, [](const glm::vec4 & c) { return encodeHalf4(c); });
+    } else if (encoding == VertexEncoding::Unorm8) {
+      encodeStream(vertexColors(), begin, end, destination, stride, [](const glm::vec4 & c) { return encodeUnorm8(c); });
+    } else {
+      encodeStream(vertexColors(), begin, end, destination, stride, [](const glm::vec4 & c) { return c; });
+    }
+    break;
+  case VertexAttribute::UV:
+    if (encoding == VertexEncoding::Half) {
+      encodeStream(vertexUVs(), begin, end, destination, stride, [](const glm::vec2 & uv) { return encodeHalf2(uv); });
+    } else {
+      encodeStream(vertexUVs(), begin, end, destination, stride, [](const glm::vec2 & uv) { return uv; });
+    }
+    break;
+  case VertexAttribute::Normal:
+  case VertexAttribute::Tangent: {
+    std::span<const glm::vec3> directions = (attribute == VertexAttribute::Normal) ? vertexNormals() : vertexTangents();
+    if (encoding == VertexEncoding::Half) {
+      encodeStream(directions, begin, end, destination, stride, [](const glm::vec3 & d) { return encodeHalf4(d, 0); });
+    } else if (encoding == VertexEncoding::Octahedral) {
+      encodeStream(directions, begin, end, destination, stride, [](const glm::vec3 & d) { return encodeOctahedral(d); });
+    } else {
+      encodeStream(directions, begin, end, destination, stride, [](const glm::vec3 & d) { return d; });
+    }
+    break;
+  }
+  }
+}
 
-      Image<> image;
-      image.depth = 1;
-      image.data = stbi_load(texture_filename.c_str(), &image.width, &image.height, &image.channels, STBI_default);
-      if (!image.data) {
-        std::cerr << "Unable to load texture: " << texture_filename << std::endl;
-        exit(1);
-      }
-      m_images.add(key, image);
+std::vector<char> ObjLoader::interleavedVertices(const std::vector<VertexAttribute> & attributes, const std::vector<VertexEncoding> & encodings) const
+{
+  size_t nbVertices = vertexPositions().size();
+  std::vector<VertexEncoding> attributeEncodings = encodings;
+  attributeEncodings.resize(attributes.size(), VertexEncoding::Float);
+  std::vector<size_t> offsets;
+  size_t stride = 0;
+  for (size_t a = 0; a < attributes.size(); a++) {
+    size_t size = encodedSize(attributes[a], attributeEncodings[a]);
+    if (size == 0) {
+      std::cerr << "ObjLoader::interleavedVertices(): unsupported encoding for attribute " << a << std::endl;
+      exit(1);
     }
+    offsets.push_back(stride);
+    stride += size;
   }
+
+  // attributes are encoded one after the other on blocks of vertices
+  std::vector<char> vertices(stride * nbVertices);
+  const size_t blockSize = 1 << 14;
+  parallelFor(
+      (nbVertices + blockSize - 1) / blockSize,
+      [&](size_t block) {
+        size_t begin = block * blockSize;
+        size_t end = std::min(nbVertices, begin + blockSize);
+        for (size_t a = 0; a < attributes.size(); a++) {
+          encodeAttribute(attributes[a], attributeEncodings[a], begin, end, vertices.data() + offsets[a], stride);
+        }
+      },
+      m_options.nbThreads);
+  return vertices;
 }
 
-void ObjLoader::parseFile(const std::string & filename)
+bool ObjLoader::halfPrecisionAllows(VertexAttribute attribute, float tolerance) const
 {
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string err;
-  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename.c_str(), m_rootDir.c_str());
-  if (!err.empty()) {
-    std::cerr << err << std::endl;
+  std::span<const float> components;
+  switch (attribute) {
+  case VertexAttribute::Position:
+    components = floatComponents(vertexPositions());
+    break;
+  case VertexAttribute::Color:
+    components = floatComponents(vertexColors());
+    break;
+  case VertexAttribute::UV:
+    components = floatComponents(vertexUVs());
+    break;
+  case VertexAttribute::Normal:
+    components = floatComponents(vertexNormals());
+    break;
+  case VertexAttribute::Tangent:
+    components = floatComponents(vertexTangents());
+    break;
   }
-  if (!ret) {
+  for (float value : components) {
+    if (not(std::fabs(halfToFloat(floatToHalf(value)) - value) <= tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ObjLoader::IndexSpan ObjLoader::ibo(unsigned int materialIndex) const
+{
+  if (m_mappedFile) {
+    if (m_mappedFile->elementSize(GlitterSection::IBO, materialIndex) == sizeof(glm::uint16)) {
+      return m_mappedFile->section<glm::uint16>(GlitterSection::IBO, materialIndex);
+    }
+    return m_mappedFile->section<glm::uint32>(GlitterSection::IBO, materialIndex);
+  }
+  if (not m_shortIBOs[materialIndex].empty()) {
+    return std::span<const glm::uint16>(m_shortIBOs[materialIndex]);
+  }
+  return std::span<const glm::uint32>(m_ibos[materialIndex]);
+}
+
+const BoundingVolume & ObjLoader::partBounds(unsigned int materialIndex) const
+{
+  if (m_mappedFile and m_partBounds.empty()) {
+    std::span<const BoundingVolume> bounds = m_mappedFile->section<BoundingVolume>(GlitterSection::PartBounds);
+    assert(materialIndex < bounds.size() && "ObjLoader::partBounds(): Wrong material index");
+    return bounds[materialIndex];
+  }
+  return m_partBounds[materialIndex];
+}
+
+Image<> ObjLoader::readImage(const std::string & filename)
+{
+  std::string error;
+  Image<> image = readImage(filename, error);
+  if (!image.data) {
+    std::cerr << error << std::endl;
     exit(1);
   }
+  return image;
+}
+
+Image<> ObjLoader::readImage(const std::string & filename, std::string & error)
+{
+  // may run on a worker thread: the error is reported to the caller, which fails once no other task is running
+  Image<> image;
+  image.depth = 1;
+  if (!fileExists(filename)) {
+    error = "Unable to find file: " + filename;
+    return image;
+  }
+  image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, STBI_default);
+  if (!image.data) {
+    error = "Unable to load texture: " + filename;
+  }
+  return image;
+}
+
+std::unordered_map<std::string, MipmapFilter> ObjLoader::textureFilters(const std::vector<SimpleMaterial> & materials)
+{
+  // diffuse maps hold sRGB colors, specular maps hold linear factors
+  std::unordered_map<std::string, MipmapFilter> filters;
+  for (const SimpleMaterial & material : materials) {
+    filters.insert({material.diffuseTexName, MipmapFilter::SRGB});
+    filters.insert({material.specularTexName, MipmapFilter::Linear});
+  }
+  for (const SimpleMaterial & material : materials) {
+    filters[material.normalTexName] = MipmapFilter::NormalMap;
+  }
+  return filters;
+}
+
+std::vector<SimpleMaterial> ObjLoader::readMaterials(const std::string & mtllibs, const std::string & rootDir, std::unordered_map<std::string, int> & materialIds)
+{
+  std::vector<tinyobj::material_t> materials;
+  if (not mtllibs.empty()) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::string err;
+    std::istringstream mtllibStream(mtllibs);
+    tinyobj::MaterialFileReader materialReader(rootDir);
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &mtllibStream, &materialReader);
+    if (!err.empty()) {
+      std::cerr << err << std::endl;
+    }
+    if (!ret) {
+      exit(1);
+    }
+  }
+  for (size_t m = 0; m < materials.size(); m++) {
+    materialIds.insert({materials[m].name, static_cast<int>(m)});
+  }
 
   // Loop over materials
   tinyobj::material_t defaultMaterial;
@@ -125,6 +729,7 @@ void ObjLoader::parseFile(const std::string & filename)
   defaultMaterial.shininess = 1;
   defaultMaterial.name = "default_material";
   materials.push_back(defaultMaterial);
+  std::vector<SimpleMaterial> simpleMaterials;
   for (size_t m = 0; m < materials.size(); m++) {
     tinyobj::material_t * mp = &materials[m];
     SimpleMaterial material;
@@ -136,131 +741,601 @@ void ObjLoader::parseFile(const std::string & filename)
     material.diffuseTexName = (mp->diffuse_texname != "") ? mp->diffuse_texname : defaultDiffuseName;
     material.normalTexName = (mp->normal_texname != "") ? mp->normal_texname : defaultNormalName;
     material.specularTexName = (mp->normal_texname != "") ? mp->specular_texname : defaultDiffuseName;
-    loadImage(mp->diffuse_texname);
-    loadImage(mp->normal_texname);
-    loadImage(mp->specular_texname);
-    m_materials.push_back(material);
-  }
-
-  m_ibos.resize(m_materials.size());
-  // Loop over shapes
-  for (size_t s = 0; s < shapes.size(); s++) {
-    // Loop over faces(polygon)
-    for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-      int current_material_id = shapes[s].mesh.material_ids[f];
-      if ((current_material_id < 0) || (current_material_id >= static_cast<int>(materials.size()))) {
-        // Invalid material ID. Use default material.
-        current_material_id = materials.size() - 1; // Default material is added to the last item in `materials`.
+    simpleMaterials.push_back(material);
+  }
+  return simpleMaterials;
+}
+
+void ObjLoader::parseFile(const std::string & filename)
+{
+  auto startTime = std::chrono::steady_clock::now();
+  MappedFile file(filename);
+  const char * fileEnd = file.data() + file.size();
+  m_loadReport.fileSize = file.size();
+
+  // Split the file in chunks on line boundaries, and tokenize each chunk on its own thread
+  size_t nbChunks = std::clamp<size_t>(file.size() / minChunkSize, 1, 4 * m_options.nbThreads);
+  std::vector<ObjChunk> chunks(nbChunks);
+  const char * chunkBegin = file.data();
+  for (size_t c = 0; c < nbChunks; c++) {
+    const char * chunkEnd = std::max(chunkBegin, file.data() + file.size() * (c + 1) / nbChunks);
+    chunkEnd = std::find(chunkEnd, fileEnd, '\n');
+    chunks[c].begin = chunkBegin;
+    chunks[c].end = (chunkEnd < fileEnd) ? chunkEnd + 1 : fileEnd;
+    chunkBegin = chunks[c].end;
+  }
+  parallelFor(nbChunks, [&chunks](size_t c) { tokenizeChunk(chunks[c]); }, m_options.nbThreads);
+
+  // Materials are read by tinyobjloader (only the mtllib statements are fed to it)
+  std::string mtllibs;
+  for (const ObjChunk & chunk : chunks) {
+    mtllibs += chunk.mtllibs;
+  }
+  std::unordered_map<std::string, int> materialIds;
+  m_materials = readMaterials(mtllibs, m_rootDir, materialIds);
+
+  // Texture images are decoded in the background while the geometry is built
+  auto decodeStartTime = std::chrono::steady_clock::now();
+  std::vector<std::string> imageNames;
+  for (const SimpleMaterial & material : m_materials) {
+    for (const std::string & name : {material.diffuseTexName, material.normalTexName, material.specularTexName}) {
+      if (not name.empty() and not m_images.find(name) and std::find(imageNames.begin(), imageNames.end(), name) == imageNames.end()) {
+        imageNames.push_back(name);
       }
+    }
+  }
+  std::vector<Image<>> decodedImages(imageNames.size());
+  std::vector<double> decodeTimes(imageNames.size(), 0);
+  std::vector<std::string> decodeErrors(imageNames.size());
+  TaskGroup decoding;
+  for (size_t k = 0; k < imageNames.size(); k++) {
+    decoding.run([&, k]() {
+      decodedImages[k] = readImage(m_rootDir + imageNames[k], decodeErrors[k]);
+      decodeTimes[k] = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStartTime).count();
+    });
+  }
+  auto materialId = [&materialIds](const std::string & name) {
+    auto it = materialIds.find(name);
+    return (it != materialIds.end()) ? it->second : -1;
+  };
 
-      // Loop over vertices in the face.
-      for (size_t v = 0; v < 3; v++) {
-        // access to vertex
-        tinyobj::index_t idx = shapes[s].mesh.indices[3 * f + v];
-        tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-        tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-        tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-        m_vertexPositions.push_back(glm::vec3(vx, vy, vz));
-
-        if (attrib.normals.size() > 0) {
-          tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-          tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-          tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
-          m_vertexNormals.push_back(-glm::vec3(nx, ny, nz));
-        }
-        if (attrib.texcoords.size() > 0) {
-          tinyobj::real_t tx = attrib.texcoords[2 * idx.texcoord_index + 0];
-          tinyobj::real_t ty = attrib.texcoords[2 * idx.texcoord_index + 1];
-          m_vertexUVs.push_back(glm::vec2(tx, ty));
-        } else {
-          m_vertexUVs.push_back({0, 0});
+  // Prefix sums of the per-chunk counts give the global offsets of each chunk
+  size_t nbMaterials = m_materials.size();
+  std::vector<size_t> positionOffsets(nbChunks + 1, 0);
+  std::vector<size_t> uvOffsets(nbChunks + 1, 0);
+  std::vector<size_t> normalOffsets(nbChunks + 1, 0);
+  std::vector<size_t> faceOffsets(nbChunks + 1, 0);
+  std::vector<int> initialMaterials(nbChunks);
+  int currentMaterial = -1;
+  for (size_t c = 0; c < nbChunks; c++) {
+    const ObjChunk & chunk = chunks[c];
+    positionOffsets[c + 1] = positionOffsets[c] + chunk.positions.size();
+    uvOffsets[c + 1] = uvOffsets[c] + chunk.uvs.size();
+    normalOffsets[c + 1] = normalOffsets[c] + chunk.normals.size();
+    faceOffsets[c + 1] = faceOffsets[c] + chunk.materialSlots.size();
+    initialMaterials[c] = currentMaterial;
+    if (not chunk.usedMaterials.empty()) {
+      currentMaterial = materialId(chunk.usedMaterials.back());
+    }
+  }
+
+  // Gather the attributes of all chunks, and resolve the material of every face
+  std::vector<glm::vec3> positions(positionOffsets[nbChunks]);
+  std::vector<glm::vec3> colors(positionOffsets[nbChunks]);
+  std::vector<glm::vec2> uvs(uvOffsets[nbChunks]);
+  std::vector<glm::vec3> normals(normalOffsets[nbChunks]);
+  parallelFor(
+      nbChunks,
+      [&](size_t c) {
+        ObjChunk & chunk = chunks[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[c]);
+        std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + positionOffsets[c]);
+        std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvOffsets[c]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffsets[c]);
+        chunk.materialCounts.assign(nbMaterials, 0);
+        chunk.materialIds.resize(chunk.materialSlots.size());
+        for (size_t f = 0; f < chunk.materialSlots.size(); f++) {
+          int slot = chunk.materialSlots[f];
+          int id = (slot < 0) ? initialMaterials[c] : materialId(chunk.usedMaterials[slot]);
+          if ((id < 0) || (id >= static_cast<int>(nbMaterials))) {
+            // Invalid material ID. Use default material.
+            id = nbMaterials - 1; // Default material is added to the last item in `m_materials`.
+          }
+          chunk.materialIds[f] = id;
+          chunk.materialCounts[id]++;
         }
-        //! note: beware attrib.colors is not empty even if no colors were specified (it is filled with black colors)
-        tinyobj::real_t cR = attrib.colors[3 * idx.vertex_index + 0];
-        tinyobj::real_t cG = attrib.colors[3 * idx.vertex_index + 1];
-        tinyobj::real_t cB = attrib.colors[3 * idx.vertex_index + 2];
-        tinyobj::real_t cA = 1;
-        m_vertexColors.push_back(glm::vec4(cR, cG, cB, cA));
-        m_ibos[current_material_id].push_back(m_vertexPositions.size() - 1);
-      }
+      },
+      m_options.nbThreads);
 
-      // Compute the geometric normal if not specified.
-      if (attrib.normals.size() == 0) {
-        size_t nbVertices = m_vertexPositions.size();
-        const glm::vec3 & v0 = m_vertexPositions[nbVertices - 3];
-        const glm::vec3 & v1 = m_vertexPositions[nbVertices - 2];
-        const glm::vec3 & v2 = m_vertexPositions[nbVertices - 1];
-        glm::vec3 normal = calcNormal(v0, v1, v2);
-        m_vertexNormals.push_back(normal);
-        m_vertexNormals.push_back(normal);
-        m_vertexNormals.push_back(normal);
-      }
+  // Each chunk fills its own range of the vertex attributes and of every IBO
+  std::vector<std::vector<size_t>> iboOffsets(nbChunks, std::vector<size_t>(nbMaterials, 0));
+  m_ibos.resize(nbMaterials);
+  for (size_t m = 0; m < nbMaterials; m++) {
+    size_t count = 0;
+    for (size_t c = 0; c < nbChunks; c++) {
+      iboOffsets[c][m] = count;
+      count += 3 * chunks[c].materialCounts[m];
     }
+    m_ibos[m].resize(count);
   }
+  size_t nbVertices = 3 * faceOffsets[nbChunks];
+  m_vertexPositions.resize(nbVertices);
+  m_vertexColors.resize(nbVertices);
+  m_vertexUVs.resize(nbVertices);
+  m_vertexNormals.resize(nbVertices);
+  std::atomic<bool> invalidIndex(false);
+  parallelFor(
+      nbChunks,
+      [&](size_t c) {
+        const ObjChunk & chunk = chunks[c];
+        std::vector<size_t> iboCursors = iboOffsets[c];
+        auto resolve = [](int index, bool relative, size_t chunkOffset, size_t count) -> long {
+          long absolute = relative ? long(chunkOffset) + index : index;
+          return (index == missingIndex or absolute < 0 or absolute >= long(count)) ? -1 : absolute;
+        };
+        for (size_t f = 0; f < chunk.materialIds.size(); f++) {
+          size_t vertex = 3 * (faceOffsets[c] + f);
+          bool hasNormals = not normals.empty();
+          for (size_t v = 0; v < 3; v++) {
+            const ObjCorner & corner = chunk.corners[3 * f + v];
+            long p = resolve(corner.position, corner.relative & 1, positionOffsets[c], positions.size());
+            long t = resolve(corner.uv, corner.relative & 2, uvOffsets[c], uvs.size());
+            long n = resolve(corner.normal, corner.relative & 4, normalOffsets[c], normals.size());
+            if (p < 0) {
+              invalidIndex = true;
+              continue;
+            }
+            m_vertexPositions[vertex + v] = positions[p];
+            m_vertexColors[vertex + v] = glm::vec4(colors[p], 1);
+            m_vertexUVs[vertex + v] = (t >= 0) ? uvs[t] : glm::vec2(0, 0);
+            if (n >= 0) {
+              m_vertexNormals[vertex + v] = -normals[n];
+            } else {
+              hasNormals = false;
+            }
+            m_ibos[chunk.materialIds[f]][iboCursors[chunk.materialIds[f]]++] = vertex + v;
+          }
+
+          // Compute the geometric normal if not specified.
+          if (not hasNormals) {
+            glm::vec3 normal = calcNormal(m_vertexPositions[vertex], m_vertexPositions[vertex + 1], m_vertexPositions[vertex + 2]);
+            m_vertexNormals[vertex] = m_vertexNormals[vertex + 1] = m_vertexNormals[vertex + 2] = normal;
+          }
+        }
+      },
+      m_options.nbThreads);
+  if (invalidIndex) {
+    std::cerr << "Invalid vertex index in file: " << filename << std::endl;
+    exit(1);
+  }
+  m_loadReport.parseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
   computeTangents();
   cleanUpDuplicates();
+
+  auto waitStartTime = std::chrono::steady_clock::now();
+  decoding.wait();
+  // the decoding errors are reported by the calling thread, once all the tasks are done
+  for (const std::string & error : decodeErrors) {
+    if (not error.empty()) {
+      std::cerr << error << std::endl;
+      exit(1);
+    }
+  }
+  for (size_t k = 0; k < imageNames.size(); k++) {
+    m_images.add(imageNames[k], decodedImages[k]);
+  }
+  m_loadReport.decodeTime = imageNames.empty() ? 0 : *std::max_element(decodeTimes.begin(), decodeTimes.end());
+  m_loadReport.decodeWaitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStartTime).count();
+  m_loadReport.totalTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
 }
 
-void ObjLoader::saveBinaryFile(const std::string & filename) const
+void ObjLoader::saveBinaryFile(const std::string & filename, bool compress) const
 {
-#define GLITTER_BINFILE_MAGIC "GLITTER_BIN_OBJ\n"
-  std::ofstream file(filename.c_str());
-  file.write(GLITTER_BINFILE_MAGIC, strlen(GLITTER_BINFILE_MAGIC));
+  GlitterWriter writer(filename, compress, m_options.nbThreads);
+  writer.writeSection(GlitterSection::VertexPositions, m_vertexPositions);
+  writer.writeSection(GlitterSection::VertexColors, m_vertexColors);
+  writer.writeSection(GlitterSection::VertexUVs, m_vertexUVs);
+  writer.writeSection(GlitterSection::VertexNormals, m_vertexNormals);
+  writer.writeSection(GlitterSection::VertexTangents, m_vertexTangents);
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    if (not m_shortIBOs[k].empty()) {
+      writer.writeSection(GlitterSection::IBO, m_shortIBOs[k]);
+    } else {
+      writer.writeSection(GlitterSection::IBO, m_ibos[k]);
+    }
+  }
 
-  write(std::string("[VertexPositions]"), file);
-  write(m_vertexPositions, file);
-  write(std::string("[VertexColors]"), file);
-  write(m_vertexColors, file);
-  write(std::string("[VertexUVs]"), file);
-  write(m_vertexUVs, file);
-  write(std::string("[VertexNormals]"), file);
-  write(m_vertexNormals, file);
-  write(std::string("[VertexTangents]"), file);
-  write(m_vertexTangents, file);
+  // NamedTextureImages m_images: a table of names and dimensions, then one section of pixels per image (baked images excepted)
+  std::vector<std::string> textureImageNames;
+  for (const std::string & name : m_images.names()) {
+    if (not m_bakedTextures.count(name)) {
+      textureImageNames.push_back(name);
+    }
+  }
+  std::ostringstream imageTable;
+  std::uint64_t count = textureImageNames.size();
+  write(count, imageTable);
+  for (const std::string & name : textureImageNames) {
+    writeImageTableEntry(name, m_images[name], imageTable);
+  }
+  std::string imageTableBytes = imageTable.str();
+  writer.writeSection(GlitterSection::TextureImageTable, imageTableBytes.data(), imageTableBytes.size(), count);
+  for (const std::string & name : textureImageNames) {
+    writeImageSection(m_images[name], writer);
+  }
 
-  write(std::string("[IBOS]"), file);
-  // IBOs
-  std::uint64_t count = m_ibos.size();
-  write(count, file);
-  for (const IBO & ibo : m_ibos) {
-    write(ibo, file);
+  // std::unordered_map<std::string, BakedTexture> m_bakedTextures: a table of names, formats and levels, then one section per texture
+  std::ostringstream bakedTable;
+  write(std::uint64_t(m_bakedTextures.size()), bakedTable);
+  for (const auto & [name, texture] : m_bakedTextures) {
+    writeBakedTableEntry(name, texture, bakedTable);
+  }
+  std::string bakedTableBytes = bakedTable.str();
+  writer.writeSection(GlitterSection::BakedTextureTable, bakedTableBytes.data(), bakedTableBytes.size(), m_bakedTextures.size());
+  for (const auto & [name, texture] : m_bakedTextures) {
+    writeBakedSection(texture, writer);
   }
 
-  write(std::string("[NamedTextureImages]"), file);
-  // NamedTextureImages m_images;
-  std::vector<std::string> textureImageNames = m_images.names();
-  count = textureImageNames.size();
-  write(count, file);
-  for (const std::string & name : textureImageNames) {
-    write(std::string("_Image_"), file);
-    write(name, file);
-    Image<> image = m_images[name];
-    glm::int32 w = image.width;
-    glm::int32 h = image.height;
-    glm::int32 d = image.depth;
-    glm::int32 c = image.channels;
-    write(w, file);
-    write(h, file);
-    write(d, file);
-    write(c, file);
-    file.write(reinterpret_cast<const char *>(image.data), w * h * d * c);
-  }
-
-  write(std::string("[SimpleMaterials]"), file);
   // std::vector<SimpleMaterial> m_materials;
-  count = m_materials.size();
-  write(count, file);
-  for (const SimpleMaterial & material : m_materials) {
-    write(std::string("_Material_"), file);
-    write(material.name, file);
-    write(material.ambient, file);
-    write(material.diffuse, file);
-    write(material.specular, file);
-    write(material.shininess, file);
-    write(material.diffuseTexName, file);
-    write(material.normalTexName, file);
-    write(material.specularTexName, file);
+  writeMaterialsSection(m_materials, writer);
+  std::vector<BoundingVolume> bounds;
+  for (size_t k = 0; k < nbIBOs(); k++) {
+    bounds.push_back(partBounds(k));
+  }
+  writeBoundsSection(bounds, writer);
+  writer.close();
+}
+
+void ObjLoader::loadMappedFile(const std::string & filename)
+{
+  auto startTime = std::chrono::steady_clock::now();
+  m_mappedFile = std::unique_ptr<GlitterFile>(new GlitterFile(filename, m_options.nbThreads));
+  m_loadReport.loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  m_loadReport.fileSize = m_mappedFile->fileSize();
+
+  std::span<const char> imageTableBytes = m_mappedFile->rawSection(GlitterSection::TextureImageTable);
+  std::istringstream imageTable(std::string(imageTableBytes.data(), imageTableBytes.size()));
+  std::uint64_t count = 0;
+  read(count, imageTable);
+  for (std::uint64_t k = 0; k < count; k++) {
+    std::string name;
+    read(name, imageTable);
+    glm::int32 width, height, depth, channels;
+    read(width, imageTable);
+    read(height, imageTable);
+    read(depth, imageTable);
+    read(channels, imageTable);
+    // the pixels are not copied: the image points into the (read-only) mapping or the decompressed section
+    std::span<const char> pixels = m_mappedFile->rawSection(GlitterSection::TextureImage, k);
+    if (width < 0 or height < 0 or depth < 0 or channels < 0 or pixels.size() != size_t(width) * height * depth * channels) {
+      std::cerr << "ObjLoader::loadMappedFile(): wrong size of image " << name << " in " << filename << std::endl;
+      exit(1);
+    }
+    Image<> image(reinterpret_cast<Image<>::value_type *>(const_cast<char *>(pixels.data())), width, height, depth, channels);
+    m_images.add(name, image, false);
+  }
+
+  // the levels of the baked textures point into the mapping as well
+  std::span<const char> bakedTableBytes = m_mappedFile->rawSection(GlitterSection::BakedTextureTable);
+  std::istringstream bakedTable(std::string(bakedTableBytes.data(), bakedTableBytes.size()));
+  count = 0;
+  read(count, bakedTable);
+  for (std::uint64_t k = 0; k < count; k++) {
+    std::string name;
+    read(name, bakedTable);
+    glm::uint32 format, nbLevels;
+    read(format, bakedTable);
+    read(nbLevels, bakedTable);
+    BakedTexture & texture = m_bakedTextures[name];
+    texture.format = TextureFormat(format);
+    std::span<const char> levels = m_mappedFile->rawSection(GlitterSection::BakedTexture, k);
+    for (glm::uint32 level = 0; level < nbLevels; level++) {
+      glm::int32 width, height;
+      std::uint64_t size;
+      read(width, bakedTable);
+      read(height, bakedTable);
+      read(size, bakedTable);
+      if (width < 0 or height < 0 or size > levels.size() or size != textureLevelSize(texture.format, width, height)) {
+        std::cerr << "ObjLoader::loadMappedFile(): wrong size of level " << level << " of texture " << name << " in " << filename << std::endl;
+        exit(1);
+      }
+      texture.levels.push_back(BakedTextureLevel{width, height, levels.first(size)});
+      levels = levels.subspan(size);
+    }
+  }
+
+  std::span<const char> materialBytes = m_mappedFile->rawSection(GlitterSection::SimpleMaterials);
+  std::istringstream materials(std::string(materialBytes.data(), materialBytes.size()));
+  count = 0;
+  read(count, materials);
+  m_materials.resize(count);
+  for (SimpleMaterial & material : m_materials) {
+    read(material.name, materials);
+    read(material.ambient, materials);
+    read(material.diffuse, materials);
+    read(material.specular, materials);
+    read(material.shininess, materials);
+    read(material.diffuseTexName, materials);
+    read(material.normalTexName, materials);
+    read(material.specularTexName, materials);
+  }
+}
+
+ObjLoader::LoadReport ObjLoader::convertToBinaryFile(const std::string & objFilename, const std::string & glitterFilename, const ObjLoaderOptions & loaderOptions, size_t chunkSize, bool compress)
+{
+  ObjLoaderOptions options = loaderOptions;
+  if (options.nbThreads == 0) {
+    options.nbThreads = defaultThreadCount();
+  }
+  LoadReport report;
+  auto startTime = std::chrono::steady_clock::now();
+  std::string absolutepath = absolutename(objFilename);
+  std::string rootDir = basename(absolutepath);
+  MappedFile file(absolutepath);
+  const char * fileEnd = file.data() + file.size();
+  report.fileSize = file.size();
+
+  // Tokenize the file window by window: the attributes are spilled as is, and the faces with absolute indices
+  SpillFile positionSpill(glitterFilename + ".positions.tmp");
+  SpillFile colorSpill(glitterFilename + ".colors.tmp");
+  SpillFile uvSpill(glitterFilename + ".uvs.tmp");
+  SpillFile normalSpill(glitterFilename + ".normals.tmp");
+  SpillFile cornerSpill(glitterFilename + ".corners.tmp");
+  SpillFile faceMaterialSpill(glitterFilename + ".faces.tmp");
+  std::string mtllibs;
+  std::vector<std::string> usedMaterials; // material names, in order of first use
+  std::unordered_map<std::string, int> usedMaterialIndices;
+  int currentMaterial = -1;
+  size_t nbPositions = 0, nbUVs = 0, nbNormals = 0;
+  std::vector<ResolvedCorner> corners;
+  std::vector<glm::int32> faceMaterials;
+  const char * windowBegin = file.data();
+  while (windowBegin < fileEnd) {
+    const char * windowEnd = std::find(windowBegin + std::min<size_t>(chunkSize, fileEnd - windowBegin), fileEnd, '\n');
+    windowEnd = (windowEnd < fileEnd) ? windowEnd + 1 : fileEnd;
+    size_t nbChunks = std::clamp<size_t>((windowEnd - windowBegin) / minChunkSize, 1, 4 * options.nbThreads);
+    std::vector<ObjChunk> chunks(nbChunks);
+    const char * chunkBegin = windowBegin;
+    for (size_t c = 0; c < nbChunks; c++) {
+      const char * chunkEnd = std::find(std::max(chunkBegin, windowBegin + (windowEnd - windowBegin) * (c + 1) / nbChunks), windowEnd, '\n');
+      chunks[c].begin = chunkBegin;
+      chunks[c].end = (chunkEnd < windowEnd) ? chunkEnd + 1 : windowEnd;
+      chunkBegin = chunks[c].end;
+    }
+    parallelFor(nbChunks, [&chunks](size_t c) { tokenizeChunk(chunks[c]); }, options.nbThreads);
+
+    for (const ObjChunk & chunk : chunks) {
+      positionSpill.append(std::span<const glm::vec3>(chunk.positions));
+      colorSpill.append(std::span<const glm::vec3>(chunk.colors));
+      uvSpill.append(std::span<const glm::vec2>(chunk.uvs));
+      normalSpill.append(std::span<const glm::vec3>(chunk.normals));
+      mtllibs += chunk.mtllibs;
+      std::vector<int> slotMaterials;
+      for (const std::string & name : chunk.usedMaterials) {
+        auto inserted = usedMaterialIndices.insert({name, static_cast<int>(usedMaterials.size())});
+        if (inserted.second) {
+          usedMaterials.push_back(name);
+        }
+        slotMaterials.push_back(inserted.first->second);
+      }
+      auto resolve = [](int index, bool relative, size_t chunkOffset) -> glm::int32 {
+        long absolute = relative ? long(chunkOffset) + index : index;
+        return (index == missingIndex or absolute < 0) ? -1 : glm::int32(absolute);
+      };
+      corners.clear();
+      faceMaterials.clear();
+      for (size_t f = 0; f < chunk.materialSlots.size(); f++) {
+        int slot = chunk.materialSlots[f];
+        faceMaterials.push_back((slot < 0) ? currentMaterial : slotMaterials[slot]);
+        for (size_t v = 0; v < 3; v++) {
+          const ObjCorner & corner = chunk.corners[3 * f + v];
+          corners.push_back(ResolvedCorner{resolve(corner.position, corner.relative & 1, nbPositions), resolve(corner.uv, corner.relative & 2, nbUVs),
+                                           resolve(corner.normal, corner.relative & 4, nbNormals)});
+        }
+      }
+      cornerSpill.append(std::span<const ResolvedCorner>(corners));
+      faceMaterialSpill.append(std::span<const glm::int32>(faceMaterials));
+      if (not slotMaterials.empty()) {
+        currentMaterial = slotMaterials.back();
+      }
+      nbPositions += chunk.positions.size();
+      nbUVs += chunk.uvs.size();
+      nbNormals += chunk.normals.size();
+    }
+    windowBegin = windowEnd;
+  }
+  report.parseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  // Materials, then texture images (one at a time)
+  std::unordered_map<std::string, int> materialIds;
+  std::vector<SimpleMaterial> materials = readMaterials(mtllibs, rootDir, materialIds);
+  size_t nbMaterials = materials.size();
+  std::vector<int> usedMaterialIds(usedMaterials.size(), nbMaterials - 1);
+  for (size_t k = 0; k < usedMaterials.size(); k++) {
+    auto it = materialIds.find(usedMaterials[k]);
+    if (it != materialIds.end()) {
+      usedMaterialIds[k] = it->second;
+    }
+  }
+  GlitterWriter writer(glitterFilename, compress, options.nbThreads);
+  std::vector<std::string> textureImageNames = {defaultDiffuseName, defaultNormalName};
+  for (const SimpleMaterial & material : materials) {
+    for (const std::string & name : {material.diffuseTexName, material.normalTexName, material.specularTexName}) {
+      if (not name.empty() and std::find(textureImageNames.begin(), textureImageNames.end(), name) == textureImageNames.end()) {
+        textureImageNames.push_back(name);
+      }
+    }
+  }
+  std::unordered_map<std::string, MipmapFilter> filters = textureFilters(materials);
+  std::ostringstream imageTable;
+  std::ostringstream bakedTable;
+  size_t nbRawImages = 0, nbBakedTextures = 0;
+  for (size_t k = 0; k < textureImageNames.size(); k++) {
+    bool isDefault = (k < 2);
+    Image<> image = isDefault ? Image<>((k == 0) ? white : bluish, 1, 1, 4) : readImage(rootDir + textureImageNames[k]);
+    if ((options.compressTextures or options.generateMipmaps) and not isDefault and image.depth == 1) {
+      auto startTime = std::chrono::steady_clock::now();
+      std::vector<std::vector<char>> storage;
+      BakedTexture texture = bakeTexture(image, filters[textureImageNames[k]], options.compressTextures, options.generateMipmaps, options.mipmapKernel, options.nbThreads, storage);
+      report.bakeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+      writeBakedTableEntry(textureImageNames[k], texture, bakedTable);
+      writeBakedSection(texture, writer);
+      nbBakedTextures++;
+    } else {
+      writeImageTableEntry(textureImageNames[k], image, imageTable);
+      writeImageSection(image, writer);
+      nbRawImages++;
+    }
+    if (not isDefault) {
+      stbi_image_free(image.data);
+    }
+  }
+  std::ostringstream imageTableHeader;
+  write(std::uint64_t(nbRawImages), imageTableHeader);
+  std::string imageTableBytes = imageTableHeader.str() + imageTable.str();
+  writer.writeSection(GlitterSection::TextureImageTable, imageTableBytes.data(), imageTableBytes.size(), nbRawImages);
+  std::ostringstream bakedTableHeader;
+  write(std::uint64_t(nbBakedTextures), bakedTableHeader);
+  std::string bakedTableBytes = bakedTableHeader.str() + bakedTable.str();
+  writer.writeSection(GlitterSection::BakedTextureTable, bakedTableBytes.data(), bakedTableBytes.size(), nbBakedTextures);
+  writeMaterialsSection(materials, writer);
+
+  // Faces are processed group by group, each group being welded (and optimized) on its own
+  MappedFile positionFile(positionSpill.close());
+  MappedFile colorFile(colorSpill.close());
+  MappedFile uvFile(uvSpill.close());
+  MappedFile normalFile(normalSpill.close());
+  MappedFile cornerFile(cornerSpill.close());
+  MappedFile faceMaterialFile(faceMaterialSpill.close());
+  std::span<const glm::vec3> positions = mappedValues<glm::vec3>(positionFile);
+  std::span<const glm::vec3> colors = mappedValues<glm::vec3>(colorFile);
+  std::span<const glm::vec2> uvs = mappedValues<glm::vec2>(uvFile);
+  std::span<const glm::vec3> normals = mappedValues<glm::vec3>(normalFile);
+  std::span<const ResolvedCorner> faceCorners = mappedValues<ResolvedCorner>(cornerFile);
+  std::span<const glm::int32> faceMaterialIndices = mappedValues<glm::int32>(faceMaterialFile);
+
+  SpillFile vertexPositionSpill(glitterFilename + ".vertexPositions.tmp");
+  SpillFile vertexColorSpill(glitterFilename + ".vertexColors.tmp");
+  SpillFile vertexUVSpill(glitterFilename + ".vertexUVs.tmp");
+  SpillFile vertexNormalSpill(glitterFilename + ".vertexNormals.tmp");
+  SpillFile vertexTangentSpill(glitterFilename + ".vertexTangents.tmp");
+  std::vector<std::unique_ptr<SpillFile>> iboSpills;
+  for (size_t m = 0; m < nbMaterials; m++) {
+    iboSpills.emplace_back(new SpillFile(glitterFilename + ".ibo" + std::to_string(m) + ".tmp"));
+  }
+  std::vector<unsigned int> maxIndices(nbMaterials, 0);
+  MeshOptimizer optimizer(16, options.nbThreads);
+  double weightedACMR[2] = {0, 0};
+  double weightedATVR[2] = {0, 0};
+  size_t nbFaces = faceMaterialIndices.size();
+  size_t nbVertices = 0;
+  size_t facesPerGroup = std::max<size_t>(1, chunkSize / 64);
+  // all the groups are welded with the tolerance of the whole mesh
+  float meshExtent = largestExtent(positions);
+  std::vector<glm::vec3> groupPositions, groupNormals, groupTangents;
+  std::vector<glm::vec4> groupColors;
+  std::vector<glm::vec2> groupUVs;
+  std::vector<IBO> groupIBOs(nbMaterials);
+  for (size_t firstFace = 0; firstFace < nbFaces; firstFace += facesPerGroup) {
+    size_t groupSize = std::min(facesPerGroup, nbFaces - firstFace);
+    groupPositions.resize(3 * groupSize);
+    groupColors.resize(3 * groupSize);
+    groupUVs.resize(3 * groupSize);
+    groupNormals.resize(3 * groupSize);
+    groupTangents.clear();
+    for (IBO & ibo : groupIBOs) {
+      ibo.clear();
+    }
+    for (size_t f = 0; f < groupSize; f++) {
+      glm::int32 usedMaterial = faceMaterialIndices[firstFace + f];
+      int material = (usedMaterial < 0) ? nbMaterials - 1 : usedMaterialIds[usedMaterial];
+      bool hasNormals = not normals.empty();
+      for (size_t v = 0; v < 3; v++) {
+        const ResolvedCorner & corner = faceCorners[3 * (firstFace + f) + v];
+        size_t vertex = 3 * f + v;
+        if (corner.position < 0 or size_t(corner.position) >= positions.size()) {
+          std::cerr << "Invalid vertex index in file: " << objFilename << std::endl;
+          exit(1);
+        }
+        groupPositions[vertex] = positions[corner.position];
+        groupColors[vertex] = glm::vec4(colors[corner.position], 1);
+        groupUVs[vertex] = (corner.uv >= 0 and size_t(corner.uv) < uvs.size()) ? uvs[corner.uv] : glm::vec2(0, 0);
+        if (corner.normal >= 0 and size_t(corner.normal) < normals.size()) {
+          groupNormals[vertex] = -normals[corner.normal];
+        } else {
+          hasNormals = false;
+        }
+        groupIBOs[material].push_back(vertex);
+      }
+
+      // Compute the geometric normal if not specified.
+      if (not hasNormals) {
+        glm::vec3 normal = calcNormal(groupPositions[3 * f], groupPositions[3 * f + 1], groupPositions[3 * f + 2]);
+        groupNormals[3 * f] = groupNormals[3 * f + 1] = groupNormals[3 * f + 2] = normal;
+      }
+    }
+    computeTangents(groupPositions, groupUVs, groupNormals, groupTangents);
+    auto weldStart = std::chrono::steady_clock::now();
+    weldVertices(options, meshExtent, groupPositions, groupColors, groupUVs, groupNormals, groupTangents, groupIBOs);
+    report.weldTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - weldStart).count();
+    if (options.optimizeMesh) {
+      auto optimizeStart = std::chrono::steady_clock::now();
+      VertexCacheStatistics before = optimizer.analyze(groupIBOs, groupPositions.size());
+      reorderVertices(optimizer, groupPositions, groupColors, groupUVs, groupNormals, groupTangents, groupIBOs);
+      report.optimizeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - optimizeStart).count();
+      VertexCacheStatistics after = optimizer.analyze(groupIBOs, groupPositions.size());
+      weightedACMR[0] += before.acmr * groupSize;
+      weightedACMR[1] += after.acmr * groupSize;
+      weightedATVR[0] += before.atvr * groupPositions.size();
+      weightedATVR[1] += after.atvr * groupPositions.size();
+    }
+
+    vertexPositionSpill.append(std::span<const glm::vec3>(groupPositions));
+    vertexColorSpill.append(std::span<const glm::vec4>(groupColors));
+    vertexUVSpill.append(std::span<const glm::vec2>(groupUVs));
+    vertexNormalSpill.append(std::span<const glm::vec3>(groupNormals));
+    vertexTangentSpill.append(std::span<const glm::vec3>(groupTangents));
+    for (size_t m = 0; m < nbMaterials; m++) {
+      for (unsigned int & index : groupIBOs[m]) {
+        index += nbVertices;
+        maxIndices[m] = std::max(maxIndices[m], index);
+      }
+      iboSpills[m]->append(std::span<const unsigned int>(groupIBOs[m]));
+    }
+    nbVertices += groupPositions.size();
+  }
+  if (options.optimizeMesh and nbFaces > 0) {
+    report.cacheBefore.acmr = weightedACMR[0] / nbFaces;
+    report.cacheAfter.acmr = weightedACMR[1] / nbFaces;
+    report.cacheBefore.atvr = weightedATVR[0] / nbVertices;
+    report.cacheAfter.atvr = weightedATVR[1] / nbVertices;
+  }
+
+  // The temporary streams are copied into the sections, IBOs being narrowed to 16 bits when they fit
+  copySpill<glm::vec3>(vertexPositionSpill, GlitterSection::VertexPositions, writer);
+  copySpill<glm::vec4>(vertexColorSpill, GlitterSection::VertexColors, writer);
+  copySpill<glm::vec2>(vertexUVSpill, GlitterSection::VertexUVs, writer);
+  copySpill<glm::vec3>(vertexNormalSpill, GlitterSection::VertexNormals, writer);
+  copySpill<glm::vec3>(vertexTangentSpill, GlitterSection::VertexTangents, writer);
+  for (size_t m = 0; m < nbMaterials; m++) {
+    if (iboSpills[m]->count<glm::uint32>() > 0 and maxIndices[m] <= std::numeric_limits<glm::uint16>::max()) {
+      copySpill<glm::uint32, glm::uint16>(*iboSpills[m], GlitterSection::IBO, writer);
+    } else {
+      copySpill<glm::uint32>(*iboSpills[m], GlitterSection::IBO, writer);
+    }
   }
+
+  // the bounds of the parts are computed from the mapped streams, since the vertices of a part span all the groups
+  MappedFile vertexPositionFile(vertexPositionSpill.close());
+  std::vector<BoundingVolume> bounds;
+  for (size_t m = 0; m < nbMaterials; m++) {
+    MappedFile iboFile(iboSpills[m]->close());
+    bounds.push_back(boundingVolume(mappedValues<glm::vec3>(vertexPositionFile), mappedValues<glm::uint32>(iboFile)));
+  }
+  writeBoundsSection(bounds, writer);
+  writer.close();
+  return report;
 }
 
 void ObjLoader::loadBinaryFile(const std::string & filename)
@@ -323,7 +1398,8 @@ void ObjLoader::loadBinaryFile(const std::string & filename)
     read(value, file);
     image.channels = value;
     size_t dataSize = image.width * image.height * image.depth * image.channels;
-    image.data = new Image<>::value_type[dataSize];
+    // allocated with malloc, so that it is released like the images loaded by stb_image
+    image.data = static_cast<Image<>::value_type *>(malloc(dataSize * sizeof(Image<>::value_type)));
     file.read(reinterpret_cast<char *>(image.data), dataSize * sizeof(Image<>::value_type));
     m_images.add(name, image);
   }
@@ -348,6 +1424,11 @@ void ObjLoader::loadBinaryFile(const std::string & filename)
 }
 
 void ObjLoader::computeTangents()
+{
+  computeTangents(m_vertexPositions, m_vertexUVs, m_vertexNormals, m_vertexTangents);
+}
+
+void ObjLoader::computeTangents(std::span<const glm::vec3> positions, std::span<const glm::vec2> uvs, std::span<const glm::vec3> normals, std::vector<glm::vec3> & tangents)
 {
   //! note: in barycentric form the tangent is parameterized as:
   //! t = x0 + t1(x1-x0) + t2(x2-x0)
@@ -358,19 +1439,19 @@ void ObjLoader::computeTangents()
   //! t1 = det([1, delta u2; 0, delta v2]) /  det([delta u1, delta u2; delta v1, delta v2])
   //! t2 = det([delta u1, 1; delta v1, 0]) /  det([delta u1, delta u2; delta v1, delta v2])
   glm::vec3 tangent;
-  for (unsigned int i = 0; i < m_vertexPositions.size(); i += 3) {
-    glm::vec2 & uv0 = m_vertexUVs[i + 0];
-    glm::vec2 & uv1 = m_vertexUVs[i + 1];
-    glm::vec2 & uv2 = m_vertexUVs[i + 2];
+  for (unsigned int i = 0; i < positions.size(); i += 3) {
+    const glm::vec2 & uv0 = uvs[i + 0];
+    const glm::vec2 & uv1 = uvs[i + 1];
+    const glm::vec2 & uv2 = uvs[i + 2];
     // UV delta
     glm::vec2 deltaUV1 = uv1 - uv0;
     glm::vec2 deltaUV2 = uv2 - uv0;
     float detDenom = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
     if (detDenom != 0) {
-      // Shortcuts for m_vertexPositions
-      glm::vec3 & x0 = m_vertexPositions[i + 0];
-      glm::vec3 & x1 = m_vertexPositions[i + 1];
-      glm::vec3 & x2 = m_vertexPositions[i + 2];
+      // Shortcuts for positions
+      const glm::vec3 & x0 = positions[i + 0];
+      const glm::vec3 & x1 = positions[i + 1];
+      const glm::vec3 & x2 = positions[i + 2];
       // Edges of the triangle : postion delta
       glm::vec3 deltaPos1 = x1 - x0;
       glm::vec3 deltaPos2 = x2 - x0;
@@ -378,114 +1459,110 @@ void ObjLoader::computeTangents()
       tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
     }
     // Set the same tangent for all three vertices of the triangle.
-    m_vertexTangents.push_back(tangent);
-    m_vertexTangents.push_back(tangent);
-    m_vertexTangents.push_back(tangent);
+    tangents.push_back(tangent);
+    tangents.push_back(tangent);
+    tangents.push_back(tangent);
   }
 
-  for (unsigned int i = 0; i < m_vertexPositions.size(); i += 1) {
-    glm::vec3 & n = m_vertexNormals[i];
-    glm::vec3 & t = m_vertexTangents[i];
+  for (unsigned int i = 0; i < positions.size(); i += 1) {
+    const glm::vec3 & n = normals[i];
+    glm::vec3 & t = tangents[i];
     // Gram-Schmidt orthogonalize
     t = glm::normalize(t - n * glm::dot(n, t));
   }
 }
 
-struct PackedVertexPNTCUV {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec3 tangent;
-  glm::vec4 color;
-  glm::vec2 uv;
+void ObjLoader::cleanUpDuplicates()
+{
+  auto startTime = std::chrono::steady_clock::now();
+  weldVertices(m_options, largestExtent(m_vertexPositions), m_vertexPositions, m_vertexColors, m_vertexUVs, m_vertexNormals, m_vertexTangents, m_ibos);
+  m_loadReport.weldTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
 
-  PackedVertexPNTCUV(const glm::vec3 & position = glm::vec3(), const glm::vec3 & normal = glm::vec3(), const glm::vec3 & tangent = glm::vec3(), const glm::vec4 & color = glm::vec4(1),
-                     const glm::vec2 & uv = glm::vec2())
-      : position(position), normal(normal), tangent(tangent), color(color), uv(uv)
-  {
+void ObjLoader::weldVertices(const ObjLoaderOptions & options, float meshExtent, std::vector<glm::vec3> & positions, std::vector<glm::vec4> & colors, std::vector<glm::vec2> & uvs,
+                             std::vector<glm::vec3> & normals, std::vector<glm::vec3> & tangents, std::vector<IBO> & ibos)
+{
+  // the position tolerance is relative to the size of the mesh, so that small and large meshes are welded alike
+  VertexWelder welder(options.positionWeldTolerance * meshExtent, options.normalWeldTolerance, options.uvWeldTolerance, options.colorWeldTolerance, options.nbThreads);
+  std::vector<unsigned int> uniqueVertices;
+  std::vector<unsigned int> vertexNewIndices = welder.weld(positions, normals, tangents, colors, uvs, uniqueVertices);
+  for (auto & ibo : ibos) {
+    for (unsigned int & index : ibo) {
+      index = vertexNewIndices[index];
+    }
   }
-  bool operator==(const PackedVertexPNTCUV & other) const
-  {
-    return is_near(position, other.position) and is_near(normal, other.normal) and is_near(tangent, other.tangent) and is_near(uv, other.uv) and is_near(color, other.color);
+  // the representatives are sorted, so that the attributes can be compacted in place
+  for (size_t k = 0; k < uniqueVertices.size(); k++) {
+    unsigned int oldIndex = uniqueVertices[k];
+    positions[k] = positions[oldIndex];
+    normals[k] = normals[oldIndex];
+    tangents[k] = tangents[oldIndex];
+    colors[k] = colors[oldIndex];
+    uvs[k] = uvs[oldIndex];
   }
+  positions.resize(uniqueVertices.size());
+  normals.resize(uniqueVertices.size());
+  tangents.resize(uniqueVertices.size());
+  colors.resize(uniqueVertices.size());
+  uvs.resize(uniqueVertices.size());
+}
 
-  static bool is_near(float v1, float v2, float epsilon = 1e-2) { return fabs(v1 - v2) < epsilon; }
-
-  static bool is_near(const glm::vec2 & vecA, const glm::vec2 & vecB) { return is_near(vecA[0], vecB[0]) and is_near(vecA[1], vecB[1]); }
-
-  static bool is_near(const glm::vec3 & vecA, const glm::vec3 & vecB) { return is_near(vecA[0], vecB[0]) and is_near(vecA[1], vecB[1]) and is_near(vecA[2], vecB[2]); }
-
-  static bool is_near(const glm::vec4 & vecA, const glm::vec4 & vecB)
-  {
-    const float epsilon = 1 / 256.f;
-    return is_near(vecA[0], vecB[0], epsilon) and is_near(vecA[1], vecB[1], epsilon) and is_near(vecA[2], vecB[2], epsilon) and is_near(vecA[3], vecB[3], epsilon);
-  }
-};
+void ObjLoader::optimizeMesh()
+{
+  auto startTime = std::chrono::steady_clock::now();
+  MeshOptimizer optimizer(16, m_options.nbThreads);
+  m_loadReport.cacheBefore = optimizer.analyze(m_ibos, m_vertexPositions.size());
+  reorderVertices(optimizer, m_vertexPositions, m_vertexColors, m_vertexUVs, m_vertexNormals, m_vertexTangents, m_ibos);
+  m_loadReport.optimizeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  m_loadReport.cacheAfter = optimizer.analyze(m_ibos, m_vertexPositions.size());
+}
 
-// Template specialization of std::hash
-namespace std
+void ObjLoader::bakeTextures()
 {
-template <> struct hash<PackedVertexPNTCUV> {
-public:
-  std::size_t operator()(const PackedVertexPNTCUV & v) const
-  {
-    std::size_t hashes[] = {std::hash<float>()(v.position.x), std::hash<float>()(v.position.y), std::hash<float>()(v.position.z), std::hash<float>()(v.normal.x),  std::hash<float>()(v.normal.y),
-                            std::hash<float>()(v.normal.z),   std::hash<float>()(v.tangent.x),  std::hash<float>()(v.tangent.y),  std::hash<float>()(v.tangent.z), std::hash<float>()(v.color.x),
-                            std::hash<float>()(v.color.y),    std::hash<float>()(v.color.z),    std::hash<float>()(v.color.w),    std::hash<float>()(v.uv.x),      std::hash<float>()(v.uv.y)};
-    std::size_t seed = 0;
-    for (std::size_t h : hashes) {
-      // from boost::hash_combine
-      seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  auto startTime = std::chrono::steady_clock::now();
+  std::unordered_map<std::string, MipmapFilter> filters = textureFilters(m_materials);
+  for (const std::string & name : m_images.names()) {
+    const Image<> & image = m_images[name];
+    if (name == defaultDiffuseName or name == defaultNormalName or image.depth != 1) {
+      continue;
     }
-    return seed;
+    m_bakedTextures[name] = bakeTexture(image, filters[name], m_options.compressTextures, m_options.generateMipmaps, m_options.mipmapKernel, m_options.nbThreads, m_bakedTextureData);
   }
-};
-} // namespace std
+  m_loadReport.bakeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
 
-void ObjLoader::cleanUpDuplicates()
+void ObjLoader::reorderVertices(const MeshOptimizer & optimizer, std::vector<glm::vec3> & positions, std::vector<glm::vec4> & colors, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals,
+                                std::vector<glm::vec3> & tangents, std::vector<IBO> & ibos)
 {
-  std::vector<unsigned int> cleanIBO;
-  std::vector<glm::vec3> cleanPositions;
-  std::vector<glm::vec3> cleanNormals;
-  std::vector<glm::vec3> cleanTangents;
-  std::vector<glm::vec4> cleanColors;
-  std::vector<glm::vec2> cleanUVs;
-  std::unordered_map<PackedVertexPNTCUV, size_t> uniqueVertexIndices;
-  std::vector<size_t> vertexNewIndices;
-  for (size_t k = 0; k < m_vertexPositions.size(); k++) {
-    const glm::vec3 & position = m_vertexPositions[k];
-    const glm::vec3 & normal = m_vertexNormals[k];
-    const glm::vec3 & tangent = m_vertexTangents[k];
-    const glm::vec4 & color = m_vertexColors[k];
-    const glm::vec2 & uv = m_vertexUVs[k];
-    PackedVertexPNTCUV vertex(position, normal, tangent, color, uv);
-    auto uniqueIndexIterator = uniqueVertexIndices.find(vertex);
-    bool found = (uniqueIndexIterator != uniqueVertexIndices.end());
-    if (found) {
-      size_t index = uniqueIndexIterator->second;
-      vertexNewIndices.push_back(index);
-    } else {
-      cleanPositions.push_back(position);
-      cleanNormals.push_back(normal);
-      cleanTangents.push_back(tangent);
-      cleanColors.push_back(color);
-      cleanUVs.push_back(uv);
-      size_t index = cleanPositions.size() - 1;
-      uniqueVertexIndices[vertex] = index;
-      vertexNewIndices.push_back(index);
+  optimizer.optimizeTriangleOrder(ibos);
+  std::vector<unsigned int> newIndices = optimizer.optimizeVertexOrder(ibos, positions.size());
+  permute(positions, newIndices);
+  permute(normals, newIndices);
+  permute(tangents, newIndices);
+  permute(colors, newIndices);
+  permute(uvs, newIndices);
+}
+
+void ObjLoader::narrowIBOs()
+{
+  m_shortIBOs.resize(m_ibos.size());
+  for (size_t k = 0; k < m_ibos.size(); k++) {
+    IBO & ibo = m_ibos[k];
+    if (ibo.empty() or *std::max_element(ibo.begin(), ibo.end()) > std::numeric_limits<glm::uint16>::max()) {
+      continue;
     }
+    m_shortIBOs[k].assign(ibo.begin(), ibo.end());
+    IBO().swap(ibo);
   }
-  for (auto & ibo : m_ibos) {
-    std::vector<unsigned int> cleanIBO;
-    for (unsigned int oldIndex : ibo) {
-      cleanIBO.push_back(vertexNewIndices[oldIndex]);
-    }
-    ibo = cleanIBO;
+}
+
+void ObjLoader::computePartBounds()
+{
+  std::span<const glm::vec3> positions = vertexPositions();
+  m_partBounds.resize(nbIBOs());
+  for (size_t k = 0; k < m_partBounds.size(); k++) {
+    m_partBounds[k] = std::visit([positions](auto indices) { return boundingVolume(positions, indices); }, ibo(k));
   }
-  m_vertexPositions = cleanPositions;
-  m_vertexNormals = cleanNormals;
-  m_vertexTangents = cleanTangents;
-  m_vertexColors = cleanColors;
-  m_vertexUVs = cleanUVs;
 }
 
 bool ObjLoader::NamedTextureImages::find(const std::string & name) const
@@ -493,9 +1570,14 @@ bool ObjLoader::NamedTextureImages::find(const std::string & name) const
   return m_images.find(name) != m_images.end();
 }
 
-void ObjLoader::NamedTextureImages::add(const std::string & name, const Image<> & image)
+void ObjLoader::NamedTextureImages::add(const std::string & name, const Image<> & image, bool owned)
 {
   m_images[name] = image;
+  if (owned) {
+    m_borrowedImages.erase(name);
+  } else {
+    m_borrowedImages.insert(name);
+  }
 }
 
 const Image<> & ObjLoader::NamedTextureImages::operator[](const std::string & name) const
@@ -511,7 +1593,7 @@ const Image<> & ObjLoader::NamedTextureImages::operator[](const std::string & na
 ObjLoader::NamedTextureImages::~NamedTextureImages()
 {
   for (auto namedImage : m_images) {
-    if (namedImage.first == defaultDiffuseName or namedImage.first == defaultNormalName) {
+    if (m_borrowedImages.count(namedImage.first)) {
       continue;
     }
     unsigned char * imgData = namedImage.second.data;
@@ -2,14 +2,61 @@
 #define __GLITTER_OBJLOADER_H__
 #include <glm/glm.hpp>
 #include <memory>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <variant>
 #include <vector>
+#include "BoundingVolume.hpp"
 #include "Image.hpp"
+#include "MeshOptimizer.hpp"
 #include "SimpleMaterial.hpp"
+#include "TextureCompression.hpp"
 #include "tiny_obj_loader.h"
 typedef unsigned int uint;
 
+// forward declarations
+class GlitterFile;
+
+/**
+ * @brief Vertex attributes that ObjLoader can pack in an interleaved stream
+ */
+enum class VertexAttribute
+{
+  Position, ///< glm::vec3
+  Color,    ///< glm::vec4
+  UV,       ///< glm::vec2
+  Normal,   ///< glm::vec3
+  Tangent,  ///< glm::vec3
+};
+
+/**
+ * @brief Encodings of the vertex attributes in an interleaved stream (see VertexCompression.hpp)
+ */
+enum class VertexEncoding
+{
+  Float,      ///< glm::vec as is
+  Half,       ///< PackedHalf2 for uvs, PackedHalf4 otherwise (w = 1 for positions, 0 for directions)
+  Octahedral, ///< PackedSnorm16x2 (normals and tangents only)
+  Unorm8,     ///< PackedUnorm8x4 (colors only)
+};
+
+/**
+ * @brief Options controlling how ObjLoader processes a wavefront file
+ */
+struct ObjLoaderOptions {
+  unsigned int nbThreads = 0;                    ///< number of threads (0 means one per hardware thread)
+  float positionWeldTolerance = 0;               ///< vertices closer than this fraction of the largest extent of the mesh are merged (0 merges exact duplicates only)
+  float normalWeldTolerance = 0;                 ///< vertices whose normals and tangents are closer than this are merged (0 for exact matching)
+  float uvWeldTolerance = 0;                     ///< vertices whose uvs are closer than this are merged (0 for exact matching)
+  float colorWeldTolerance = 0;                  ///< vertices whose colors are closer than this are merged (0 for exact matching)
+  bool optimizeMesh = false;                     ///< reorders triangles and vertices for the GPU caches (see MeshOptimizer)
+  bool compressTextures = false;                 ///< block compresses the texture images (see ::compressTexture and ObjLoader::bakedTexture)
+  bool generateMipmaps = false;                  ///< precomputes the mipmap chains of the texture images (see ::generateMipmaps and ObjLoader::bakedTexture)
+  MipmapKernel mipmapKernel = MipmapKernel::Box; ///< the kernel of the precomputed mipmaps
+};
+
 /**
  * @brief A facade class for loading wavefront files (.obj)
  *
@@ -22,66 +69,160 @@ typedef unsigned int uint;
  *		+ diffuse texture map (map_Ka)
  *		+ normal texture map (norm)
  *	+ per face material affectations
+ *	+ bounding box and sphere of every IBO (see ObjLoader::partBounds)
  *
  * @note the class exposes vertex attributes as vectors of glm::vec, and faces as
  * IBOs (vectors of indices). One IBO is created per material, so that all faces
  * associated to a given material are represented in the corresponding IBO.
  * Besides, the vertex attributes and the IBOs are optimized in order to avoid
  * identical vertex repetitions.
+ *
+ * Binary .glitter files (version 2) are memory mapped: in that case the exposed
+ * spans and images point directly into the mapping, so that loading does not copy them. They
+ * are copied when uploaded (see Buffer::setData(std::span<const T>) and VAO::setVBO).
  */
 class ObjLoader {
 public:
+  /**
+   * @brief Timings and sizes measured while loading a file
+   */
+  struct LoadReport {
+    size_t fileSize = 0;  ///< size of the parsed file (in bytes)
+    double parseTime = 0; ///< time spent parsing the wavefront file, texture images excluded (in seconds)
+    double weldTime = 0;  ///< time spent merging duplicated vertices (in seconds)
+    double optimizeTime = 0;            ///< time spent reordering triangles and vertices (in seconds)
+    VertexCacheStatistics cacheBefore;  ///< vertex cache statistics before the reordering
+    VertexCacheStatistics cacheAfter;   ///< vertex cache statistics after the reordering
+    double loadTime = 0;                ///< time spent reading and decompressing the sections of a .glitter file (in seconds)
+    double decodeTime = 0;              ///< wall-clock time from the start of the texture decoding to the decoding of the last image (in seconds)
+    double decodeWaitTime = 0;          ///< time spent waiting for the texture decoding once the geometry was built (in seconds)
+    double totalTime = 0;               ///< wall-clock time of the whole parsing, including tangents, welding and texture decoding (in seconds)
+    double bakeTime = 0;                ///< time spent block compressing the texture images and computing their mipmaps (in seconds)
+  };
+
   /**
    * @brief Constructor from a wavefront filename
    * @param filename the file to be parsed.
+   * @param options processing options (number of threads, welding tolerances)
    *
    * The parsing is performed at construction time.
    * Then all the exposed attributes are accessible through getters.
+   *
+   * Wavefront files are split in chunks of lines which are tokenized in parallel,
+   * the chunks being then merged according to the prefix sums of their vertex
+   * and face counts. The result does not depend on the number of threads.
+   * Duplicated vertices are then merged by a VertexWelder.
+   */
+  ObjLoader(const std::string & filename, const ObjLoaderOptions & options = ObjLoaderOptions());
+
+  ObjLoader(const ObjLoader &) = delete;
+  ObjLoader & operator=(const ObjLoader &) = delete;
+
+  /**
+   * @brief Destructor (releases the memory mapping if any)
    */
-  ObjLoader(const std::string & filename);
+  ~ObjLoader();
 
   /**
-   * @brief Serialize the object in a .glitter file.
+   * @brief Serialize the object in a .glitter file (version 2, see GlitterWriter).
    * @param filename
+   * @param compress whether the sections are compressed (smaller file, but no longer mappable without a copy)
    */
-  void saveBinaryFile(const std::string & filename) const;
+  void saveBinaryFile(const std::string & filename, bool compress = false) const;
+
+  /**
+   * @brief Converts a wavefront file to a .glitter file (version 2) with a memory footprint bounded by the chunk size
+   * @param objFilename the wavefront file
+   * @param glitterFilename the output file
+   * @param options processing options
+   * @param chunkSize size (in bytes) of the chunks of text tokenized at once
+   * @param compress whether the sections are compressed
+   * @return the timings measured during the conversion
+   *
+   * Unlike the constructor followed by saveBinaryFile, the mesh is never materialized.
+   * The attributes of the wavefront file are spilled to temporary files (next to @p glitterFilename)
+   * and mapped back. Then the faces are processed by groups of chunkSize / 64 faces: each group is
+   * welded (and optionally optimized) on its own, and its vertices and indices are appended to temporary
+   * streams, finally copied block by block into the sections of the output file. Texture images are
+   * converted one at a time.
+   *
+   * @note vertices shared by two groups of faces are duplicated.
+   */
+  static LoadReport convertToBinaryFile(const std::string & objFilename, const std::string & glitterFilename, const ObjLoaderOptions & options = ObjLoaderOptions(), size_t chunkSize = 16 << 20,
+                                        bool compress = false);
 
   /**
    * @brief getter for vertex positions
    * @return the list of vertex position attributes.
    */
-  const std::vector<glm::vec3> & vertexPositions() const;
+  std::span<const glm::vec3> vertexPositions() const;
 
   /**
    * @brief getter for vertex colors
    * @return the list of vertex color attributes.
    */
-  const std::vector<glm::vec4> & vertexColors() const;
+  std::span<const glm::vec4> vertexColors() const;
 
   /**
    * @brief getter for vertex uVs
    * @return the list of vertex uv attributes.
    */
-  const std::vector<glm::vec2> & vertexUVs() const;
+  std::span<const glm::vec2> vertexUVs() const;
 
   /**
    * @brief getter for vertex normals
    * @return the list of vertex normal attributes.
    */
-  const std::vector<glm::vec3> & vertexNormals() const;
+  std::span<const glm::vec3> vertexNormals() const;
 
   /**
    * @brief getter for vertex tangents
    * @return the list of vertex tangent attributes.
    */
-  const std::vector<glm::vec3> & vertexTangents() const;
+  std::span<const glm::vec3> vertexTangents() const;
+
+  /**
+   * @brief packs the vertex attributes in a single interleaved stream
+   * @param attributes the attributes of a vertex, in their storage order
+   * @param encodings the encoding of every attribute (all of them are VertexEncoding::Float if empty)
+   * @return the packed vertices (to be described by a matching VertexLayout)
+   */
+  std::vector<char> interleavedVertices(const std::vector<VertexAttribute> & attributes, const std::vector<VertexEncoding> & encodings = {}) const;
+
+  /**
+   * @brief checks whether the values of an attribute can be stored on half floats
+   * @param attribute the vertex attribute
+   * @param tolerance the largest acceptable error on every component
+   * @return true if all the components are represented within @p tolerance
+   */
+  bool halfPrecisionAllows(VertexAttribute attribute, float tolerance) const;
+
+  /**
+   * @brief provides the size of an encoded attribute
+   * @param attribute the vertex attribute
+   * @param encoding its encoding
+   * @return the size in bytes (0 if the encoding does not apply to the attribute)
+   */
+  static size_t encodedSize(VertexAttribute attribute, VertexEncoding encoding);
+
+  /// A view on the indices of an IBO, narrowed to 16 bits when all of them fit
+  typedef std::variant<std::span<const glm::uint16>, std::span<const glm::uint32>> IndexSpan;
 
   /**
    * @brief getter for a given IBO
    * @param materialIndex index of the material associated with the desired IBO.
-   * @return
+   * @return the indices, on 16 bits if the range allows (use std::visit to access them)
    */
-  const std::vector<unsigned int> & ibo(unsigned int materialIndex = 0) const;
+  IndexSpan ibo(unsigned int materialIndex = 0) const;
+
+  /**
+   * @brief getter for the bounds of the faces of a given IBO
+   * @param materialIndex index of the material associated with the desired IBO.
+   * @return the box and sphere bounding the vertices of the IBO, in object space (see FrustumCuller)
+   *
+   * The bounds are computed at load time, or read from the .glitter files that hold them.
+   */
+  const BoundingVolume & partBounds(unsigned int materialIndex = 0) const;
 
   /**
    * @brief getter for the materials
@@ -96,12 +237,37 @@ public:
    */
   Image<> image(const std::string & name) const;
 
+  /**
+   * @brief getter for a texture prepared offline
+   * @param name an alias for the image
+   * @return the baked texture, or nullptr if the image was not baked (then use ObjLoader::image)
+   *
+   * Textures are baked when ObjLoaderOptions::compressTextures or ObjLoaderOptions::generateMipmaps is set
+   * (color maps are then filtered in linear space, normal maps as directions), or when they are read
+   * from a .glitter file that holds them. In the latter case, ObjLoader::image no longer provides
+   * the original pixels of the baked images (a default white image is returned).
+   */
+  const BakedTexture * bakedTexture(const std::string & name) const;
+
+  /**
+   * @brief getter for the file of an image referenced in the materials
+   * @param name an alias for the image
+   * @return the absolute path of the image (or @p name itself for the default images of the loader)
+   */
+  std::string imagePath(const std::string & name) const;
+
   /**
    * @brief provides the number of IBOs available after parsing
    * @return the number of IBOS.
    */
   size_t nbIBOs() const;
 
+  /**
+   * @brief getter for the load report
+   * @return the timings and sizes measured while loading.
+   */
+  const LoadReport & loadReport() const;
+
 private:
   class NamedTextureImages {
   public:
@@ -109,33 +275,56 @@ private:
     NamedTextureImages(const NamedTextureImages &) = delete;
     NamedTextureImages & operator=(const NamedTextureImages &) = delete;
     bool find(const std::string & name) const;
-    void add(const std::string & name, const Image<> & image);
+    void add(const std::string & name, const Image<> & image, bool owned = true);
     const Image<> & operator[](const std::string & name) const;
     ~NamedTextureImages();
     std::vector<std::string> names() const;
 
   private:
     std::unordered_map<std::string, Image<>> m_images;
+    std::unordered_set<std::string> m_borrowedImages; ///< images whose data must not be released
   };
 
 private:
+  typedef std::vector<unsigned int> IBO;
+
   void parseFile(const std::string & filename);
   void loadBinaryFile(const std::string & filename);
+  void loadMappedFile(const std::string & filename);
   void cleanUpDuplicates();
   void computeTangents();
+  void optimizeMesh();
+  void bakeTextures();
+  void narrowIBOs();
+  void computePartBounds();
+  void encodeAttribute(VertexAttribute attribute, VertexEncoding encoding, size_t begin, size_t end, char * destination, size_t stride) const;
+  static std::vector<SimpleMaterial> readMaterials(const std::string & mtllibs, const std::string & rootDir, std::unordered_map<std::string, int> & materialIds);
+  static Image<> readImage(const std::string & filename);
+  static Image<> readImage(const std::string & filename, std::string & error);
+  static std::unordered_map<std::string, MipmapFilter> textureFilters(const std::vector<SimpleMaterial> & materials);
+  static void computeTangents(std::span<const glm::vec3> positions, std::span<const glm::vec2> uvs, std::span<const glm::vec3> normals, std::vector<glm::vec3> & tangents);
+  static void weldVertices(const ObjLoaderOptions & options, float meshExtent, std::vector<glm::vec3> & positions, std::vector<glm::vec4> & colors, std::vector<glm::vec2> & uvs,
+                           std::vector<glm::vec3> & normals, std::vector<glm::vec3> & tangents, std::vector<IBO> & ibos);
+  static void reorderVertices(const MeshOptimizer & optimizer, std::vector<glm::vec3> & positions, std::vector<glm::vec4> & colors, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals,
+                              std::vector<glm::vec3> & tangents, std::vector<IBO> & ibos);
 
 private:
+  ObjLoaderOptions m_options; ///< processing options
+  LoadReport m_loadReport;    ///< timings and sizes measured while loading
   std::string m_rootDir;
   std::vector<glm::vec3> m_vertexPositions;
   std::vector<glm::vec4> m_vertexColors;
   std::vector<glm::vec2> m_vertexUVs;
   std::vector<glm::vec3> m_vertexNormals;
   std::vector<glm::vec3> m_vertexTangents;
-  typedef std::vector<unsigned int> IBO;
   std::vector<IBO> m_ibos;
+  std::vector<std::vector<glm::uint16>> m_shortIBOs; ///< 16 bits copies of the IBOs that fit (the 32 bits versions are then released)
+  std::vector<BoundingVolume> m_partBounds;          ///< bounds of the IBOs (unless they are mapped)
   NamedTextureImages m_images;
   std::vector<SimpleMaterial> m_materials;
-  void loadImage(std::string texture_filename);
+  std::unordered_map<std::string, BakedTexture> m_bakedTextures; ///< textures prepared offline, by image name
+  std::vector<std::vector<char>> m_bakedTextureData;             ///< storage of the levels of the baked textures (unless they are mapped)
+  std::unique_ptr<GlitterFile> m_mappedFile; ///< memory mapping of a version 2 .glitter file (if any)
   static unsigned char white[4];
   static unsigned char bluish[4];
   static std::string defaultDiffuseName;
@@ -0,0 +1,174 @@
+#include "Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+/// State of a parallel loop, shared with the jobs that may start after the loop ended
+struct ParallelLoop {
+  std::atomic<size_t> next{0};        ///< next index to be dispatched
+  std::mutex mutex;                   ///< protects running and closed
+  std::condition_variable finished;   ///< signals that the last running job ended
+  unsigned int running = 0;           ///< number of jobs calling the task
+  bool closed = false;                ///< whether the calling thread stopped waiting for new jobs
+};
+} // namespace
+
+unsigned int defaultThreadCount()
+{
+  unsigned int count = std::thread::hardware_concurrency();
+  return (count == 0) ? 1 : count;
+}
+
+ThreadPool::ThreadPool(unsigned int nbThreads)
+{
+  for (unsigned int t = 0; t < nbThreads; t++) {
+    m_threads.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+  for (std::thread & thread : m_threads) {
+    thread.join();
+  }
+}
+
+ThreadPool & ThreadPool::shared()
+{
+  // never destroyed: a worker calling exit() would otherwise join itself
+  static ThreadPool * pool = new ThreadPool(defaultThreadCount() - 1);
+  return *pool;
+}
+
+unsigned int ThreadPool::size() const
+{
+  return m_threads.size();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+  }
+  m_condition.notify_one();
+}
+
+void ThreadPool::work()
+{
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_stopping or not m_jobs.empty(); });
+      if (m_jobs.empty()) {
+        return;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    job();
+  }
+}
+
+/// Tasks of a TaskGroup
+struct TaskGroup::State {
+  std::mutex mutex;                          ///< protects pending and running
+  std::condition_variable finished;          ///< signals the end of a task
+  std::deque<std::function<void()>> pending; ///< tasks not started yet
+  unsigned int running = 0;                  ///< number of tasks being run
+};
+
+TaskGroup::TaskGroup(ThreadPool & pool) : m_pool(pool), m_state(std::make_shared<State>()) {}
+
+TaskGroup::~TaskGroup()
+{
+  wait();
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->pending.push_back(std::move(task));
+  }
+  // without worker threads, the task is run by TaskGroup::wait
+  if (m_pool.size() > 0) {
+    // the job may find the queue empty if the task was already run by TaskGroup::wait
+    std::shared_ptr<State> state = m_state;
+    m_pool.submit([state]() { runPending(*state); });
+  }
+}
+
+void TaskGroup::wait()
+{
+  while (runPending(*m_state)) {
+  }
+  std::unique_lock<std::mutex> lock(m_state->mutex);
+  m_state->finished.wait(lock, [this]() { return m_state->running == 0 and m_state->pending.empty(); });
+}
+
+bool TaskGroup::runPending(State & state)
+{
+  std::function<void()> task;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.pending.empty()) {
+      return false;
+    }
+    task = std::move(state.pending.front());
+    state.pending.pop_front();
+    state.running++;
+  }
+  task();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.running--;
+  state.finished.notify_all();
+  return true;
+}
+
+void parallelFor(size_t count, const std::function<void(size_t)> & task, unsigned int nbThreads)
+{
+  if (nbThreads == 0) {
+    nbThreads = defaultThreadCount();
+  }
+  ThreadPool & pool = ThreadPool::shared();
+  nbThreads = std::min<size_t>(std::min(nbThreads, pool.size() + 1), count);
+  if (nbThreads <= 1) {
+    for (size_t k = 0; k < count; k++) {
+      task(k);
+    }
+    return;
+  }
+  std::shared_ptr<ParallelLoop> loop = std::make_shared<ParallelLoop>();
+  for (unsigned int t = 1; t < nbThreads; t++) {
+    pool.submit([loop, &task, count]() {
+      {
+        std::lock_guard<std::mutex> lock(loop->mutex);
+        if (loop->closed) {
+          return;
+        }
+        loop->running++;
+      }
+      for (size_t k = loop->next++; k < count; k = loop->next++) {
+        task(k);
+      }
+      std::lock_guard<std::mutex> lock(loop->mutex);
+      if (--loop->running == 0) {
+        loop->finished.notify_all();
+      }
+    });
+  }
+  for (size_t k = loop->next++; k < count; k = loop->next++) {
+    task(k);
+  }
+  std::unique_lock<std::mutex> lock(loop->mutex);
+  loop->closed = true;
+  loop->finished.wait(lock, [&loop]() { return loop->running == 0; });
+}
@@ -0,0 +1,130 @@
+/** @file */
+#ifndef __GLITTER_PARALLEL_H__
+#define __GLITTER_PARALLEL_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief number of threads used by default by the parallel algorithms (number of hardware threads)
+unsigned int defaultThreadCount();
+
+/**
+ * @brief A set of worker threads running the jobs submitted to it
+ *
+ * The threads are created once and wait for jobs, so that short parallel loops do
+ * not pay for the creation of threads. Jobs are run in submission order.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class ThreadPool {
+public:
+  /**
+   * @brief Starts the worker threads
+   * @param nbThreads the number of worker threads (may be 0)
+   */
+  ThreadPool(unsigned int nbThreads);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief Destructor (waits for the submitted jobs and stops the threads)
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief the pool used by the parallel algorithms
+   * @return a pool of ::defaultThreadCount - 1 threads (the calling thread being the last worker)
+   */
+  static ThreadPool & shared();
+
+  /**
+   * @brief size
+   * @return the number of worker threads
+   */
+  unsigned int size() const;
+
+  /**
+   * @brief queues a job, run as soon as a worker thread is available
+   * @param job the job
+   */
+  void submit(std::function<void()> job);
+
+private:
+  /// loop of the worker threads
+  void work();
+
+private:
+  std::vector<std::thread> m_threads;       ///< the worker threads
+  std::deque<std::function<void()>> m_jobs; ///< jobs not started yet
+  std::mutex m_mutex;                       ///< protects m_jobs and m_stopping
+  std::condition_variable m_condition;      ///< signals new jobs (or the destruction of the pool)
+  bool m_stopping = false;                  ///< whether the pool is being destroyed
+};
+
+/**
+ * @brief A group of independent tasks run in the background by a ThreadPool
+ *
+ * Tasks are queued with TaskGroup::run and start as soon as a worker thread is
+ * available, while the calling thread goes on with other work. TaskGroup::wait runs
+ * the tasks not started yet on the calling thread (so that the group completes even
+ * if all the workers are busy), then waits for the others.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class TaskGroup {
+public:
+  /**
+   * @brief Constructor
+   * @param pool the threads running the tasks
+   */
+  TaskGroup(ThreadPool & pool = ThreadPool::shared());
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup & operator=(const TaskGroup &) = delete;
+
+  /**
+   * @brief Destructor (waits for all the tasks)
+   */
+  ~TaskGroup();
+
+  /**
+   * @brief queues a task
+   * @param task the task
+   */
+  void run(std::function<void()> task);
+
+  /**
+   * @brief waits until all the queued tasks are done
+   */
+  void wait();
+
+private:
+  struct State;
+
+  /// runs a task not started yet (returns false if there is none)
+  static bool runPending(State & state);
+
+private:
+  ThreadPool & m_pool;            ///< the threads running the tasks
+  std::shared_ptr<State> m_state; ///< the tasks (shared with the jobs submitted to the pool)
+};
+
+/**
+ * @brief runs a task for every index of a range on several threads
+ * @param count the number of indices (the task is called for 0, 1, ..., @p count - 1)
+ * @param task the task to be run, called once per index
+ * @param nbThreads the maximum number of threads (0 means ::defaultThreadCount)
+ *
+ * The indices are dispatched dynamically to the threads of ThreadPool::shared, and the
+ * function returns once all the tasks are done. The calling thread takes part in the work,
+ * so that nested calls cannot dead lock: workers that only start once all the indices
+ * have been dispatched return immediately.
+ */
+void parallelFor(size_t count, const std::function<void(size_t)> & task, unsigned int nbThreads = 0);
+
+#endif // !defined(__GLITTER_PARALLEL_H__)
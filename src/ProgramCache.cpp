@@ -0,0 +1,42 @@
+#include "ProgramCache.hpp"
+#include <algorithm>
+
+ProgramCache & ProgramCache::shared()
+{
+  static ProgramCache cache;
+  return cache;
+}
+
+std::shared_ptr<Program> ProgramCache::program(const std::string & vname, const std::string & fname, const std::vector<std::string> & defines)
+{
+  // the sources are a few kilobytes: using them as the key is cheaper than a compilation, and free of collisions
+  std::string key = Shader::source(vname, defines);
+  key.push_back('\0');
+  key += Shader::source(fname, defines);
+  // the keys of the released programs are dropped, so that the cache does not keep their sources (a few programs are cached)
+  std::erase_if(m_programs, [](const auto & entry) { return entry.second.expired(); });
+  std::weak_ptr<Program> & entry = m_programs[key];
+  if (std::shared_ptr<Program> program = entry.lock()) {
+    m_statistics.hits++;
+    return program;
+  }
+  std::shared_ptr<Program> program(new Program(vname, fname, defines));
+  entry = program;
+  m_statistics.misses++;
+  return program;
+}
+
+const ProgramCache::Statistics & ProgramCache::statistics() const
+{
+  return m_statistics;
+}
+
+void ProgramCache::resetStatistics()
+{
+  m_statistics = Statistics();
+}
+
+size_t ProgramCache::size() const
+{
+  return std::count_if(m_programs.begin(), m_programs.end(), [](const auto & entry) { return not entry.second.expired(); });
+}
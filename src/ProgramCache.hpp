@@ -0,0 +1,75 @@
+/** @file */
+#ifndef __GLITTER_PROGRAM_CACHE_H__
+#define __GLITTER_PROGRAM_CACHE_H__
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "glApi.hpp"
+
+/**
+ * @brief A cache of the linked programs, shared by all the render objects
+ *
+ * Programs are looked up by the source code of their shaders (once the preprocessor definitions
+ * are inserted), so that the render objects asking for the same shaders share a single program
+ * instead of compiling and linking their own copy. Like the TextureCache, the cache only holds
+ * weak references: a program is released as soon as no render object uses it anymore.
+ *
+ * Since the program is shared, the per-object and per-material values must be set before each
+ * draw call (or stored in uniform buffers), not once at load time.
+ *
+ * @note The cache must only be used by the thread owning the OpenGL context.
+ */
+class ProgramCache {
+public:
+  /**
+   * @brief Counters of the requests served by the cache
+   */
+  struct Statistics {
+    size_t hits = 0;   ///< requests served by a program already linked
+    size_t misses = 0; ///< requests that compiled and linked a program
+  };
+
+  ProgramCache() {}
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache & operator=(const ProgramCache &) = delete;
+
+  /**
+   * @brief the cache used by the applications
+   * @return a cache living as long as the program
+   */
+  static ProgramCache & shared();
+
+  /**
+   * @brief provides the program made of two shaders
+   * @param vname filename of the vertex shader
+   * @param fname filename of the fragment shader
+   * @param defines the preprocessor definitions of both shaders (see Shader::source)
+   * @return the program
+   */
+  std::shared_ptr<Program> program(const std::string & vname, const std::string & fname, const std::vector<std::string> & defines = {});
+
+  /**
+   * @brief getter for the counters
+   * @return the counters since the creation of the cache or the last call to ProgramCache::resetStatistics
+   */
+  const Statistics & statistics() const;
+
+  /**
+   * @brief resets the counters
+   */
+  void resetStatistics();
+
+  /**
+   * @brief counts the programs in use
+   * @return the number of programs still referenced by a render object
+   */
+  size_t size() const;
+
+private:
+  std::unordered_map<std::string, std::weak_ptr<Program>> m_programs; ///< the programs, by source code of their shaders
+  Statistics m_statistics;                                           ///< the counters
+};
+
+#endif // !defined(__GLITTER_PROGRAM_CACHE_H__)
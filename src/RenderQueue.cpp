@@ -0,0 +1,119 @@
+#include "RenderQueue.hpp"
+#include <bit>
+
+namespace
+{
+/// the 24 most significant bits of a non negative depth, which are ordered like the depths
+std::uint64_t depthBits(float depth)
+{
+  if (not(depth > 0)) {
+    return 0;
+  }
+  return std::bit_cast<std::uint32_t>(depth) >> 7;
+}
+} // namespace
+
+template <typename Map> std::uint64_t RenderQueue::number(Map & numbers, const typename Map::key_type & object)
+{
+  return numbers.emplace(object, numbers.size()).first->second;
+}
+
+void RenderQueue::submit(Packet packet)
+{
+  std::uint64_t key = (number(m_programs, packet.program) & 0xff) << 56;
+  key |= (number(m_textureSets, packet.textures) & 0xffff) << 40;
+  key |= (number(m_vaos, packet.vao) & 0xffff) << 24;
+  key |= depthBits(packet.depth);
+  m_entries.push_back(Entry{key, std::uint32_t(m_packets.size())});
+  m_packets.push_back(std::move(packet));
+}
+
+void RenderQueue::execute()
+{
+  Statistics statistics;
+  statistics.packets = m_packets.size();
+  const Packet none;
+  for (size_t k = 0; k < m_packets.size(); k++) {
+    statistics.unsortedChanges += stateChanges((k > 0) ? m_packets[k - 1] : none, m_packets[k]);
+  }
+  sortEntries();
+  const Packet * previous = &none;
+  for (const Entry & entry : m_entries) {
+    const Packet & packet = m_packets[entry.index];
+    statistics.sortedChanges += stateChanges(*previous, packet);
+    if (packet.program != previous->program) {
+      packet.program->bind();
+    }
+    for (size_t k = 0; k < nbTextures; k++) {
+      const TextureBinding & binding = packet.textures[k];
+      if (binding.sampler and binding != previous->textures[k]) {
+        if (binding.sampler != previous->textures[k].sampler) {
+          binding.sampler->bind();
+        }
+        binding.sampler->attachTexture(*binding.texture);
+      }
+    }
+    if (packet.setUniforms) {
+      packet.setUniforms(*packet.program);
+    }
+    packet.vao->draw();
+    previous = &packet;
+  }
+  if (previous != &none) {
+    previous->program->unbind();
+    for (const TextureBinding & binding : previous->textures) {
+      if (binding.sampler) {
+        binding.sampler->unbind();
+      }
+    }
+  }
+  m_lastFrame = statistics;
+  m_packets.clear();
+  m_entries.clear();
+  m_programs.clear();
+  m_textureSets.clear();
+  m_vaos.clear();
+}
+
+const RenderQueue::Statistics & RenderQueue::lastFrame() const
+{
+  return m_lastFrame;
+}
+
+size_t RenderQueue::stateChanges(const Packet & previous, const Packet & next)
+{
+  size_t changes = (next.program != previous.program) + (next.vao != previous.vao);
+  for (size_t k = 0; k < nbTextures; k++) {
+    changes += (next.textures[k].sampler and next.textures[k] != previous.textures[k]);
+  }
+  return changes;
+}
+
+void RenderQueue::sortEntries()
+{
+  if (m_entries.empty()) {
+    return;
+  }
+  m_sorted.resize(m_entries.size());
+  for (int shift = 0; shift < 64; shift += 8) {
+    size_t offsets[256] = {};
+    for (const Entry & entry : m_entries) {
+      offsets[(entry.key >> shift) & 0xff]++;
+    }
+    // all the keys share this byte (e.g. the unused bits of the numbers): the pass would not move them
+    if (offsets[(m_entries[0].key >> shift) & 0xff] == m_entries.size()) {
+      continue;
+    }
+    size_t offset = 0;
+    for (size_t & count : offsets) {
+      size_t start = offset;
+      offset += count;
+      count = start;
+    }
+    // stable, so that the previous passes order the entries sharing this byte
+    for (const Entry & entry : m_entries) {
+      m_sorted[offsets[(entry.key >> shift) & 0xff]++] = entry;
+    }
+    m_entries.swap(m_sorted);
+  }
+}
@@ -0,0 +1,115 @@
+/** @file */
+#ifndef __GLITTER_RENDER_QUEUE_H__
+#define __GLITTER_RENDER_QUEUE_H__
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "glApi.hpp"
+
+/**
+ * @brief A queue of draw calls, sorted to minimize the state changes between them
+ *
+ * Instead of drawing themselves, the render objects submit a RenderQueue::Packet per draw call,
+ * describing the state it needs (program, textures and VAO). Once all the packets of a frame are
+ * submitted, RenderQueue::execute sorts them by a 64-bit key, then draws them while only changing
+ * the state that differs from the previous packet. The key is made of, from the most significant bits:
+ *   - the program (8 bits), the most expensive state change,
+ *   - the texture set (16 bits),
+ *   - the VAO (16 bits),
+ *   - the depth (24 bits), so that the packets sharing the same state are drawn front to back.
+ *
+ * The programs, texture sets and VAOs are numbered in the order of their first submission during
+ * the frame (the numbers wrap around when they do not fit in their bits, which only makes the
+ * order less efficient).
+ *
+ * @note The queue must only be used by the thread owning the OpenGL context.
+ */
+class RenderQueue {
+public:
+  /// Number of texture units a packet can attach textures to
+  static const size_t nbTextures = 4;
+
+  /**
+   * @brief A texture attached to the texture unit of a sampler
+   */
+  struct TextureBinding {
+    const Sampler * sampler = nullptr; ///< the sampler, bound to its texture unit (nullptr if the unit is unused)
+    const Texture * texture = nullptr; ///< the texture attached to the sampler unit
+
+    auto operator<=>(const TextureBinding &) const = default;
+  };
+
+  /**
+   * @brief A draw call and the state it needs
+   */
+  struct Packet {
+    const Program * program = nullptr;                ///< the program
+    std::array<TextureBinding, nbTextures> textures;  ///< the textures attached to the sampler units
+    const VAO * vao = nullptr;                        ///< the VAO drawn (see VAO::draw)
+    float depth = 0;                                  ///< the distance to the camera
+    std::function<void(const Program &)> setUniforms; ///< sets the per-draw uniforms, once the program is bound (may be empty)
+  };
+
+  /**
+   * @brief Counters of a frame
+   */
+  struct Statistics {
+    size_t packets = 0;         ///< draw calls
+    size_t unsortedChanges = 0; ///< state changes needed to draw the packets in submission order
+    size_t sortedChanges = 0;   ///< state changes made to draw the sorted packets
+  };
+
+  RenderQueue() {}
+  RenderQueue(const RenderQueue &) = delete;
+  RenderQueue & operator=(const RenderQueue &) = delete;
+
+  /**
+   * @brief adds a draw call to the current frame
+   * @param packet the draw call
+   *
+   * @note The program, samplers, textures and VAO must live until RenderQueue::execute.
+   */
+  void submit(Packet packet);
+
+  /**
+   * @brief sorts and draws the packets of the frame, then empties the queue
+   */
+  void execute();
+
+  /**
+   * @brief getter for the counters of the last frame
+   * @return the counters of the last frame drawn by RenderQueue::execute
+   */
+  const Statistics & lastFrame() const;
+
+private:
+  /// A packet to sort
+  struct Entry {
+    std::uint64_t key;   ///< the sort key
+    std::uint32_t index; ///< the index of the packet in m_packets
+  };
+
+  /// numbers the state objects in the order of their first submission
+  template <typename Map> static std::uint64_t number(Map & numbers, const typename Map::key_type & object);
+
+  /// counts the state changes between two consecutive packets
+  static size_t stateChanges(const Packet & previous, const Packet & next);
+
+  /// sorts m_entries by key (least significant digit radix sort, one byte at a time)
+  void sortEntries();
+
+private:
+  std::vector<Packet> m_packets;                                                 ///< the packets of the frame, in submission order
+  std::vector<Entry> m_entries;                                                  ///< the packets to sort
+  std::vector<Entry> m_sorted;                                                   ///< scratch space of the radix sort
+  std::unordered_map<const Program *, std::uint64_t> m_programs;                 ///< numbers of the programs of the frame
+  std::map<std::array<TextureBinding, nbTextures>, std::uint64_t> m_textureSets; ///< numbers of the texture sets of the frame
+  std::unordered_map<const VAO *, std::uint64_t> m_vaos;                         ///< numbers of the VAOs of the frame
+  Statistics m_lastFrame;                                                        ///< the counters of the last frame
+};
+
+#endif // !defined(__GLITTER_RENDER_QUEUE_H__)
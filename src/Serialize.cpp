@@ -3,6 +3,7 @@
 
 #ifdef IS_LITTLE_ENDIAN
 void swapEndianness(glm::int16 &) {}
+void swapEndianness(glm::uint16 &) {}
 void swapEndianness(glm::int32 &) {}
 void swapEndianness(glm::uint32 &) {}
 void swapEndianness(glm::float32 &) {}
@@ -19,6 +20,14 @@ void swapEndianness(glm::int16 & value)
   value |= (v & 0xFF) << 8;
 }
 
+void swapEndianness(glm::uint16 & value)
+{
+  glm::uint16 v = value;
+  value = 0;
+  value |= (v & 0xFF00) >> 8;
+  value |= (v & 0xFF) << 8;
+}
+
 void swapEndianness(glm::int32 & value)
 {
   glm::int32 v = value;
@@ -29,7 +38,7 @@ void swapEndianness(glm::int32 & value)
   value |= (v & 0x000000FF) << 24;
 }
 
-void swapEndianness(glm::uint32 &)
+void swapEndianness(glm::uint32 & value)
 {
   glm::uint32 v = value;
   value = 0;
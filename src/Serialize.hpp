@@ -6,7 +6,9 @@
 #define RESOURCE_DIR "."
 #endif
 
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -15,6 +17,9 @@
 /// @brief swap bytes of a 2-bytes integer
 void swapEndianness(glm::int16 &);
 
+/// @brief swap bytes of a 2-bytes unsigned integer
+void swapEndianness(glm::uint16 &);
+
 /// @brief swap bytes of a 4-bytes integer
 void swapEndianness(glm::int32 &);
 
@@ -48,6 +53,12 @@ template <> struct SerializationTraits<glm::int16> {
   static const char * VectorTag() { return "VI16"; }
 };
 
+template <> struct SerializationTraits<glm::uint16> {
+  static const bool IsSerializable = true;
+  static const bool IsEndiannessDependent = true;
+  static const char * VectorTag() { return "VU16"; }
+};
+
 template <> struct SerializationTraits<glm::int32> {
   static const bool IsSerializable = true;
   static const bool IsEndiannessDependent = true;
@@ -162,7 +173,7 @@ template <typename T> inline void write(const T & v, std::ostream & stream)
   if (SerializationTraits<T>::IsEndiannessDependent) {
     swapEndianness(value);
   }
-  stream.write(reinterpret_cast<const char *>(&v), sizeof(v));
+  stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
 }
 
 inline void write(const std::string & str, std::ostream & stream)
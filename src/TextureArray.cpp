@@ -0,0 +1,115 @@
+#include "TextureArray.hpp"
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include "ObjLoader.hpp"
+
+namespace
+{
+/// What makes textures compatible: format, then the sizes of the levels
+typedef std::tuple<TextureFormat, std::vector<std::pair<int, int>>> ArrayKey;
+
+ArrayKey arrayKey(const BakedTexture & texture)
+{
+  std::vector<std::pair<int, int>> sizes;
+  for (const BakedTextureLevel & level : texture.levels) {
+    sizes.push_back({level.width, level.height});
+  }
+  return ArrayKey(texture.format, sizes);
+}
+} // namespace
+
+TextureArrayPlan planTextureArrays(const std::vector<std::string> & paths, const std::vector<BakedTexture> & textures, bool mipmaps)
+{
+  // groups the distinct paths by compatibility (the groups are ordered to make the result deterministic)
+  std::unordered_map<std::string, size_t> firstOccurrences;
+  std::map<ArrayKey, std::vector<size_t>> groups;
+  for (size_t k = 0; k < paths.size(); k++) {
+    if (firstOccurrences.insert({paths[k], k}).second) {
+      groups[arrayKey(textures[k])].push_back(k);
+    }
+  }
+
+  TextureArrayPlan plan;
+  plan.mipmaps = mipmaps;
+  plan.placements.resize(paths.size());
+  for (const auto & [key, members] : groups) {
+    for (size_t begin = 0; begin < members.size(); begin += maxTextureArrayLayers) {
+      size_t end = std::min(members.size(), begin + maxTextureArrayLayers);
+      TextureArrayPlan::Array array;
+      for (size_t m = begin; m < end; m++) {
+        array.paths.push_back(paths[members[m]]);
+        array.layers.push_back(textures[members[m]]);
+        plan.placements[members[m]] = {plan.arrays.size(), int(m - begin)};
+      }
+      array.hash = TextureCache::textureArrayHash(array.layers, mipmaps);
+      plan.arrays.push_back(std::move(array));
+    }
+  }
+  for (size_t k = 0; k < paths.size(); k++) {
+    plan.placements[k] = plan.placements[firstOccurrences[paths[k]]];
+  }
+  return plan;
+}
+
+TextureArrayPlan planTextureArrays(const ObjLoader & objLoader, const std::vector<std::string> & names, bool mipmaps)
+{
+  std::vector<std::string> paths;
+  std::vector<BakedTexture> textures;
+  // the converted images are moved to the plan (moving the vectors keeps their data in place)
+  std::vector<std::vector<char>> convertedImages;
+  std::unordered_map<std::string, size_t> convertedNames;
+  for (const std::string & name : names) {
+    paths.push_back(objLoader.imagePath(name));
+    if (const BakedTexture * bakedTexture = objLoader.bakedTexture(name)) {
+      textures.push_back(*bakedTexture);
+      continue;
+    }
+    Image<> image = objLoader.image(name);
+    auto converted = convertedNames.find(name);
+    if (converted == convertedNames.end()) {
+      converted = convertedNames.insert({name, convertedImages.size()}).first;
+      convertedImages.push_back(compressTexture(image, TextureFormat::RGBA8));
+    }
+    textures.push_back(BakedTexture{TextureFormat::RGBA8, {BakedTextureLevel{image.width, image.height, std::span<const char>(convertedImages[converted->second])}}});
+  }
+  TextureArrayPlan plan = planTextureArrays(paths, textures, mipmaps);
+  plan.convertedImages = std::move(convertedImages);
+  return plan;
+}
+
+std::shared_ptr<Texture> uploadTextureArray(const TextureArrayPlan & plan, size_t array, TextureCache & cache)
+{
+  const TextureArrayPlan::Array & planned = plan.arrays[array];
+  return cache.textureArray(planned.paths, planned.layers, plan.mipmaps, planned.hash);
+}
+
+std::vector<TextureArrayLayer> textureArrayLayers(const TextureArrayPlan & plan, const std::vector<std::shared_ptr<Texture>> & arrays)
+{
+  std::vector<TextureArrayLayer> layers;
+  for (const auto & [array, layer] : plan.placements) {
+    layers.push_back(TextureArrayLayer{arrays[array], layer});
+  }
+  return layers;
+}
+
+std::vector<TextureArrayLayer> packTextureArrays(const std::vector<std::string> & paths, const std::vector<BakedTexture> & textures, bool mipmaps, TextureCache & cache)
+{
+  TextureArrayPlan plan = planTextureArrays(paths, textures, mipmaps);
+  std::vector<std::shared_ptr<Texture>> arrays;
+  for (size_t k = 0; k < plan.arrays.size(); k++) {
+    arrays.push_back(uploadTextureArray(plan, k, cache));
+  }
+  return textureArrayLayers(plan, arrays);
+}
+
+std::vector<TextureArrayLayer> packTextureArrays(const ObjLoader & objLoader, const std::vector<std::string> & names, bool mipmaps, TextureCache & cache)
+{
+  TextureArrayPlan plan = planTextureArrays(objLoader, names, mipmaps);
+  std::vector<std::shared_ptr<Texture>> arrays;
+  for (size_t k = 0; k < plan.arrays.size(); k++) {
+    arrays.push_back(uploadTextureArray(plan, k, cache));
+  }
+  return textureArrayLayers(plan, arrays);
+}
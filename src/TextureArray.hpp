@@ -0,0 +1,115 @@
+/** @file */
+#ifndef __GLITTER_TEXTURE_ARRAY_H__
+#define __GLITTER_TEXTURE_ARRAY_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "TextureCache.hpp"
+
+// forward declarations
+class ObjLoader;
+
+/// Largest number of layers of the arrays built by ::packTextureArrays (the minimum GL_MAX_ARRAY_TEXTURE_LAYERS required by OpenGL)
+const size_t maxTextureArrayLayers = 256;
+
+/**
+ * @brief Where a texture landed in the arrays built by ::packTextureArrays
+ */
+struct TextureArrayLayer {
+  std::shared_ptr<Texture> texture; ///< a GL_TEXTURE_2D_ARRAY texture
+  int layer;                        ///< the layer of the texture in the array
+};
+
+/**
+ * @brief The array textures packing a list of textures, prepared without any OpenGL call (see ::planTextureArrays)
+ *
+ * The plan is made on any thread (e.g. the loader thread of an AssetLoader): it converts the images
+ * and hashes the layers of the arrays, so that the thread owning the OpenGL context only uploads
+ * the arrays, one at a time if needed (see ::uploadTextureArray).
+ */
+struct TextureArrayPlan {
+  /// An array texture to be built
+  struct Array {
+    std::vector<std::string> paths;   ///< the files the layers come from
+    std::vector<BakedTexture> layers; ///< the layers
+    TextureCache::ContentHash hash;   ///< the hash of the layers (see TextureCache::textureArrayHash)
+  };
+
+  std::vector<Array> arrays;                      ///< the arrays
+  std::vector<std::pair<size_t, int>> placements; ///< the array and the layer of each texture (in the order of the paths)
+  std::vector<std::vector<char>> convertedImages; ///< the images converted to TextureFormat::RGBA8 (referenced by the layers)
+  bool mipmaps = false;                           ///< whether mipmaps are generated for the arrays whose layers have none
+};
+
+/**
+ * @brief groups textures in as few GL_TEXTURE_2D_ARRAY textures as possible (thread safe: no OpenGL call)
+ * @param paths the files the textures come from (or any names identifying them, equal names denote the same texture)
+ * @param textures the textures (in the order of @p paths), that must outlive the plan
+ * @param mipmaps whether mipmaps are generated for the arrays whose layers have none
+ * @return the arrays to be uploaded
+ *
+ * Textures are compatible if they have the same format, the same number of levels and the same level
+ * sizes. Each group of compatible textures makes an array, split every ::maxTextureArrayLayers layers.
+ */
+TextureArrayPlan planTextureArrays(const std::vector<std::string> & paths, const std::vector<BakedTexture> & textures, bool mipmaps = false);
+
+/**
+ * @brief groups the images referenced by the materials of a loader in GL_TEXTURE_2D_ARRAY textures (thread safe: no OpenGL call)
+ * @param objLoader the loader, that must outlive the plan
+ * @param names aliases of the images (e.g. the diffuse, normal and specular maps of every part)
+ * @param mipmaps whether mipmaps are generated for the arrays whose layers have none
+ * @return the arrays to be uploaded
+ *
+ * The baked textures of the loader are used as is (see ObjLoader::bakedTexture), the other images
+ * are converted to TextureFormat::RGBA8.
+ */
+TextureArrayPlan planTextureArrays(const ObjLoader & objLoader, const std::vector<std::string> & names, bool mipmaps = false);
+
+/**
+ * @brief uploads an array of a plan (or finds it in a cache)
+ * @param plan the plan
+ * @param array the index of the array in TextureArrayPlan::arrays
+ * @param cache the cache the arrays are shared through
+ * @return the GL_TEXTURE_2D_ARRAY texture
+ */
+std::shared_ptr<Texture> uploadTextureArray(const TextureArrayPlan & plan, size_t array, TextureCache & cache = TextureCache::shared());
+
+/**
+ * @brief tells where the textures of a plan landed
+ * @param plan the plan
+ * @param arrays the textures returned by ::uploadTextureArray for all the arrays of the plan
+ * @return where every texture landed (in the order of the paths given to ::planTextureArrays)
+ */
+std::vector<TextureArrayLayer> textureArrayLayers(const TextureArrayPlan & plan, const std::vector<std::shared_ptr<Texture>> & arrays);
+
+/**
+ * @brief packs textures in as few GL_TEXTURE_2D_ARRAY textures as possible
+ * @param paths the files the textures come from (or any names identifying them, equal names denote the same texture)
+ * @param textures the textures (in the order of @p paths)
+ * @param mipmaps whether mipmaps are generated for the arrays whose layers have none
+ * @param cache the cache the arrays are shared through
+ * @return where every texture landed (in the order of @p paths)
+ *
+ * Textures are compatible if they have the same format, the same number of levels and the same level
+ * sizes. Each group of compatible textures makes an array, split every ::maxTextureArrayLayers layers.
+ * The parts of an object whose maps are compatible can then be drawn with a single texture binding,
+ * the layers being selected by a uniform (see shaders/simplemat.f.glsl).
+ */
+std::vector<TextureArrayLayer> packTextureArrays(const std::vector<std::string> & paths, const std::vector<BakedTexture> & textures, bool mipmaps = false,
+                                                 TextureCache & cache = TextureCache::shared());
+
+/**
+ * @brief packs the images referenced by the materials of a loader in GL_TEXTURE_2D_ARRAY textures
+ * @param objLoader the loader
+ * @param names aliases of the images (e.g. the diffuse, normal and specular maps of every part)
+ * @param mipmaps whether mipmaps are generated for the arrays whose layers have none
+ * @param cache the cache the arrays are shared through
+ * @return where every image landed (in the order of @p names)
+ *
+ * The baked textures of the loader are used as is (see ObjLoader::bakedTexture), the other images
+ * are converted to TextureFormat::RGBA8.
+ */
+std::vector<TextureArrayLayer> packTextureArrays(const ObjLoader & objLoader, const std::vector<std::string> & names, bool mipmaps = false, TextureCache & cache = TextureCache::shared());
+
+#endif // !defined(__GLITTER_TEXTURE_ARRAY_H__)
@@ -0,0 +1,219 @@
+#include "TextureCache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include "ObjLoader.hpp"
+
+namespace
+{
+/// 128-bit hash of a sequence of bytes (two multiply-xorshift lanes mixing the same 8-byte words), chained from @p hash
+void hashBytes(std::span<const char> bytes, TextureCache::ContentHash & hash)
+{
+  auto mix = [&hash](std::uint64_t word) {
+    hash.low ^= word * 0xff51afd7ed558ccdull;
+    hash.low = (hash.low << 29 | hash.low >> 35) * 0xc4ceb9fe1a85ec53ull;
+    hash.high ^= word * 0x9e3779b97f4a7c15ull;
+    hash.high = (hash.high << 31 | hash.high >> 33) * 0xbf58476d1ce4e5b9ull;
+  };
+  size_t k = 0;
+  for (; k + 8 <= bytes.size(); k += 8) {
+    std::uint64_t word;
+    memcpy(&word, bytes.data() + k, sizeof(word));
+    mix(word);
+  }
+  std::uint64_t word = bytes.size();
+  memcpy(&word, bytes.data() + k, bytes.size() - k);
+  mix(word);
+}
+
+/// the name of an array texture in the cache
+std::string arrayPath(const std::vector<std::string> & paths, bool mipmaps)
+{
+  std::string path = mipmaps ? "#array#mipmaps" : "#array";
+  for (const std::string & layerPath : paths) {
+    path += "\n" + layerPath;
+  }
+  return path;
+}
+} // namespace
+
+TextureCache::ContentHash TextureCache::Content::hash() const
+{
+  ContentHash hash{0x9e3779b97f4a7c15ull, 0x94d049bb133111ebull};
+  hashBytes(std::span<const char>(reinterpret_cast<const char *>(header.data()), header.size() * sizeof(std::int64_t)), hash);
+  for (std::span<const char> chunk : chunks) {
+    hashBytes(chunk, hash);
+  }
+  hash.low ^= hash.low >> 32;
+  hash.high ^= hash.high >> 31;
+  return hash;
+}
+
+size_t TextureCache::Content::size() const
+{
+  size_t size = 0;
+  for (std::span<const char> chunk : chunks) {
+    size += chunk.size();
+  }
+  return size;
+}
+
+bool TextureCache::Entry::matches(const Content & content, const ContentHash & contentHash) const
+{
+  return hash == contentHash and header == content.header and size == content.size();
+}
+
+TextureCache & TextureCache::shared()
+{
+  static TextureCache cache;
+  return cache;
+}
+
+std::shared_ptr<Texture> TextureCache::texture(const ObjLoader & objLoader, const std::string & name)
+{
+  std::string path = objLoader.imagePath(name);
+  if (const BakedTexture * bakedTexture = objLoader.bakedTexture(name)) {
+    return texture(path, *bakedTexture);
+  }
+  return texture(path, objLoader.image(name));
+}
+
+std::shared_ptr<Texture> TextureCache::texture(const std::string & imagePath, const Image<> & image, bool mipmaps)
+{
+  // an image sent with and without mipmaps makes two textures
+  std::string path = mipmaps ? imagePath + "#mipmaps" : imagePath;
+  if (std::shared_ptr<Texture> texture = findPath(path)) {
+    return texture;
+  }
+  size_t size = size_t(image.width) * image.height * image.depth * image.channels;
+  Content content{{image.width, image.height, image.depth, image.channels, mipmaps}, {std::span<const char>(reinterpret_cast<const char *>(image.data), size)}};
+  ContentHash hash = content.hash();
+  if (std::shared_ptr<Texture> texture = findContent(path, hash, &content)) {
+    return texture;
+  }
+  std::shared_ptr<Texture> texture(new Texture((image.depth > 1) ? GL_TEXTURE_3D : GL_TEXTURE_2D));
+  texture->setData(image, mipmaps);
+  insert(path, hash, texture, content);
+  return texture;
+}
+
+std::shared_ptr<Texture> TextureCache::texture(const std::string & path, const BakedTexture & bakedTexture)
+{
+  if (std::shared_ptr<Texture> texture = findPath(path)) {
+    return texture;
+  }
+  Content content{{-1, std::int64_t(bakedTexture.format), std::int64_t(bakedTexture.levels.size())}, {}};
+  for (const BakedTextureLevel & level : bakedTexture.levels) {
+    content.header.insert(content.header.end(), {level.width, level.height});
+    content.chunks.push_back(level.data);
+  }
+  ContentHash hash = content.hash();
+  if (std::shared_ptr<Texture> texture = findContent(path, hash, &content)) {
+    return texture;
+  }
+  std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D));
+  texture->setData(bakedTexture);
+  insert(path, hash, texture, content);
+  return texture;
+}
+
+std::shared_ptr<Texture> TextureCache::textureArray(const std::vector<std::string> & paths, std::span<const BakedTexture> layers, bool mipmaps)
+{
+  // the layers of a known list of paths are not hashed
+  if (std::shared_ptr<Texture> texture = findPath(arrayPath(paths, mipmaps))) {
+    return texture;
+  }
+  return textureArray(paths, layers, mipmaps, textureArrayHash(layers, mipmaps));
+}
+
+std::shared_ptr<Texture> TextureCache::textureArray(const std::vector<std::string> & paths, std::span<const BakedTexture> layers, bool mipmaps, const ContentHash & hash)
+{
+  std::string path = arrayPath(paths, mipmaps);
+  if (std::shared_ptr<Texture> texture = findPath(path)) {
+    return texture;
+  }
+  Content content = arrayContent(layers, mipmaps);
+  if (std::shared_ptr<Texture> texture = findContent(path, hash, &content)) {
+    return texture;
+  }
+  std::shared_ptr<Texture> texture(new Texture(GL_TEXTURE_2D_ARRAY));
+  texture->setLayers(layers, mipmaps);
+  insert(path, hash, texture, content);
+  return texture;
+}
+
+TextureCache::ContentHash TextureCache::textureArrayHash(std::span<const BakedTexture> layers, bool mipmaps)
+{
+  return arrayContent(layers, mipmaps).hash();
+}
+
+TextureCache::Content TextureCache::arrayContent(std::span<const BakedTexture> layers, bool mipmaps)
+{
+  Content content{{-2, mipmaps, std::int64_t(layers.size())}, {}};
+  for (const BakedTexture & layer : layers) {
+    content.header.insert(content.header.end(), {std::int64_t(layer.format), std::int64_t(layer.levels.size())});
+    for (const BakedTextureLevel & level : layer.levels) {
+      content.header.insert(content.header.end(), {level.width, level.height});
+      content.chunks.push_back(level.data);
+    }
+  }
+  return content;
+}
+
+const TextureCache::Statistics & TextureCache::statistics() const
+{
+  return m_statistics;
+}
+
+void TextureCache::resetStatistics()
+{
+  m_statistics = Statistics();
+}
+
+size_t TextureCache::size() const
+{
+  return std::count_if(m_entries.begin(), m_entries.end(), [](const auto & entry) { return not entry.second.texture.expired(); });
+}
+
+std::shared_ptr<Texture> TextureCache::findPath(const std::string & path)
+{
+  auto it = m_paths.find(path);
+  if (it == m_paths.end()) {
+    return nullptr;
+  }
+  // the content of a known path is neither hashed nor compared again
+  return findContent(path, it->second, nullptr);
+}
+
+std::shared_ptr<Texture> TextureCache::findContent(const std::string & path, const ContentHash & hash, const Content * content)
+{
+  auto it = m_entries.find(hash.low);
+  if (it == m_entries.end()) {
+    return nullptr;
+  }
+  std::shared_ptr<Texture> texture = it->second.texture.lock();
+  // the key of a known path was compared when the path was recorded
+  bool matches = content ? it->second.matches(*content, hash) : it->second.hash == hash;
+  if (not texture or not matches) {
+    return nullptr;
+  }
+  m_paths[path] = hash;
+  m_statistics.hits++;
+  m_statistics.savedBytes += it->second.size;
+  return texture;
+}
+
+void TextureCache::insert(const std::string & path, const ContentHash & hash, const std::shared_ptr<Texture> & texture, const Content & content)
+{
+  std::erase_if(m_entries, [](const auto & entry) { return entry.second.texture.expired(); });
+  std::erase_if(m_paths, [this](const auto & path) { return not m_entries.contains(path.second.low); });
+  Entry entry{texture, hash, content.header, content.size()};
+  m_statistics.misses++;
+  m_statistics.uploadedBytes += entry.size;
+  if (m_entries.contains(hash.low)) {
+    // the texture colliding with a live one is not cached
+    return;
+  }
+  m_paths[path] = hash;
+  m_entries.emplace(hash.low, std::move(entry));
+}
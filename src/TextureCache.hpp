@@ -0,0 +1,170 @@
+/** @file */
+#ifndef __GLITTER_TEXTURE_CACHE_H__
+#define __GLITTER_TEXTURE_CACHE_H__
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "glApi.hpp"
+
+// forward declarations
+class ObjLoader;
+
+/**
+ * @brief A cache of the textures sent to the GPU, shared by all the render objects
+ *
+ * Textures are first looked up by the path of their image, then by a hash of their content, so that
+ * an image referenced by several materials, several loaders, or copied under several names is sent
+ * to the GPU once. A content is identified by a 128-bit hash of its bytes, its dimensions, its format
+ * and its size in bytes: no copy of the content is kept. The cache only holds weak references: a texture
+ * is released as soon as no render object uses it anymore (and is sent again if it is requested later on).
+ *
+ * @note The cache must only be used by the thread owning the OpenGL context.
+ */
+class TextureCache {
+public:
+  /**
+   * @brief Counters of the requests served by the cache
+   */
+  struct Statistics {
+    size_t hits = 0;          ///< requests served by a texture already on the GPU
+    size_t misses = 0;        ///< requests that created a texture
+    size_t uploadedBytes = 0; ///< bytes sent to the GPU by the misses
+    size_t savedBytes = 0;    ///< bytes that the hits did not send again
+  };
+
+  /**
+   * @brief The 128-bit hash of a content (see TextureCache::textureArrayHash)
+   */
+  struct ContentHash {
+    std::uint64_t low = 0;  ///< the first 64 bits
+    std::uint64_t high = 0; ///< the last 64 bits
+
+    bool operator==(const ContentHash &) const = default;
+  };
+
+  TextureCache() {}
+  TextureCache(const TextureCache &) = delete;
+  TextureCache & operator=(const TextureCache &) = delete;
+
+  /**
+   * @brief the cache used by the applications
+   * @return a cache living as long as the program
+   */
+  static TextureCache & shared();
+
+  /**
+   * @brief provides the texture of an image referenced by the materials of a loader
+   * @param objLoader the loader
+   * @param name an alias for the image (see ObjLoader::image)
+   * @return the texture (block compressed if the loader baked the image, see ObjLoader::bakedTexture)
+   */
+  std::shared_ptr<Texture> texture(const ObjLoader & objLoader, const std::string & name);
+
+  /**
+   * @brief provides the texture of an image
+   * @param path the file the image comes from (or any name identifying the image)
+   * @param image the image, only read if the path is unknown
+   * @param mipmaps whether the mipmaps of the texture are generated (see Texture::setData)
+   * @return the texture
+   */
+  std::shared_ptr<Texture> texture(const std::string & path, const Image<> & image, bool mipmaps = false);
+
+  /**
+   * @brief provides the texture of a texture prepared offline
+   * @param path the file the image comes from (or any name identifying the image)
+   * @param bakedTexture the levels of the texture, only read if the path is unknown
+   * @return the texture
+   */
+  std::shared_ptr<Texture> texture(const std::string & path, const BakedTexture & bakedTexture);
+
+  /**
+   * @brief provides the array texture made of several textures
+   * @param paths the files the layers come from (or any names identifying them)
+   * @param layers the layers (see Texture::setLayers), only read if the list of paths is unknown
+   * @param mipmaps whether the mipmaps of the layers are generated (if they have none)
+   * @return the GL_TEXTURE_2D_ARRAY texture
+   */
+  std::shared_ptr<Texture> textureArray(const std::vector<std::string> & paths, std::span<const BakedTexture> layers, bool mipmaps = false);
+
+  /**
+   * @brief provides the array texture made of several textures, whose content is already hashed
+   * @param paths the files the layers come from (or any names identifying them)
+   * @param layers the layers (see Texture::setLayers), only read if the list of paths is unknown
+   * @param mipmaps whether the mipmaps of the layers are generated (if they have none)
+   * @param hash the hash of the layers, computed by TextureCache::textureArrayHash (e.g. on a loader thread)
+   * @return the GL_TEXTURE_2D_ARRAY texture
+   */
+  std::shared_ptr<Texture> textureArray(const std::vector<std::string> & paths, std::span<const BakedTexture> layers, bool mipmaps, const ContentHash & hash);
+
+  /**
+   * @brief hashes the content of an array texture (thread safe: no OpenGL call, the cache is not read)
+   * @param layers the layers of the array
+   * @param mipmaps whether the mipmaps of the layers are generated (if they have none)
+   * @return the hash expected by TextureCache::textureArray
+   */
+  static ContentHash textureArrayHash(std::span<const BakedTexture> layers, bool mipmaps = false);
+
+  /**
+   * @brief getter for the counters
+   * @return the counters since the creation of the cache or the last call to TextureCache::resetStatistics
+   */
+  const Statistics & statistics() const;
+
+  /**
+   * @brief resets the counters
+   */
+  void resetStatistics();
+
+  /**
+   * @brief counts the textures in use
+   * @return the number of textures still referenced by a render object
+   */
+  size_t size() const;
+
+private:
+  /// The content of a texture: the integers describing its dimensions and format, and its bytes (in several chunks)
+  struct Content {
+    std::vector<std::int64_t> header;          ///< the dimensions and the format
+    std::vector<std::span<const char>> chunks; ///< the bytes (e.g. one chunk per level)
+
+    /// hashes the content
+    ContentHash hash() const;
+
+    /// counts the bytes of the content
+    size_t size() const;
+  };
+
+  /// A texture on the GPU
+  struct Entry {
+    std::weak_ptr<Texture> texture;   ///< the texture (expired once no render object uses it)
+    ContentHash hash;                 ///< the hash of the content
+    std::vector<std::int64_t> header; ///< the dimensions and the format of the content
+    size_t size;                      ///< the number of bytes of the content (sent to the GPU)
+
+    /// compares the key of the texture with the one of another content
+    bool matches(const Content & content, const ContentHash & hash) const;
+  };
+
+  /// describes the content of an array texture
+  static Content arrayContent(std::span<const BakedTexture> layers, bool mipmaps);
+
+  /// finds the live texture of a path (or nullptr)
+  std::shared_ptr<Texture> findPath(const std::string & path);
+
+  /// finds the live texture of a content (or nullptr), and records the path of the content
+  std::shared_ptr<Texture> findContent(const std::string & path, const ContentHash & hash, const Content * content);
+
+  /// records a new texture (not cached if another live texture has the same low 64 bits of hash), and forgets the expired ones
+  void insert(const std::string & path, const ContentHash & hash, const std::shared_ptr<Texture> & texture, const Content & content);
+
+private:
+  std::unordered_map<std::string, ContentHash> m_paths; ///< hashes of the contents of the known paths
+  std::unordered_map<std::uint64_t, Entry> m_entries;   ///< the textures, by the low 64 bits of the hash of their content
+  Statistics m_statistics;                                ///< the counters
+};
+
+#endif // !defined(__GLITTER_TEXTURE_CACHE_H__)
@@ -0,0 +1,742 @@
+#include "TextureCompression.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <glm/gtc/constants.hpp>
+#include <limits>
+#include "Parallel.hpp"
+#if defined(__SSE__) or defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+/// The RGBA texels of a 4x4 block, row by row
+typedef unsigned char Block[16][4];
+
+/// reads a texel as RGBA
+void fetchTexel(const Image<> & image, int x, int y, unsigned char * texel)
+{
+  const unsigned char * p = image.data + (size_t(y) * image.width + x) * image.channels;
+  switch (image.channels) {
+  case 1:
+    texel[0] = texel[1] = texel[2] = p[0];
+    texel[3] = 255;
+    break;
+  case 2:
+    texel[0] = texel[1] = texel[2] = p[0];
+    texel[3] = p[1];
+    break;
+  case 3:
+    texel[0] = p[0];
+    texel[1] = p[1];
+    texel[2] = p[2];
+    texel[3] = 255;
+    break;
+  default:
+    std::copy(p, p + 4, texel);
+  }
+}
+
+/// gathers a 4x4 block (the last row and column are replicated at the borders of the image)
+void fetchBlock(const Image<> & image, int blockX, int blockY, Block & block)
+{
+  for (int y = 0; y < 4; y++) {
+    for (int x = 0; x < 4; x++) {
+      fetchTexel(image, std::min(4 * blockX + x, image.width - 1), std::min(4 * blockY + y, image.height - 1), block[4 * y + x]);
+    }
+  }
+}
+
+void storeLittleEndian(std::uint64_t value, size_t nbBytes, char * output)
+{
+  for (size_t b = 0; b < nbBytes; b++) {
+    output[b] = char(value >> (8 * b));
+  }
+}
+
+std::uint64_t loadLittleEndian(const char * input, size_t nbBytes)
+{
+  std::uint64_t value = 0;
+  for (size_t b = 0; b < nbBytes; b++) {
+    value |= std::uint64_t(static_cast<unsigned char>(input[b])) << (8 * b);
+  }
+  return value;
+}
+
+/// quantizes a color (components in [0, 255]) on 5, 6 and 5 bits
+glm::uint16 packRGB565(const glm::vec3 & color)
+{
+  int r = std::clamp(int(std::lround(color.x * 31 / 255)), 0, 31);
+  int g = std::clamp(int(std::lround(color.y * 63 / 255)), 0, 63);
+  int b = std::clamp(int(std::lround(color.z * 31 / 255)), 0, 31);
+  return glm::uint16((r << 11) | (g << 5) | b);
+}
+
+glm::ivec3 unpackRGB565(glm::uint16 color)
+{
+  int r = (color >> 11) & 31;
+  int g = (color >> 5) & 63;
+  int b = color & 31;
+  return glm::ivec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+/// the colors of a BC1 block (@p fourColors is false for the 3 colors + transparent black mode of BC1 blocks whose c0 <= c1)
+void colorPalette(glm::uint16 c0, glm::uint16 c1, bool fourColors, glm::ivec4 palette[4])
+{
+  glm::ivec3 p0 = unpackRGB565(c0);
+  glm::ivec3 p1 = unpackRGB565(c1);
+  palette[0] = glm::ivec4(p0, 255);
+  palette[1] = glm::ivec4(p1, 255);
+  if (fourColors) {
+    palette[2] = glm::ivec4((2 * p0 + p1) / 3, 255);
+    palette[3] = glm::ivec4((p0 + 2 * p1) / 3, 255);
+  } else {
+    palette[2] = glm::ivec4((p0 + p1) / 2, 255);
+    palette[3] = glm::ivec4(0);
+  }
+}
+
+/// chooses the closest color of the palette for every texel, and returns the squared error
+int selectColorIndices(const Block & block, glm::uint16 c0, glm::uint16 c1, glm::uint32 & indices)
+{
+  glm::ivec4 palette[4];
+  colorPalette(c0, c1, true, palette);
+  int error = 0;
+  indices = 0;
+  for (int k = 0; k < 16; k++) {
+    int bestIndex = 0;
+    int bestError = std::numeric_limits<int>::max();
+    for (int i = 0; i < 4; i++) {
+      glm::ivec3 difference = glm::ivec3(block[k][0], block[k][1], block[k][2]) - glm::ivec3(palette[i]);
+      int squaredError = difference.x * difference.x + difference.y * difference.y + difference.z * difference.z;
+      if (squaredError < bestError) {
+        bestError = squaredError;
+        bestIndex = i;
+      }
+    }
+    error += bestError;
+    indices |= glm::uint32(bestIndex) << (2 * k);
+  }
+  return error;
+}
+
+/// encodes the colors of a block in 8 bytes (4 colors mode)
+void encodeColorBlock(const Block & block, char * output)
+{
+  glm::vec3 colors[16];
+  glm::vec3 mean(0);
+  glm::vec3 minColor(255), maxColor(0);
+  for (int k = 0; k < 16; k++) {
+    colors[k] = glm::vec3(block[k][0], block[k][1], block[k][2]);
+    mean += colors[k];
+    minColor = glm::min(minColor, colors[k]);
+    maxColor = glm::max(maxColor, colors[k]);
+  }
+  mean /= 16.f;
+
+  // principal axis of the colors (power iterations on the symmetric covariance matrix)
+  float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+  for (int k = 0; k < 16; k++) {
+    glm::vec3 centered = colors[k] - mean;
+    xx += centered.x * centered.x;
+    xy += centered.x * centered.y;
+    xz += centered.x * centered.z;
+    yy += centered.y * centered.y;
+    yz += centered.y * centered.z;
+    zz += centered.z * centered.z;
+  }
+  glm::vec3 axis = maxColor - minColor;
+  for (int iteration = 0; iteration < 4 and glm::dot(axis, axis) > 1e-12f; iteration++) {
+    glm::vec3 product(xx * axis.x + xy * axis.y + xz * axis.z, xy * axis.x + yy * axis.y + yz * axis.z, xz * axis.x + yz * axis.y + zz * axis.z);
+    axis = (glm::dot(product, product) > 1e-12f) ? glm::normalize(product) : glm::vec3(0);
+  }
+  glm::uint16 c0 = packRGB565(mean);
+  glm::uint16 c1 = c0;
+  if (glm::dot(axis, axis) > 1e-12f) {
+    float minProjection = std::numeric_limits<float>::max();
+    float maxProjection = -std::numeric_limits<float>::max();
+    for (int k = 0; k < 16; k++) {
+      float projection = glm::dot(colors[k] - mean, axis);
+      minProjection = std::min(minProjection, projection);
+      maxProjection = std::max(maxProjection, projection);
+    }
+    // the endpoints are moved slightly inwards, since the extreme colors are rarely the most frequent ones
+    glm::vec3 inset = axis * (maxProjection - minProjection) / 16.f;
+    c0 = packRGB565(mean + axis * maxProjection - inset);
+    c1 = packRGB565(mean + axis * minProjection + inset);
+  }
+  glm::uint32 indices;
+  int error = selectColorIndices(block, c0, c1, indices);
+
+  // least squares fit of the endpoints to the chosen indices
+  static const float weights[4] = {1, 0, 2.f / 3, 1.f / 3};
+  float a00 = 0, a01 = 0, a11 = 0;
+  glm::vec3 b0(0), b1(0);
+  for (int k = 0; k < 16; k++) {
+    float w0 = weights[(indices >> (2 * k)) & 3];
+    float w1 = 1 - w0;
+    a00 += w0 * w0;
+    a01 += w0 * w1;
+    a11 += w1 * w1;
+    b0 += w0 * colors[k];
+    b1 += w1 * colors[k];
+  }
+  float determinant = a00 * a11 - a01 * a01;
+  if (std::abs(determinant) > 1e-6f) {
+    glm::uint16 refined0 = packRGB565((a11 * b0 - a01 * b1) / determinant);
+    glm::uint16 refined1 = packRGB565((a00 * b1 - a01 * b0) / determinant);
+    glm::uint32 refinedIndices;
+    int refinedError = selectColorIndices(block, refined0, refined1, refinedIndices);
+    if (refinedError < error) {
+      c0 = refined0;
+      c1 = refined1;
+      indices = refinedIndices;
+    }
+  }
+
+  // the 4 colors mode requires c0 > c1: swapping the endpoints swaps the indices 0 and 1, 2 and 3
+  if (c0 < c1) {
+    std::swap(c0, c1);
+    indices ^= 0x55555555u;
+  } else if (c0 == c1) {
+    indices = 0;
+  }
+  storeLittleEndian(c0, 2, output);
+  storeLittleEndian(c1, 2, output + 2);
+  storeLittleEndian(indices, 4, output + 4);
+}
+
+/// encodes one channel of a block in 8 bytes (8 interpolated values mode)
+void encodeChannelBlock(const Block & block, int channel, char * output)
+{
+  int lowest = 255, highest = 0;
+  for (int k = 0; k < 16; k++) {
+    lowest = std::min<int>(lowest, block[k][channel]);
+    highest = std::max<int>(highest, block[k][channel]);
+  }
+  std::uint64_t indices = 0;
+  if (highest > lowest) {
+    // code 0 is the highest value, code 1 the lowest one, codes 2 to 7 are interpolated from the highest to the lowest
+    int palette[8] = {highest, lowest};
+    for (int code = 2; code < 8; code++) {
+      palette[code] = ((8 - code) * highest + (code - 1) * lowest) / 7;
+    }
+    for (int k = 0; k < 16; k++) {
+      int bestCode = 0;
+      for (int code = 1; code < 8; code++) {
+        if (std::abs(palette[code] - block[k][channel]) < std::abs(palette[bestCode] - block[k][channel])) {
+          bestCode = code;
+        }
+      }
+      indices |= std::uint64_t(bestCode) << (3 * k);
+    }
+  }
+  output[0] = char(highest);
+  output[1] = char(lowest);
+  storeLittleEndian(indices, 6, output + 2);
+}
+
+void decodeColorBlock(const char * input, bool forceFourColors, Block & block)
+{
+  glm::uint16 c0 = loadLittleEndian(input, 2);
+  glm::uint16 c1 = loadLittleEndian(input + 2, 2);
+  glm::uint32 indices = loadLittleEndian(input + 4, 4);
+  glm::ivec4 palette[4];
+  colorPalette(c0, c1, forceFourColors or c0 > c1, palette);
+  for (int k = 0; k < 16; k++) {
+    glm::ivec4 color = palette[(indices >> (2 * k)) & 3];
+    for (int c = 0; c < 4; c++) {
+      block[k][c] = color[c];
+    }
+  }
+}
+
+void decodeChannelBlock(const char * input, int channel, Block & block)
+{
+  int value0 = static_cast<unsigned char>(input[0]);
+  int value1 = static_cast<unsigned char>(input[1]);
+  std::uint64_t indices = loadLittleEndian(input + 2, 6);
+  int palette[8] = {value0, value1};
+  if (value0 > value1) {
+    for (int code = 2; code < 8; code++) {
+      palette[code] = ((8 - code) * value0 + (code - 1) * value1) / 7;
+    }
+  } else {
+    for (int code = 2; code < 6; code++) {
+      palette[code] = ((6 - code) * value0 + (code - 1) * value1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  for (int k = 0; k < 16; k++) {
+    block[k][channel] = palette[(indices >> (3 * k)) & 7];
+  }
+}
+
+/// converts the sRGB encoded values to linear intensities
+const std::array<float, 256> & srgbToLinearTable()
+{
+  static const std::array<float, 256> table = []() {
+    std::array<float, 256> values;
+    for (int k = 0; k < 256; k++) {
+      float value = k / 255.f;
+      values[k] = (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    return values;
+  }();
+  return table;
+}
+
+/// Number of entries of the table converting the linear intensities to sRGB encoded values
+const int linearTableSize = 4096;
+
+/// converts the linear intensities (quantized on linearTableSize values) to sRGB encoded values
+const std::array<unsigned char, linearTableSize> & linearToSRGBTable()
+{
+  static const std::array<unsigned char, linearTableSize> table = []() {
+    std::array<unsigned char, linearTableSize> values;
+    for (int k = 0; k < linearTableSize; k++) {
+      float value = float(k) / (linearTableSize - 1);
+      float encoded = (value <= 0.0031308f) ? 12.92f * value : 1.055f * std::pow(value, 1 / 2.4f) - 0.055f;
+      values[k] = static_cast<unsigned char>(std::lround(255 * encoded));
+    }
+    return values;
+  }();
+  return table;
+}
+
+/// averages the 2x2 footprints of two rows of RGBA texels into a row of the next level
+void downsampleRow(const unsigned char * row0, const unsigned char * row1, int width, MipmapFilter filter, unsigned char * destination)
+{
+  switch (filter) {
+  case MipmapFilter::Linear:
+    // a plain loop over bytes, that compilers vectorize
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 4; c++) {
+        destination[4 * x + c] = static_cast<unsigned char>((row0[8 * x + c] + row0[8 * x + 4 + c] + row1[8 * x + c] + row1[8 * x + 4 + c] + 2) >> 2);
+      }
+    }
+    break;
+  case MipmapFilter::SRGB: {
+    const std::array<float, 256> & toLinear = srgbToLinearTable();
+    const std::array<unsigned char, linearTableSize> & toSRGB = linearToSRGBTable();
+#if defined(__SSE__) or defined(_M_X64)
+    // the 4 channels of a texel at once: the colors are scaled to the indices of toSRGB, alpha stays on 8 bits
+    const __m128 scale = _mm_set_ps(0.25f, (linearTableSize - 1) / 4.f, (linearTableSize - 1) / 4.f, (linearTableSize - 1) / 4.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    auto load = [&toLinear](const unsigned char * texel) { return _mm_set_ps(texel[3], toLinear[texel[2]], toLinear[texel[1]], toLinear[texel[0]]); };
+    for (int x = 0; x < width; x++) {
+      __m128 sum = _mm_add_ps(_mm_add_ps(load(row0 + 8 * x), load(row0 + 8 * x + 4)), _mm_add_ps(load(row1 + 8 * x), load(row1 + 8 * x + 4)));
+      float values[4];
+      _mm_storeu_ps(values, _mm_add_ps(_mm_mul_ps(sum, scale), half));
+      for (int c = 0; c < 3; c++) {
+        destination[4 * x + c] = toSRGB[int(values[c])];
+      }
+      destination[4 * x + 3] = static_cast<unsigned char>(values[3]);
+    }
+#else
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        float sum = toLinear[row0[8 * x + c]] + toLinear[row0[8 * x + 4 + c]] + toLinear[row1[8 * x + c]] + toLinear[row1[8 * x + 4 + c]];
+        destination[4 * x + c] = toSRGB[int(sum * (linearTableSize - 1) / 4 + 0.5f)];
+      }
+      destination[4 * x + 3] = static_cast<unsigned char>((row0[8 * x + 3] + row0[8 * x + 7] + row1[8 * x + 3] + row1[8 * x + 7] + 2) >> 2);
+    }
+#endif
+    break;
+  }
+  case MipmapFilter::NormalMap:
+    for (int x = 0; x < width; x++) {
+      glm::vec3 sum(0);
+      for (const unsigned char * texel : {row0 + 8 * x, row0 + 8 * x + 4, row1 + 8 * x, row1 + 8 * x + 4}) {
+        sum += glm::vec3(texel[0], texel[1], texel[2]) / 127.5f - 1.f;
+      }
+      glm::vec3 normal = (glm::dot(sum, sum) > 1e-12f) ? glm::normalize(sum) : glm::vec3(0, 0, 1);
+      destination[4 * x] = static_cast<unsigned char>(std::lround((normal.x + 1) * 127.5f));
+      destination[4 * x + 1] = static_cast<unsigned char>(std::lround((normal.y + 1) * 127.5f));
+      destination[4 * x + 2] = static_cast<unsigned char>(std::lround((normal.z + 1) * 127.5f));
+      destination[4 * x + 3] = static_cast<unsigned char>((row0[8 * x + 3] + row0[8 * x + 7] + row1[8 * x + 3] + row1[8 * x + 7] + 2) >> 2);
+    }
+    break;
+  }
+}
+
+/// averages the footprint of a texel of the next level (1 to 3 rows of 1 to 3 RGBA texels, starting at the given column)
+void downsampleTexel(const unsigned char * const * rows, int nbRows, int column, int nbColumns, MipmapFilter filter, unsigned char * destination)
+{
+  int count = nbRows * nbColumns;
+  glm::vec3 sum(0);
+  int alphaSum = 0;
+  for (int r = 0; r < nbRows; r++) {
+    for (int x = column; x < column + nbColumns; x++) {
+      const unsigned char * texel = rows[r] + 4 * x;
+      switch (filter) {
+      case MipmapFilter::Linear:
+        sum += glm::vec3(texel[0], texel[1], texel[2]);
+        break;
+      case MipmapFilter::SRGB: {
+        const std::array<float, 256> & toLinear = srgbToLinearTable();
+        sum += glm::vec3(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]]);
+        break;
+      }
+      case MipmapFilter::NormalMap:
+        sum += glm::vec3(texel[0], texel[1], texel[2]) / 127.5f - 1.f;
+        break;
+      }
+      alphaSum += texel[3];
+    }
+  }
+  switch (filter) {
+  case MipmapFilter::Linear:
+    for (int c = 0; c < 3; c++) {
+      destination[c] = static_cast<unsigned char>((int(sum[c]) + count / 2) / count);
+    }
+    break;
+  case MipmapFilter::SRGB: {
+    const std::array<unsigned char, linearTableSize> & toSRGB = linearToSRGBTable();
+    for (int c = 0; c < 3; c++) {
+      destination[c] = toSRGB[int(sum[c] * (linearTableSize - 1) / count + 0.5f)];
+    }
+    break;
+  }
+  case MipmapFilter::NormalMap: {
+    glm::vec3 normal = (glm::dot(sum, sum) > 1e-12f) ? glm::normalize(sum) : glm::vec3(0, 0, 1);
+    for (int c = 0; c < 3; c++) {
+      destination[c] = static_cast<unsigned char>(std::lround((normal[c] + 1) * 127.5f));
+    }
+    break;
+  }
+  }
+  destination[3] = static_cast<unsigned char>((alphaSum + count / 2) / count);
+}
+
+/// Half width of the Kaiser windowed sinc, in texels of the next level
+const float kaiserRadius = 1.5f;
+
+/// Shape of the Kaiser window (larger values reduce the ringing, but blur more)
+const float kaiserAlpha = 4;
+
+/// modified Bessel function of the first kind of order 0 (its power series)
+float besselI0(float x)
+{
+  float sum = 1;
+  float term = 1;
+  for (int k = 1; k < 16; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+/// The texels of a level weighted by a texel of the next level, along an axis
+struct FilterTaps {
+  std::vector<int> indices;   ///< the weighted texels (clamped to the edges)
+  std::vector<float> weights; ///< their weights (summing to 1)
+};
+
+/// computes the taps of the Kaiser windowed sinc reducing @p sourceSize texels to @p size texels
+std::vector<FilterTaps> kaiserTaps(int sourceSize, int size)
+{
+  const float pi = glm::pi<float>();
+  float scale = float(sourceSize) / size;
+  std::vector<FilterTaps> taps(size);
+  for (int x = 0; x < size; x++) {
+    float center = (x + 0.5f) * scale;
+    float sum = 0;
+    for (int i = int(std::floor(center - kaiserRadius * scale)); i <= int(std::ceil(center + kaiserRadius * scale)); i++) {
+      // the distance is measured in texels of the next level, whose frequencies are kept
+      float t = (i + 0.5f - center) / scale;
+      if (std::fabs(t) >= kaiserRadius) {
+        continue;
+      }
+      float sinc = (t == 0) ? 1 : std::sin(pi * t) / (pi * t);
+      float ratio = t / kaiserRadius;
+      float weight = sinc * besselI0(kaiserAlpha * std::sqrt(1 - ratio * ratio)) / besselI0(kaiserAlpha);
+      taps[x].indices.push_back(std::clamp(i, 0, sourceSize - 1));
+      taps[x].weights.push_back(weight);
+      sum += weight;
+    }
+    for (float & weight : taps[x].weights) {
+      weight /= sum;
+    }
+  }
+  return taps;
+}
+
+/// converts a RGBA texel to the values averaged by a filter (see MipmapFilter)
+void decodeTexel(const unsigned char * texel, MipmapFilter filter, float * values)
+{
+  for (int c = 0; c < 3; c++) {
+    switch (filter) {
+    case MipmapFilter::Linear:
+      values[c] = texel[c] / 255.f;
+      break;
+    case MipmapFilter::SRGB:
+      values[c] = srgbToLinearTable()[texel[c]];
+      break;
+    case MipmapFilter::NormalMap:
+      values[c] = texel[c] / 127.5f - 1.f;
+      break;
+    }
+  }
+  values[3] = texel[3] / 255.f;
+}
+
+/// converts the values averaged by a filter back to a RGBA texel (the negative lobes of the kernel may overshoot: the values are clamped)
+void encodeTexel(const float * values, MipmapFilter filter, unsigned char * texel)
+{
+  switch (filter) {
+  case MipmapFilter::Linear:
+    for (int c = 0; c < 3; c++) {
+      texel[c] = static_cast<unsigned char>(std::lround(255 * std::clamp(values[c], 0.f, 1.f)));
+    }
+    break;
+  case MipmapFilter::SRGB: {
+    const std::array<unsigned char, linearTableSize> & toSRGB = linearToSRGBTable();
+    for (int c = 0; c < 3; c++) {
+      texel[c] = toSRGB[int(std::clamp(values[c], 0.f, 1.f) * (linearTableSize - 1) + 0.5f)];
+    }
+    break;
+  }
+  case MipmapFilter::NormalMap: {
+    glm::vec3 sum(values[0], values[1], values[2]);
+    glm::vec3 normal = (glm::dot(sum, sum) > 1e-12f) ? glm::normalize(sum) : glm::vec3(0, 0, 1);
+    for (int c = 0; c < 3; c++) {
+      texel[c] = static_cast<unsigned char>(std::lround((normal[c] + 1) * 127.5f));
+    }
+    break;
+  }
+  }
+  texel[3] = static_cast<unsigned char>(std::lround(255 * std::clamp(values[3], 0.f, 1.f)));
+}
+
+/// sums the weighted texels of a filter (4 floats each, @p stride floats apart)
+void accumulateTaps(const float * texels, size_t stride, const FilterTaps & taps, float * destination)
+{
+#if defined(__SSE__) or defined(_M_X64)
+  __m128 sum = _mm_setzero_ps();
+  for (size_t k = 0; k < taps.indices.size(); k++) {
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[k]), _mm_loadu_ps(texels + taps.indices[k] * stride)));
+  }
+  _mm_storeu_ps(destination, sum);
+#else
+  float sum[4] = {0, 0, 0, 0};
+  for (size_t k = 0; k < taps.indices.size(); k++) {
+    const float * texel = texels + taps.indices[k] * stride;
+    for (int c = 0; c < 4; c++) {
+      sum[c] += taps.weights[k] * texel[c];
+    }
+  }
+  std::copy(sum, sum + 4, destination);
+#endif
+}
+
+/// computes a level from the previous one with the Kaiser windowed sinc (the rows are reduced first, then the columns)
+void kaiserLevel(const unsigned char * source, int sourceWidth, int sourceHeight, int width, int height, MipmapFilter filter, unsigned char * destination, unsigned int nbThreads)
+{
+  std::vector<FilterTaps> columnTaps = kaiserTaps(sourceWidth, width);
+  std::vector<FilterTaps> rowTaps = kaiserTaps(sourceHeight, height);
+  std::vector<float> reducedRows(size_t(width) * sourceHeight * 4);
+  parallelFor(
+      sourceHeight,
+      [&](size_t y) {
+        std::vector<float> row(size_t(sourceWidth) * 4);
+        for (int x = 0; x < sourceWidth; x++) {
+          decodeTexel(source + (y * sourceWidth + x) * 4, filter, row.data() + 4 * x);
+        }
+        for (int x = 0; x < width; x++) {
+          accumulateTaps(row.data(), 4, columnTaps[x], reducedRows.data() + (y * width + x) * 4);
+        }
+      },
+      nbThreads);
+  parallelFor(
+      height,
+      [&](size_t y) {
+        float values[4];
+        for (int x = 0; x < width; x++) {
+          accumulateTaps(reducedRows.data() + 4 * x, size_t(width) * 4, rowTaps[y], values);
+          encodeTexel(values, filter, destination + (y * width + x) * 4);
+        }
+      },
+      nbThreads);
+}
+
+size_t blockBytes(TextureFormat format)
+{
+  return (format == TextureFormat::BC1) ? 8 : 16;
+}
+} // namespace
+
+size_t textureLevelSize(TextureFormat format, int width, int height)
+{
+  if (format == TextureFormat::RGBA8) {
+    return size_t(width) * height * 4;
+  }
+  return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+TextureFormat chooseTextureFormat(const Image<> & image, bool normalMap)
+{
+  if (normalMap) {
+    return TextureFormat::BC5;
+  }
+  if (image.channels == 2 or image.channels == 4) {
+    size_t nbTexels = size_t(image.width) * image.height * image.depth;
+    for (size_t k = 0; k < nbTexels; k++) {
+      if (image.data[k * image.channels + image.channels - 1] != 255) {
+        return TextureFormat::BC3;
+      }
+    }
+  }
+  return TextureFormat::BC1;
+}
+
+std::vector<char> compressTexture(const Image<> & image, TextureFormat format, unsigned int nbThreads)
+{
+  std::vector<char> output(textureLevelSize(format, image.width, image.height));
+  if (format == TextureFormat::RGBA8) {
+    for (int y = 0; y < image.height; y++) {
+      for (int x = 0; x < image.width; x++) {
+        fetchTexel(image, x, y, reinterpret_cast<unsigned char *>(output.data()) + 4 * (size_t(y) * image.width + x));
+      }
+    }
+    return output;
+  }
+  int blocksPerRow = (image.width + 3) / 4;
+  int blocksPerColumn = (image.height + 3) / 4;
+  size_t bytesPerBlock = blockBytes(format);
+  parallelFor(
+      blocksPerColumn,
+      [&](size_t blockY) {
+        Block block;
+        for (int blockX = 0; blockX < blocksPerRow; blockX++) {
+          char * destination = output.data() + (blockY * blocksPerRow + blockX) * bytesPerBlock;
+          fetchBlock(image, blockX, blockY, block);
+          switch (format) {
+          case TextureFormat::BC1:
+            encodeColorBlock(block, destination);
+            break;
+          case TextureFormat::BC3:
+            encodeChannelBlock(block, 3, destination);
+            encodeColorBlock(block, destination + 8);
+            break;
+          default:
+            encodeChannelBlock(block, 0, destination);
+            encodeChannelBlock(block, 1, destination + 8);
+          }
+        }
+      },
+      nbThreads);
+  return output;
+}
+
+std::vector<std::vector<unsigned char>> generateMipmaps(const Image<> & image, MipmapFilter filter, unsigned int nbThreads, MipmapKernel kernel)
+{
+  std::vector<std::vector<unsigned char>> levels;
+  std::vector<char> level0 = compressTexture(image, TextureFormat::RGBA8, nbThreads);
+  const unsigned char * source = reinterpret_cast<const unsigned char *>(level0.data());
+  int sourceWidth = image.width;
+  int sourceHeight = image.height;
+  while (sourceWidth > 1 or sourceHeight > 1) {
+    int width = std::max(1, sourceWidth / 2);
+    int height = std::max(1, sourceHeight / 2);
+    std::vector<unsigned char> level(size_t(width) * height * 4);
+    if (kernel == MipmapKernel::Kaiser) {
+      kaiserLevel(source, sourceWidth, sourceHeight, width, height, filter, level.data(), nbThreads);
+    } else {
+      // the last row and column of a source of odd size are folded into the last texels (3 taps instead of 2)
+      int nbColumns = std::min(2, sourceWidth);
+      int nbEvenTexels = (sourceWidth % 2 and sourceWidth > 1) ? width - 1 : width;
+      parallelFor(
+          height,
+          [&](size_t y) {
+            const unsigned char * rows[3];
+            int nbRows = std::min(2, sourceHeight);
+            if (sourceHeight % 2 and sourceHeight > 1 and int(y) == height - 1) {
+              nbRows = 3;
+            }
+            for (int r = 0; r < nbRows; r++) {
+              rows[r] = source + (2 * y + r) * sourceWidth * 4;
+            }
+            unsigned char * destination = level.data() + y * width * 4;
+            if (nbRows == 2 and nbColumns == 2) {
+              downsampleRow(rows[0], rows[1], nbEvenTexels, filter, destination);
+            } else {
+              for (int x = 0; x < nbEvenTexels; x++) {
+                downsampleTexel(rows, nbRows, 2 * x, nbColumns, filter, destination + 4 * x);
+              }
+            }
+            if (nbEvenTexels < width) {
+              downsampleTexel(rows, nbRows, sourceWidth - 3, 3, filter, destination + 4 * (width - 1));
+            }
+          },
+          nbThreads);
+    }
+    levels.push_back(std::move(level));
+    source = levels.back().data();
+    sourceWidth = width;
+    sourceHeight = height;
+  }
+  return levels;
+}
+
+std::vector<unsigned char> decompressTexture(std::span<const char> data, TextureFormat format, int width, int height)
+{
+  std::vector<unsigned char> rgba(size_t(width) * height * 4);
+  if (format == TextureFormat::RGBA8) {
+    std::copy(data.begin(), data.begin() + rgba.size(), rgba.begin());
+    return rgba;
+  }
+  int blocksPerRow = (width + 3) / 4;
+  size_t bytesPerBlock = blockBytes(format);
+  for (int blockY = 0; blockY < (height + 3) / 4; blockY++) {
+    for (int blockX = 0; blockX < blocksPerRow; blockX++) {
+      const char * source = data.data() + (size_t(blockY) * blocksPerRow + blockX) * bytesPerBlock;
+      Block block;
+      switch (format) {
+      case TextureFormat::BC1:
+        decodeColorBlock(source, false, block);
+        break;
+      case TextureFormat::BC3:
+        decodeColorBlock(source + 8, true, block);
+        decodeChannelBlock(source, 3, block);
+        break;
+      default:
+        decodeChannelBlock(source, 0, block);
+        decodeChannelBlock(source + 8, 1, block);
+        for (int k = 0; k < 16; k++) {
+          block[k][2] = 0;
+          block[k][3] = 255;
+        }
+      }
+      for (int y = 0; y < 4 and 4 * blockY + y < height; y++) {
+        for (int x = 0; x < 4 and 4 * blockX + x < width; x++) {
+          std::copy(block[4 * y + x], block[4 * y + x] + 4, rgba.data() + 4 * ((size_t(4 * blockY + y)) * width + 4 * blockX + x));
+        }
+      }
+    }
+  }
+  return rgba;
+}
+
+double peakSignalToNoiseRatio(const Image<> & reference, std::span<const unsigned char> rgba, int nbChannels)
+{
+  double squaredError = 0;
+  for (int y = 0; y < reference.height; y++) {
+    for (int x = 0; x < reference.width; x++) {
+      unsigned char texel[4];
+      fetchTexel(reference, x, y, texel);
+      for (int c = 0; c < nbChannels; c++) {
+        double difference = double(texel[c]) - rgba[4 * (size_t(y) * reference.width + x) + c];
+        squaredError += difference * difference;
+      }
+    }
+  }
+  if (squaredError == 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double meanSquaredError = squaredError / (double(reference.width) * reference.height * nbChannels);
+  return 10 * std::log10(255. * 255. / meanSquaredError);
+}
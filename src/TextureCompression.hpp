@@ -0,0 +1,128 @@
+/** @file */
+#ifndef __GLITTER_TEXTURE_COMPRESSION_H__
+#define __GLITTER_TEXTURE_COMPRESSION_H__
+
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+#include "Image.hpp"
+
+/**
+ * @brief Formats of the textures prepared offline
+ *
+ * The block compressed formats store 4x4 texel blocks, row by row (images whose
+ * size is not a multiple of 4 are padded by replicating their last row and column).
+ */
+enum class TextureFormat : glm::uint32
+{
+  RGBA8 = 0, ///< uncompressed, 4 bytes per texel
+  BC1,       ///< opaque color, 8 bytes per block (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+  BC3,       ///< color with alpha, 16 bytes per block (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+  BC5,       ///< two channels (e.g. the x and y coordinates of a normal map), 16 bytes per block (GL_COMPRESSED_RG_RGTC2)
+};
+
+/**
+ * @brief How the texels of an image are averaged by ::generateMipmaps
+ */
+enum class MipmapFilter
+{
+  Linear,    ///< the channels are averaged as is (e.g. specular maps)
+  SRGB,      ///< the colors are averaged in linear space then encoded back in sRGB (color maps), alpha is averaged as is
+  NormalMap, ///< the directions encoded in the colors are averaged and normalized
+};
+
+/**
+ * @brief How ::generateMipmaps weights the texels of a level to compute the next one
+ */
+enum class MipmapKernel
+{
+  Box,    ///< averages 2x2 footprints (fast, but blurry and prone to aliasing)
+  Kaiser, ///< Kaiser windowed sinc over 6x6 footprints (sharper and less aliased, slightly ringing)
+};
+
+/**
+ * @brief A level of a BakedTexture
+ */
+struct BakedTextureLevel {
+  int width;                  ///< width of the level in texels
+  int height;                 ///< height of the level in texels
+  std::span<const char> data; ///< the texels or blocks of the level
+};
+
+/**
+ * @brief A 2D texture prepared offline, uploaded as is (see Texture::setData(const BakedTexture &) const)
+ *
+ * The levels point to memory owned elsewhere (e.g. by ObjLoader).
+ */
+struct BakedTexture {
+  TextureFormat format;                  ///< format of all the levels
+  std::vector<BakedTextureLevel> levels; ///< the levels, from the largest one
+};
+
+/**
+ * @brief computes the size of an image in a given format
+ * @param format the format
+ * @param width the width of the image
+ * @param height the height of the image
+ * @return the size in bytes
+ */
+size_t textureLevelSize(TextureFormat format, int width, int height);
+
+/**
+ * @brief chooses the block compression format of an image
+ * @param image the image (1 to 4 channels)
+ * @param normalMap whether the image is a normal map
+ * @return TextureFormat::BC5 for normal maps, TextureFormat::BC3 if some texels are not opaque, TextureFormat::BC1 otherwise
+ */
+TextureFormat chooseTextureFormat(const Image<> & image, bool normalMap);
+
+/**
+ * @brief converts an image to a format
+ * @param image the image (1 to 4 channels: gray, gray and alpha, RGB or RGBA)
+ * @param format the format
+ * @param nbThreads the number of threads encoding the rows of blocks (0 means ::defaultThreadCount)
+ * @return the converted image (textureLevelSize() bytes)
+ *
+ * The color endpoints of every BC1 block are fitted along the principal axis of its
+ * colors, then refined once by least squares. The alpha channel (BC3) and the two
+ * channels of BC5 use the range of their values and 8 interpolated levels.
+ */
+std::vector<char> compressTexture(const Image<> & image, TextureFormat format, unsigned int nbThreads = 0);
+
+/**
+ * @brief computes the mipmap chain of an image
+ * @param image the level 0 (1 to 4 channels: gray, gray and alpha, RGB or RGBA)
+ * @param filter how the texels are averaged
+ * @param nbThreads the number of threads filtering the rows of a level (0 means ::defaultThreadCount)
+ * @param kernel how the texels are weighted
+ * @return the RGBA texels of the levels 1 to n (down to 1x1)
+ *
+ * Every level is half the size of the previous one (rounded down, at least 1 texel), which is
+ * the size expected by OpenGL. With MipmapKernel::Box, each texel averages a 2x2 footprint, except
+ * the last row and column of a level of odd size, that average 3 rows or columns so that no texel of
+ * the previous level is dropped. With MipmapKernel::Kaiser, the filter is separable and its taps
+ * follow the exact ratio between the sizes of the levels (the texels beyond the edges are clamped).
+ * Each level is computed from the previous one (quantized to 8 bits).
+ */
+std::vector<std::vector<unsigned char>> generateMipmaps(const Image<> & image, MipmapFilter filter, unsigned int nbThreads = 0, MipmapKernel kernel = MipmapKernel::Box);
+
+/**
+ * @brief decodes an image converted by ::compressTexture
+ * @param data the converted image
+ * @param format its format
+ * @param width the width of the image
+ * @param height the height of the image
+ * @return the RGBA texels (blue is 0 and alpha is 255 for TextureFormat::BC5)
+ */
+std::vector<unsigned char> decompressTexture(std::span<const char> data, TextureFormat format, int width, int height);
+
+/**
+ * @brief measures the peak signal to noise ratio of a decoded image
+ * @param reference the original image
+ * @param rgba the decoded RGBA texels
+ * @param nbChannels the number of channels compared (e.g. 3 for BC1, 2 for BC5)
+ * @return the PSNR in dB (infinite if both images are equal)
+ */
+double peakSignalToNoiseRatio(const Image<> & reference, std::span<const unsigned char> rgba, int nbChannels);
+
+#endif // !defined(__GLITTER_TEXTURE_COMPRESSION_H__)
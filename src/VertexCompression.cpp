@@ -0,0 +1,135 @@
+#include "VertexCompression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+glm::uint32 floatBits(float value)
+{
+  glm::uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float bitsFloat(glm::uint32 bits)
+{
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/// sign of a value (zero is considered positive)
+float signNotZero(float value)
+{
+  return (value >= 0) ? 1.f : -1.f;
+}
+
+glm::int16 encodeSnorm16(float value)
+{
+  return glm::int16(std::round(std::clamp(value, -1.f, 1.f) * 32767.f));
+}
+
+float decodeSnorm16(glm::int16 value)
+{
+  return std::max(value / 32767.f, -1.f);
+}
+
+glm::uint8 quantizeUnorm8(float value)
+{
+  return glm::uint8(std::round(std::clamp(value, 0.f, 1.f) * 255.f));
+}
+} // namespace
+
+glm::uint16 floatToHalf(float value)
+{
+  glm::uint32 bits = floatBits(value);
+  glm::uint32 sign = bits & 0x80000000u;
+  bits ^= sign;
+  glm::uint16 half;
+  if (bits >= 0x47800000u) {
+    // too large for a half float (>= 65536), infinity or NaN
+    half = (bits > 0x7F800000u) ? 0x7E00 : 0x7C00;
+  } else if (bits < 0x38800000u) {
+    // subnormal half float: the addition of 0.5 aligns the mantissa and rounds it
+    half = floatBits(bitsFloat(bits) + 0.5f) - 0x3F000000u;
+  } else {
+    // normal half float: rebias the exponent and round the mantissa to nearest even
+    glm::uint32 oddMantissa = (bits >> 13) & 1;
+    bits += 0xC8000FFFu + oddMantissa;
+    half = bits >> 13;
+  }
+  return half | (sign >> 16);
+}
+
+float halfToFloat(glm::uint16 half)
+{
+  const glm::uint32 shiftedExponent = 0x7C00u << 13;
+  glm::uint32 bits = (half & 0x7FFFu) << 13;
+  glm::uint32 exponent = bits & shiftedExponent;
+  bits += (127 - 15) << 23;
+  if (exponent == shiftedExponent) {
+    // infinity or NaN
+    bits += (128 - 16) << 23;
+  } else if (exponent == 0) {
+    // subnormal half float: renormalized by the float unit
+    bits = floatBits(bitsFloat(bits + (1 << 23)) - bitsFloat(113 << 23));
+  }
+  return bitsFloat(bits | (glm::uint32(half & 0x8000u) << 16));
+}
+
+PackedSnorm16x2 encodeOctahedral(const glm::vec3 & direction)
+{
+  float norm1 = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+  float x = 0, y = 0;
+  if (norm1 > 0) {
+    x = direction.x / norm1;
+    y = direction.y / norm1;
+    if (direction.z < 0) {
+      float foldedX = (1 - std::fabs(y)) * signNotZero(x);
+      float foldedY = (1 - std::fabs(x)) * signNotZero(y);
+      x = foldedX;
+      y = foldedY;
+    }
+  }
+  return PackedSnorm16x2{encodeSnorm16(x), encodeSnorm16(y)};
+}
+
+glm::vec3 decodeOctahedral(const PackedSnorm16x2 & encoded)
+{
+  float x = decodeSnorm16(encoded.x);
+  float y = decodeSnorm16(encoded.y);
+  float z = 1 - std::fabs(x) - std::fabs(y);
+  if (z < 0) {
+    float unfoldedX = (1 - std::fabs(y)) * signNotZero(x);
+    float unfoldedY = (1 - std::fabs(x)) * signNotZero(y);
+    x = unfoldedX;
+    y = unfoldedY;
+  }
+  return glm::normalize(glm::vec3(x, y, z));
+}
+
+PackedUnorm8x4 encodeUnorm8(const glm::vec4 & color)
+{
+  return PackedUnorm8x4{quantizeUnorm8(color.x), quantizeUnorm8(color.y), quantizeUnorm8(color.z), quantizeUnorm8(color.w)};
+}
+
+glm::vec4 decodeUnorm8(const PackedUnorm8x4 & encoded)
+{
+  return glm::vec4(encoded.x, encoded.y, encoded.z, encoded.w) / 255.f;
+}
+
+PackedHalf4 encodeHalf4(const glm::vec3 & value, float w)
+{
+  return PackedHalf4{floatToHalf(value.x), floatToHalf(value.y), floatToHalf(value.z), floatToHalf(w)};
+}
+
+PackedHalf4 encodeHalf4(const glm::vec4 & value)
+{
+  return PackedHalf4{floatToHalf(value.x), floatToHalf(value.y), floatToHalf(value.z), floatToHalf(value.w)};
+}
+
+PackedHalf2 encodeHalf2(const glm::vec2 & value)
+{
+  return PackedHalf2{floatToHalf(value.x), floatToHalf(value.y)};
+}
@@ -0,0 +1,85 @@
+/** @file */
+#ifndef __GLITTER_VERTEX_COMPRESSION_H__
+#define __GLITTER_VERTEX_COMPRESSION_H__
+
+#include <glm/glm.hpp>
+#include "AttributeProperties.hpp"
+
+/**
+ * @brief converts a float to a half float (round to nearest even)
+ * @param value the float
+ * @return the bits of the half float (overflows become infinities)
+ */
+glm::uint16 floatToHalf(float value);
+
+/**
+ * @brief converts a half float to a float (exact)
+ * @param bits the bits of the half float
+ * @return the float
+ */
+float halfToFloat(glm::uint16 bits);
+
+/**
+ * @brief encodes a unit vector with the octahedral mapping on two 16 bits signed integers
+ * @param direction the unit vector
+ * @return the encoded vector
+ *
+ * The unit sphere is projected on the octahedron |x| + |y| + |z| = 1, whose lower half is
+ * then unfolded on the square [-1, 1]^2. The vertex shader decodes it with:
+ * @code
+ * vec3 decodeOctahedral(vec2 p)
+ * {
+ *   vec3 v = vec3(p, 1 - abs(p.x) - abs(p.y));
+ *   if (v.z < 0) {
+ *     v.xy = (1 - abs(v.yx)) * vec2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+ *   }
+ *   return normalize(v);
+ * }
+ * @endcode
+ */
+PackedSnorm16x2 encodeOctahedral(const glm::vec3 & direction);
+
+/**
+ * @brief decodes a unit vector encoded by ::encodeOctahedral
+ * @param encoded the encoded vector
+ * @return the unit vector
+ */
+glm::vec3 decodeOctahedral(const PackedSnorm16x2 & encoded);
+
+/**
+ * @brief encodes a color on four bytes
+ * @param color the color (components are clamped to [0, 1])
+ * @return the encoded color
+ */
+PackedUnorm8x4 encodeUnorm8(const glm::vec4 & color);
+
+/**
+ * @brief decodes a color encoded by ::encodeUnorm8
+ * @param encoded the encoded color
+ * @return the color
+ */
+glm::vec4 decodeUnorm8(const PackedUnorm8x4 & encoded);
+
+/**
+ * @brief encodes a vector on half floats (missing components are set to @p w)
+ * @param value the vector
+ * @param w the fourth component
+ * @return the encoded vector
+ */
+PackedHalf4 encodeHalf4(const glm::vec3 & value, float w = 1);
+
+/**
+ * @brief encodes a vector on half floats
+ * @param value the vector
+ * @return the encoded vector
+ */
+PackedHalf4 encodeHalf4(const glm::vec4 & value);
+
+/**
+ * @brief encodes a vector on half floats
+ * @param value the vector
+ * @return the encoded vector
+ */
+PackedHalf2 encodeHalf2(const glm::vec2 & value);
+
+#endif // !defined(__GLITTER_VERTEX_COMPRESSION_H__)
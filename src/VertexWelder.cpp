@@ -0,0 +1,127 @@
+#include "VertexWelder.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "Parallel.hpp"
+
+namespace
+{
+/// Number of vertices quantized by each parallel task
+const size_t blockSize = 1 << 16;
+
+/// Marks an empty slot of the hash table
+const unsigned int emptySlot = ~0u;
+
+/// Keys of the attributes of a vertex: position (3), normal (3), tangent (3), color (4), uv (2)
+struct QuantizedVertex {
+  std::int32_t values[15];
+
+  bool operator==(const QuantizedVertex & other) const { return !memcmp(values, other.values, sizeof(values)); }
+};
+
+/// the largest float below 2^31, so that the clamped cells fit in 32 bits
+const float maxCell = 2147483520.f;
+
+/// the key of a value: its bits if @p invStep is 0 (exact matching), its grid cell otherwise
+std::int32_t quantize(float value, float invStep)
+{
+  if (invStep == 0) {
+    return (value == 0) ? 0 : std::bit_cast<std::int32_t>(value);
+  }
+  float cell = std::floor(value * invStep + 0.5f);
+  if (std::isnan(cell)) {
+    return std::numeric_limits<std::int32_t>::min();
+  }
+  // large and infinite values are clamped, so that the conversion is defined
+  return static_cast<std::int32_t>(std::clamp(cell, -maxCell, maxCell));
+}
+
+/// the inverse of a grid step (0 for exact matching)
+float inverseStep(float step)
+{
+  return (step > 0) ? 1 / step : 0;
+}
+
+/// 64-bit hash of the quantized values (multiply-xorshift mixing of pairs of values)
+std::uint64_t hashVertex(const QuantizedVertex & vertex)
+{
+  std::uint64_t hash = 0x9e3779b97f4a7c15ull;
+  for (size_t k = 0; k < 15; k += 2) {
+    std::uint64_t word = static_cast<std::uint32_t>(vertex.values[k]);
+    if (k + 1 < 15) {
+      word |= std::uint64_t(static_cast<std::uint32_t>(vertex.values[k + 1])) << 32;
+    }
+    hash ^= word * 0xff51afd7ed558ccdull;
+    hash = (hash << 29 | hash >> 35) * 0xc4ceb9fe1a85ec53ull;
+  }
+  return hash ^ (hash >> 32);
+}
+} // namespace
+
+VertexWelder::VertexWelder(float positionTolerance, float normalTolerance, float uvTolerance, float colorTolerance, unsigned int nbThreads)
+    : m_invPositionTolerance(inverseStep(positionTolerance)), m_invNormalTolerance(inverseStep(normalTolerance)), m_invUVTolerance(inverseStep(uvTolerance)),
+      m_invColorTolerance(inverseStep(colorTolerance)), m_nbThreads(nbThreads)
+{
+}
+
+std::vector<unsigned int> VertexWelder::weld(std::span<const glm::vec3> positions, std::span<const glm::vec3> normals, std::span<const glm::vec3> tangents, std::span<const glm::vec4> colors,
+                                             std::span<const glm::vec2> uvs, std::vector<unsigned int> & uniqueVertices) const
+{
+  size_t nbVertices = positions.size();
+
+  // Keys and hashes are independent for every vertex
+  std::vector<QuantizedVertex> keys(nbVertices);
+  std::vector<std::uint64_t> hashes(nbVertices);
+  parallelFor(
+      (nbVertices + blockSize - 1) / blockSize,
+      [&](size_t block) {
+        size_t end = std::min(nbVertices, (block + 1) * blockSize);
+        for (size_t k = block * blockSize; k < end; k++) {
+          std::int32_t * values = keys[k].values;
+          for (int c = 0; c < 3; c++) {
+            values[c] = quantize(positions[k][c], m_invPositionTolerance);
+            values[3 + c] = quantize(normals[k][c], m_invNormalTolerance);
+            values[6 + c] = quantize(tangents[k][c], m_invNormalTolerance);
+          }
+          for (int c = 0; c < 4; c++) {
+            values[9 + c] = quantize(colors[k][c], m_invColorTolerance);
+          }
+          values[13] = quantize(uvs[k][0], m_invUVTolerance);
+          values[14] = quantize(uvs[k][1], m_invUVTolerance);
+          hashes[k] = hashVertex(keys[k]);
+        }
+      },
+      m_nbThreads);
+
+  // Deduplication in input order, with a power of two table at most half full
+  size_t capacity = 16;
+  while (capacity < 2 * nbVertices) {
+    capacity *= 2;
+  }
+  const size_t mask = capacity - 1;
+  std::vector<unsigned int> table(capacity, emptySlot);
+  std::vector<unsigned int> newIndices(nbVertices);
+  uniqueVertices.clear();
+  for (size_t k = 0; k < nbVertices; k++) {
+    size_t slot = hashes[k] & mask;
+    while (true) {
+      unsigned int unique = table[slot];
+      if (unique == emptySlot) {
+        table[slot] = uniqueVertices.size();
+        newIndices[k] = uniqueVertices.size();
+        uniqueVertices.push_back(k);
+        break;
+      }
+      unsigned int representative = uniqueVertices[unique];
+      if (hashes[representative] == hashes[k] and keys[representative] == keys[k]) {
+        newIndices[k] = unique;
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+  return newIndices;
+}
@@ -0,0 +1,54 @@
+#ifndef __GLITTER_VERTEX_WELDER_H__
+#define __GLITTER_VERTEX_WELDER_H__
+
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Merges the vertices whose attributes are identical (or identical up to a tolerance)
+ *
+ * By default, the tolerances are 0: the keys of the vertices are the bits of their
+ * attributes, so that only exact duplicates are merged (+0 and -0 being the same value).
+ * Otherwise, every attribute is quantized on a regular grid whose step is its tolerance,
+ * so that two vertices are merged if and only if all their attributes fall in the same
+ * grid cells (close values lying on both sides of a cell boundary are thus not merged).
+ * The keys of the vertices are then deduplicated with an
+ * open-addressing hash table (linear probing), which makes the result
+ * deterministic: the first occurrence of a vertex is its representative, and
+ * the representatives keep their input order.
+ */
+class VertexWelder {
+public:
+  /**
+   * @brief Constructor
+   * @param positionTolerance grid step for positions (0 for exact matching)
+   * @param normalTolerance grid step for normals and tangents (0 for exact matching)
+   * @param uvTolerance grid step for uvs (0 for exact matching)
+   * @param colorTolerance grid step for colors (0 for exact matching)
+   * @param nbThreads number of threads used for quantization (0 means one per hardware thread)
+   */
+  VertexWelder(float positionTolerance = 0, float normalTolerance = 0, float uvTolerance = 0, float colorTolerance = 0, unsigned int nbThreads = 0);
+
+  /**
+   * @brief welds a list of vertices
+   * @param positions vertex positions
+   * @param normals vertex normals
+   * @param tangents vertex tangents
+   * @param colors vertex colors
+   * @param uvs vertex uvs
+   * @param uniqueVertices filled with the input index of every representative (in order)
+   * @return for every input vertex, the index of its representative in @p uniqueVertices
+   */
+  std::vector<unsigned int> weld(std::span<const glm::vec3> positions, std::span<const glm::vec3> normals, std::span<const glm::vec3> tangents, std::span<const glm::vec4> colors,
+                                 std::span<const glm::vec2> uvs, std::vector<unsigned int> & uniqueVertices) const;
+
+private:
+  float m_invPositionTolerance; ///< inverse of the grid step for positions (0 for exact matching)
+  float m_invNormalTolerance;   ///< inverse of the grid step for normals and tangents (0 for exact matching)
+  float m_invUVTolerance;       ///< inverse of the grid step for uvs (0 for exact matching)
+  float m_invColorTolerance;    ///< inverse of the grid step for colors (0 for exact matching)
+  unsigned int m_nbThreads;     ///< number of threads used for quantization
+};
+
+#endif // !defined(__GLITTER_VERTEX_WELDER_H__)
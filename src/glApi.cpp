@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -6,6 +10,279 @@
 #include "glApi.hpp"
 #include "utils.hpp"
 
+namespace
+{
+/// the OpenGL internal format of a block compressed TextureFormat
+GLenum compressedInternalFormat(TextureFormat format)
+{
+  switch (format) {
+  case TextureFormat::BC1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case TextureFormat::BC3:
+    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  default:
+    return GL_COMPRESSED_RG_RGTC2;
+  }
+}
+
+/// the buffer targets shadowed by GLState, and their binding queries
+const GLenum bufferTargets[][2] = {
+    {GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING},
+    {GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING},
+    {GL_DRAW_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER_BINDING},
+    {GL_SHADER_STORAGE_BUFFER, GL_SHADER_STORAGE_BUFFER_BINDING},
+};
+
+/// the texture targets shadowed by GLState, and their binding queries
+const GLenum textureTargets[][2] = {
+    {GL_TEXTURE_2D, GL_TEXTURE_BINDING_2D},
+    {GL_TEXTURE_3D, GL_TEXTURE_BINDING_3D},
+    {GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BINDING_2D_ARRAY},
+    {GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BINDING_CUBE_MAP},
+};
+} // namespace
+
+GLState::GLState()
+{
+  const char * validation = std::getenv("GLITTER_VALIDATE_GL_STATE");
+  if (validation and *validation and strcmp(validation, "0") != 0) {
+    setValidation(true);
+  }
+}
+
+GLState & GLState::shared()
+{
+  static GLState state;
+  return state;
+}
+
+void GLState::useProgram(uint program)
+{
+  if (update(m_program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void GLState::bindVertexArray(uint vao)
+{
+  if (update(m_vertexArray, vao)) {
+    glBindVertexArray(vao);
+  }
+}
+
+void GLState::bindBuffer(GLenum target, uint buffer)
+{
+  uint index = bufferIndex(target);
+  if (index < nbBufferTargets) {
+    if (update(m_buffers[index], buffer)) {
+      glBindBuffer(target, buffer);
+    }
+    return;
+  }
+  if (m_validation) {
+    validate();
+  }
+  // the element array buffer is recorded by the VAO really bound: a lazily unbound VAO must be unbound first
+  if (target == GL_ELEMENT_ARRAY_BUFFER and m_vertexArray.actual != m_vertexArray.logical) {
+    glBindVertexArray(m_vertexArray.logical);
+    m_vertexArray.actual = m_vertexArray.logical;
+    m_frame.calls++;
+  }
+  glBindBuffer(target, buffer);
+  m_frame.calls++;
+}
+
+void GLState::activeTexture(uint unit)
+{
+  if (m_validation) {
+    validate();
+  }
+  if (m_activeUnit == unit) {
+    m_frame.avoided++;
+    return;
+  }
+  glActiveTexture(GL_TEXTURE0 + unit);
+  m_activeUnit = unit;
+  m_frame.calls++;
+}
+
+void GLState::bindTexture(GLenum target, uint texture)
+{
+  uint index = textureIndex(target);
+  if (m_activeUnit < nbUnits and index < nbTextureTargets) {
+    if (update(m_textures[m_activeUnit][index], texture)) {
+      glBindTexture(target, texture);
+    }
+    return;
+  }
+  glBindTexture(target, texture);
+  m_frame.calls++;
+}
+
+void GLState::bindSampler(uint unit, uint sampler)
+{
+  if (unit < nbUnits and sampler == 0) {
+    // a sampler left bound would override the parameters of the textures of the unit
+    if (m_validation) {
+      validate();
+    }
+    Binding & binding = m_samplers[unit];
+    binding.logical = 0;
+    if (binding.actual == 0) {
+      m_frame.avoided++;
+      return;
+    }
+    glBindSampler(unit, 0);
+    binding.actual = 0;
+    m_frame.calls++;
+    return;
+  }
+  if (unit < nbUnits) {
+    if (update(m_samplers[unit], sampler)) {
+      glBindSampler(unit, sampler);
+    }
+    return;
+  }
+  glBindSampler(unit, sampler);
+  m_frame.calls++;
+}
+
+uint GLState::program() const
+{
+  return m_program.logical;
+}
+
+void GLState::invalidate()
+{
+  // the real state is known in validation mode, so that the bindings made without the shadow are reported
+  if (m_validation) {
+    synchronize();
+    return;
+  }
+  m_program.actual = unknown;
+  m_vertexArray.actual = unknown;
+  for (Binding & buffer : m_buffers) {
+    buffer.actual = unknown;
+  }
+  m_activeUnit = unknown;
+  for (auto & unit : m_textures) {
+    for (Binding & texture : unit) {
+      texture.actual = unknown;
+    }
+  }
+  for (Binding & sampler : m_samplers) {
+    sampler.actual = unknown;
+  }
+}
+
+void GLState::setValidation(bool enabled)
+{
+  m_validation = enabled;
+  if (enabled) {
+    synchronize();
+  }
+}
+
+void GLState::endFrame()
+{
+  if (m_validation) {
+    validate();
+  }
+  m_lastFrame = m_frame;
+  m_frame = Statistics();
+}
+
+const GLState::Statistics & GLState::lastFrame() const
+{
+  return m_lastFrame;
+}
+
+bool GLState::update(Binding & binding, uint location)
+{
+  if (m_validation) {
+    validate();
+  }
+  binding.logical = location;
+  // unbinding is lazy, and binding the object already bound is redundant
+  if (location == 0 or binding.actual == location) {
+    m_frame.avoided++;
+    return false;
+  }
+  binding.actual = location;
+  m_frame.calls++;
+  return true;
+}
+
+uint GLState::bufferIndex(GLenum target)
+{
+  uint index = 0;
+  while (index < nbBufferTargets and bufferTargets[index][0] != target) {
+    index++;
+  }
+  return index;
+}
+
+uint GLState::textureIndex(GLenum target)
+{
+  uint index = 0;
+  while (index < nbTextureTargets and textureTargets[index][0] != target) {
+    index++;
+  }
+  return index;
+}
+
+void GLState::validate() const
+{
+  auto check = [](const char * name, GLenum query, uint expected) {
+    if (expected == unknown) {
+      return;
+    }
+    GLint value = 0;
+    glGetIntegerv(query, &value);
+    if (uint(value) != expected) {
+      std::cerr << "===== GLState: " << name << " is " << value << " but the shadow holds " << expected << std::endl;
+    }
+  };
+  check("the current program", GL_CURRENT_PROGRAM, m_program.actual);
+  check("the vertex array binding", GL_VERTEX_ARRAY_BINDING, m_vertexArray.actual);
+  for (uint k = 0; k < nbBufferTargets; k++) {
+    check("a buffer binding", bufferTargets[k][1], m_buffers[k].actual);
+  }
+  check("the active texture", GL_ACTIVE_TEXTURE, (m_activeUnit == unknown) ? unknown : GL_TEXTURE0 + m_activeUnit);
+  // only the bindings of the active unit can be queried
+  if (m_activeUnit < nbUnits) {
+    for (uint k = 0; k < nbTextureTargets; k++) {
+      check("a texture binding", textureTargets[k][1], m_textures[m_activeUnit][k].actual);
+    }
+    check("the sampler binding", GL_SAMPLER_BINDING, m_samplers[m_activeUnit].actual);
+  }
+}
+
+void GLState::synchronize()
+{
+  auto query = [](GLenum name) {
+    GLint value = 0;
+    glGetIntegerv(name, &value);
+    return uint(value);
+  };
+  m_program.actual = query(GL_CURRENT_PROGRAM);
+  m_vertexArray.actual = query(GL_VERTEX_ARRAY_BINDING);
+  for (uint k = 0; k < nbBufferTargets; k++) {
+    m_buffers[k].actual = query(bufferTargets[k][1]);
+  }
+  // the bindings of a unit are only queried while it is active
+  uint activeUnit = query(GL_ACTIVE_TEXTURE) - GL_TEXTURE0;
+  for (uint unit = 0; unit < nbUnits; unit++) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    for (uint k = 0; k < nbTextureTargets; k++) {
+      m_textures[unit][k].actual = query(textureTargets[k][1]);
+    }
+    m_samplers[unit].actual = query(GL_SAMPLER_BINDING);
+  }
+  glActiveTexture(GL_TEXTURE0 + activeUnit);
+  m_activeUnit = activeUnit;
+}
+
 Buffer::Buffer(GLenum target) : m_location(0), m_target(target), m_attributeSize(0)
 {
   FAIL_BECAUSE_INCOMPLETE;
@@ -26,6 +303,24 @@ void Buffer::unbind() const
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+void Buffer::setRawData(std::span<const char> bytes, uint count)
+{
+  bind();
+  glBufferData(m_target, bytes.size_bytes(), bytes.data(), GL_STATIC_DRAW);
+  unbind();
+  m_attributeCount = count;
+  m_attributeType = 0;
+  m_attributeSize = 0;
+}
+
+void Buffer::bindBase(uint bindingPoint) const
+{
+  // also binds the buffer to the generic target, where it is bound first to keep the GLState up to date
+  bind();
+  glBindBufferBase(m_target, bindingPoint, m_location);
+  unbind();
+}
+
 uint Buffer::attributeCount() const
 {
   return m_attributeCount;
@@ -41,6 +336,232 @@ uint Buffer::attributeSize() const
   return m_attributeSize;
 }
 
+StreamingBuffer::StreamingBuffer(GLenum target, size_t regionSize, unsigned int nbRegions)
+    : m_location(0), m_target(target), m_regionSize(regionSize), m_region(0), m_mapping(nullptr), m_fences(nbRegions, nullptr)
+{
+  assert(nbRegions > 0 and regionSize > 0);
+  size_t size = regionSize * nbRegions;
+  glGenBuffers(1, &m_location);
+  bind();
+  if (GLEW_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(m_target, size, nullptr, flags);
+    m_mapping = static_cast<char *>(glMapBufferRange(m_target, 0, size, flags));
+  } else {
+    glBufferData(m_target, size, nullptr, GL_STREAM_DRAW);
+    m_staging.resize(regionSize);
+  }
+  unbind();
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+  for (GLsync fence : m_fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  if (m_mapping) {
+    bind();
+    glUnmapBuffer(m_target);
+    unbind();
+  }
+  glDeleteBuffers(1, &m_location);
+  GLState::shared().invalidate();
+}
+
+void StreamingBuffer::bind() const
+{
+  GLState::shared().bindBuffer(m_target, m_location);
+}
+
+void StreamingBuffer::unbind() const
+{
+  GLState::shared().bindBuffer(m_target, 0);
+}
+
+std::span<char> StreamingBuffer::beginWrite()
+{
+  GLsync & regionFence = m_fences[m_region];
+  if (regionFence) {
+    // the commands are flushed once, so that the fence is eventually signaled
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(regionFence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+      flags = 0;
+    }
+    glDeleteSync(regionFence);
+    regionFence = nullptr;
+  }
+  if (m_mapping) {
+    return std::span<char>(m_mapping + m_region * m_regionSize, m_regionSize);
+  }
+  return std::span<char>(m_staging);
+}
+
+size_t StreamingBuffer::endWrite(size_t size)
+{
+  assert(size <= m_regionSize);
+  size_t offset = m_region * m_regionSize;
+  if (not m_mapping and size > 0) {
+    bind();
+    glBufferSubData(m_target, offset, size, m_staging.data());
+    unbind();
+  }
+  return offset;
+}
+
+void StreamingBuffer::fence()
+{
+  if (m_mapping) {
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  m_region = (m_region + 1) % m_fences.size();
+}
+
+void StreamingBuffer::bindRange(uint bindingPoint, size_t offset, size_t size) const
+{
+  // also binds the buffer to the generic target, where it is bound first to keep the GLState up to date
+  bind();
+  glBindBufferRange(m_target, bindingPoint, m_location, offset, size);
+  unbind();
+}
+
+size_t StreamingBuffer::regionSize() const
+{
+  return m_regionSize;
+}
+
+Std140Writer & Std140Writer::add(float value)
+{
+  return write(&value, 4, 4);
+}
+
+Std140Writer & Std140Writer::add(int value)
+{
+  return write(&value, 4, 4);
+}
+
+Std140Writer & Std140Writer::add(uint value)
+{
+  return write(&value, 4, 4);
+}
+
+Std140Writer & Std140Writer::add(bool value)
+{
+  return add(uint(value ? 1 : 0));
+}
+
+Std140Writer & Std140Writer::add(const glm::vec2 & value)
+{
+  return write(&value[0], 8, 8);
+}
+
+Std140Writer & Std140Writer::add(const glm::vec3 & value)
+{
+  return write(&value[0], 12, 16);
+}
+
+Std140Writer & Std140Writer::add(const glm::vec4 & value)
+{
+  return write(&value[0], 16, 16);
+}
+
+Std140Writer & Std140Writer::add(const glm::mat3 & value)
+{
+  // the columns are padded to vec4
+  for (int column = 0; column < 3; column++) {
+    write(&value[column][0], 12, 16);
+  }
+  return endStruct();
+}
+
+Std140Writer & Std140Writer::add(const glm::mat4 & value)
+{
+  for (int column = 0; column < 4; column++) {
+    write(&value[column][0], 16, 16);
+  }
+  return *this;
+}
+
+Std140Writer & Std140Writer::beginStruct()
+{
+  return write(nullptr, 0, 16);
+}
+
+Std140Writer & Std140Writer::endStruct()
+{
+  return write(nullptr, 0, 16);
+}
+
+std::span<const char> Std140Writer::data() const
+{
+  return m_data;
+}
+
+void Std140Writer::clear()
+{
+  m_data.clear();
+}
+
+Std140Writer & Std140Writer::write(const void * value, size_t size, size_t alignment)
+{
+  size_t offset = (m_data.size() + alignment - 1) / alignment * alignment;
+  m_data.resize(offset + size, 0);
+  if (size > 0) {
+    memcpy(m_data.data() + offset, value, size);
+  }
+  return *this;
+}
+
+UniformBuffer::UniformBuffer(uint bindingPoint, size_t size) : m_location(0), m_bindingPoint(bindingPoint), m_size(size)
+{
+  glGenBuffers(1, &m_location);
+  bind();
+  glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+  // also binds the buffer to the generic GL_UNIFORM_BUFFER target, where it is already bound
+  glBindBufferBase(GL_UNIFORM_BUFFER, m_bindingPoint, m_location);
+  unbind();
+}
+
+UniformBuffer::~UniformBuffer()
+{
+  glDeleteBuffers(1, &m_location);
+  GLState::shared().invalidate();
+}
+
+void UniformBuffer::bind() const
+{
+  GLState::shared().bindBuffer(GL_UNIFORM_BUFFER, m_location);
+}
+
+void UniformBuffer::unbind() const
+{
+  GLState::shared().bindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::setData(std::span<const char> bytes) const
+{
+  assert(bytes.size() <= m_size && "UniformBuffer::setData(): The block does not fit");
+  bind();
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes.size(), bytes.data());
+  unbind();
+}
+
+uint UniformBuffer::bindingPoint() const
+{
+  return m_bindingPoint;
+}
+
+uint VertexLayout::stride() const
+{
+  return m_stride;
+}
+
+const std::vector<VertexLayout::Attribute> & VertexLayout::attributes() const
+{
+  return m_attributes;
+}
+
 VAO::VAO(uint nbVBO) : m_location(0), m_vbos(nbVBO), m_ibo(GL_ELEMENT_ARRAY_BUFFER)
 {
   for (auto & vbo : m_vbos) {
@@ -70,11 +591,123 @@ void VAO::encapsulateVBO(unsigned int attributeIndex) const
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+void VAO::setInterleavedVBO(const VertexLayout & layout, std::span<const char> vertices)
+{
+  assert(layout.stride() > 0 and vertices.size() % layout.stride() == 0);
+  std::shared_ptr<Buffer> vbo(new Buffer(GL_ARRAY_BUFFER));
+  vbo->setRawData(vertices, vertices.size() / layout.stride());
+  for (const VertexLayout::Attribute & attribute : layout.attributes()) {
+    assert(attribute.index < m_vbos.size());
+    m_vbos[attribute.index] = vbo;
+  }
+  m_layout = std::make_shared<const VertexLayout>(layout);
+  encapsulateInterleavedVBO();
+}
+
+void VAO::updateInterleavedVBO(size_t offset, std::span<const char> vertices)
+{
+  assert(m_layout and offset % m_layout->stride() == 0 and vertices.size() % m_layout->stride() == 0);
+  const std::shared_ptr<Buffer> & vbo = m_vbos[m_layout->attributes().front().index];
+  assert((offset + vertices.size()) / m_layout->stride() <= vbo->attributeCount());
+  vbo->bind();
+  glBufferSubData(GL_ARRAY_BUFFER, offset, vertices.size(), vertices.data());
+  vbo->unbind();
+}
+
+void VAO::updateIBO(uint first, std::span<const glm::uint32> values)
+{
+  assert(m_ibo.attributeType() == GL_UNSIGNED_INT and first + values.size() <= m_ibo.attributeCount());
+  // the IBO is bound while this VAO is, so that no other VAO records it
+  bind();
+  m_ibo.bind();
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(glm::uint32), values.size_bytes(), values.data());
+  unbind();
+  m_ibo.unbind();
+}
+
+void VAO::encapsulateInterleavedVBO() const
+{
+  const std::vector<VertexLayout::Attribute> & attributes = m_layout->attributes();
+  bind();
+  m_vbos[attributes.front().index]->bind();
+  setAttributePointers(*m_layout, 0);
+  unbind();
+  m_vbos[attributes.front().index]->unbind();
+}
+
+void VAO::setStreamingVBO(const VertexLayout & layout, const StreamingBuffer & buffer)
+{
+  assert(layout.stride() > 0 and buffer.regionSize() % layout.stride() == 0);
+  for (const VertexLayout::Attribute & attribute : layout.attributes()) {
+    assert(attribute.index < m_vbos.size());
+  }
+  m_layout = std::make_shared<const VertexLayout>(layout);
+  bind();
+  buffer.bind();
+  setAttributePointers(*m_layout, 0);
+  unbind();
+  buffer.unbind();
+}
+
+void VAO::setInstanceVBO(const VertexLayout & layout, std::span<const char> instances)
+{
+  assert(layout.stride() > 0 and instances.size() % layout.stride() == 0);
+  for (const VertexLayout::Attribute & attribute : layout.attributes()) {
+    assert(attribute.index < 16); // the anchor points of the instances follow the ones of the vertices
+  }
+  uint nbInstances = instances.size() / layout.stride();
+  if (m_instanceVBO and *m_instanceLayout == layout and m_instanceVBO->attributeCount() >= nbInstances) {
+    // the instances fit, and the attribute pointers are unchanged: updated in place
+    m_instanceVBO->bind();
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size(), instances.data());
+    m_instanceVBO->unbind();
+    return;
+  }
+  m_instanceVBO = std::make_shared<Buffer>(GL_ARRAY_BUFFER);
+  m_instanceVBO->setRawData(instances, nbInstances);
+  m_instanceLayout = std::make_shared<const VertexLayout>(layout);
+  encapsulateInstanceVBO();
+}
+
+void VAO::encapsulateInstanceVBO() const
+{
+  bind();
+  m_instanceVBO->bind();
+  setAttributePointers(*m_instanceLayout, 1);
+  unbind();
+  m_instanceVBO->unbind();
+}
+
+void VAO::setAttributePointers(const VertexLayout & layout, uint divisor) const
+{
+  for (const VertexLayout::Attribute & attribute : layout.attributes()) {
+    const void * offset = reinterpret_cast<const void *>(static_cast<uintptr_t>(attribute.offset));
+    bool integer = attribute.type != GL_FLOAT and attribute.type != GL_DOUBLE and attribute.type != GL_HALF_FLOAT;
+    glEnableVertexAttribArray(attribute.index);
+    if (integer and not attribute.normalized) {
+      glVertexAttribIPointer(attribute.index, attribute.components, attribute.type, layout.stride(), offset);
+    } else {
+      glVertexAttribPointer(attribute.index, attribute.components, attribute.type, attribute.normalized, layout.stride(), offset);
+    }
+    glVertexAttribDivisor(attribute.index, divisor);
+  }
+}
+
 std::shared_ptr<VAO> VAO::makeSlaveVAO() const
 {
   unsigned int nbVBO = m_vbos.size();
   std::shared_ptr<VAO> slave(new VAO(nbVBO));
   slave->m_vbos = m_vbos;
+  slave->m_layout = m_layout;
+  slave->m_instanceVBO = m_instanceVBO;
+  slave->m_instanceLayout = m_instanceLayout;
+  if (m_instanceVBO) {
+    slave->encapsulateInstanceVBO();
+  }
+  if (m_layout) {
+    slave->encapsulateInterleavedVBO();
+    return slave;
+  }
   slave->bind();
   for (unsigned int attributeIndex = 0; attributeIndex < nbVBO; attributeIndex++) {
     slave->encapsulateVBO(attributeIndex);
@@ -88,6 +721,45 @@ void VAO::draw(GLenum mode) const
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+void VAO::drawArrays(GLenum mode, uint first, uint count) const
+{
+  bind();
+  glDrawArrays(mode, first, count);
+  unbind();
+}
+
+void VAO::drawInstanced(uint count, GLenum mode) const
+{
+  bind();
+  glDrawElementsInstanced(mode, m_ibo.attributeCount(), m_ibo.attributeType(), nullptr, count);
+  unbind();
+}
+
+void VAO::multiDrawIndirect(uint first, uint count, GLenum mode) const
+{
+  const void * offset = reinterpret_cast<const void *>(static_cast<uintptr_t>(first * sizeof(DrawElementsIndirectCommand)));
+  bind();
+  glMultiDrawElementsIndirect(mode, m_ibo.attributeType(), offset, count, 0);
+  unbind();
+}
+
+const Shader::Definitions * Shader::Definitions::s_current = nullptr;
+
+Shader::Definitions::Definitions(const std::vector<std::string> & defines) : m_defines(defines), m_previous(s_current)
+{
+  s_current = this;
+}
+
+Shader::Definitions::~Definitions()
+{
+  s_current = m_previous;
+}
+
+bool Shader::Definitions::read() const
+{
+  return m_read;
+}
+
 Shader::Shader(GLenum type, const std::string & filename) : m_location(0)
 {
   FAIL_BECAUSE_INCOMPLETE;
@@ -98,16 +770,73 @@ Shader::~Shader()
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+Shader::Shader(GLenum type, const std::string & filename, const std::vector<std::string> & defines) : Shader(type, filename, Definitions(defines)) {}
+
+Shader::Shader(GLenum type, const std::string & filename, const Definitions & definitions) : Shader(type, filename)
+{
+  if (not definitions.read()) {
+    std::cerr << "===== Shader::Shader(): the defines of " << filename << " were ignored, the source must be read with Shader::source" << std::endl;
+    exit(1);
+  }
+}
+
 uint Shader::location() const
 {
   return m_location;
 }
 
+std::string Shader::source(const std::string & filename)
+{
+  if (not Definitions::s_current) {
+    return fileContent(filename);
+  }
+  Definitions::s_current->m_read = true;
+  return source(filename, Definitions::s_current->m_defines);
+}
+
+std::string Shader::source(const std::string & filename, const std::vector<std::string> & defines)
+{
+  std::string code = fileContent(filename);
+  if (defines.empty()) {
+    return code;
+  }
+  std::string definitions;
+  for (const std::string & define : defines) {
+    definitions += "#define " + define + "\n";
+  }
+  // the version directive must come first
+  size_t position = 0;
+  size_t version = code.find("#version");
+  if (version != std::string::npos) {
+    size_t endOfLine = code.find('\n', version);
+    if (endOfLine == std::string::npos) {
+      code += '\n';
+      endOfLine = code.size() - 1;
+    }
+    position = endOfLine + 1;
+  }
+  // the compiler then reports the line numbers of the file
+  size_t line = std::count(code.begin(), code.begin() + position, '\n') + 1;
+  definitions += "#line " + std::to_string(line) + "\n";
+  code.insert(position, definitions);
+  return code;
+}
+
 Program::Program(const std::string & vname, const std::string & fname) : m_location(0), m_vshader(GL_VERTEX_SHADER, vname), m_fshader(GL_FRAGMENT_SHADER, fname)
 {
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+Program::Program(const std::string & vname, const std::string & fname, const std::vector<std::string> & defines) : Program(vname, fname, Shader::Definitions(defines)) {}
+
+Program::Program(const std::string & vname, const std::string & fname, const Shader::Definitions & definitions) : Program(vname, fname)
+{
+  if (not definitions.read()) {
+    std::cerr << "===== Program::Program(): the defines of " << vname << " and " << fname << " were ignored, the shader sources must be read with Shader::source" << std::endl;
+    exit(1);
+  }
+}
+
 Program::~Program()
 {
   FAIL_BECAUSE_INCOMPLETE;
@@ -174,11 +903,78 @@ template <> void Program::uniformDispatcher(int location, const glm::mat4 & val)
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+bool Program::findUniformLocation(const std::string & name, int & location) const
+{
+  if (not m_reflected) {
+    reflectUniforms();
+  }
+  auto uniform = m_uniforms.find(name);
+  if (uniform == m_uniforms.end()) {
+    return false;
+  }
+  location = uniform->second;
+  return true;
+}
+
+void Program::reflectUniforms() const
+{
+  m_uniforms.clear();
+  GLint nbUniforms = 0;
+  GLint maxLength = 0;
+  glGetProgramiv(m_location, GL_ACTIVE_UNIFORMS, &nbUniforms);
+  glGetProgramiv(m_location, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<char> buffer(maxLength + 1);
+  for (GLint k = 0; k < nbUniforms; k++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type;
+    glGetActiveUniform(m_location, k, GLsizei(buffer.size()), &length, &size, &type, buffer.data());
+    std::string name(buffer.data(), length);
+    // the locations come from the PA2 lookup, and the members of uniform blocks have none
+    int location;
+    if (not getUniformLocation(name, location)) {
+      continue;
+    }
+    m_uniforms[name] = location;
+    // arrays of basic types are reported once (e.g. "weights[0]"): their elements are looked up individually
+    if (name.size() > 3 and name.compare(name.size() - 3, 3, "[0]") == 0) {
+      std::string arrayName = name.substr(0, name.size() - 3);
+      m_uniforms[arrayName] = location;
+      for (GLint element = 1; element < size; element++) {
+        std::string elementName = arrayName + "[" + std::to_string(element) + "]";
+        int elementLocation;
+        if (getUniformLocation(elementName, elementLocation)) {
+          m_uniforms[elementName] = elementLocation;
+        }
+      }
+    }
+  }
+  m_reflected = true;
+}
+
+void Program::setUniformBlockBinding(const std::string & blockName, uint bindingPoint) const
+{
+  GLuint blockIndex = glGetUniformBlockIndex(m_location, blockName.c_str());
+  if (blockIndex == GL_INVALID_INDEX) {
+    std::cerr << "=====" << blockName << " uniform block was queried but does not exist\n";
+    return;
+  }
+  glUniformBlockBinding(m_location, blockIndex, bindingPoint);
+}
+
+void Program::setStorageBlockBinding(const std::string & blockName, uint bindingPoint) const
+{
+  GLuint blockIndex = glGetProgramResourceIndex(m_location, GL_SHADER_STORAGE_BLOCK, blockName.c_str());
+  if (blockIndex == GL_INVALID_INDEX) {
+    std::cerr << "=====" << blockName << " shader storage block was queried but does not exist\n";
+    return;
+  }
+  glShaderStorageBlockBinding(m_location, blockIndex, bindingPoint);
+}
+
 bool Program::bound() const
 {
-  int currentProgram;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-  return m_location == (GLuint)currentProgram;
+  return m_location == GLState::shared().program();
 }
 
 Texture::Texture(GLenum target) : m_location(0), m_target(target)
@@ -206,6 +1002,54 @@ template <> void Texture::setData<GLubyte>(const Image<GLubyte> & image, bool mi
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+void Texture::setData(const BakedTexture & texture) const
+{
+  assert(m_target == GL_TEXTURE_2D && "Texture::setData(): Baked textures are 2D textures");
+  bind();
+  glTexParameteri(m_target, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, GLint(texture.levels.size()) - 1);
+  for (size_t k = 0; k < texture.levels.size(); k++) {
+    const BakedTextureLevel & level = texture.levels[k];
+    if (texture.format == TextureFormat::RGBA8) {
+      glTexImage2D(m_target, GLint(k), GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.data.data());
+    } else {
+      glCompressedTexImage2D(m_target, GLint(k), compressedInternalFormat(texture.format), level.width, level.height, 0, GLsizei(level.data.size()), level.data.data());
+    }
+  }
+  unbind();
+}
+
+void Texture::setLayers(std::span<const BakedTexture> layers, bool mipmaps) const
+{
+  assert(m_target == GL_TEXTURE_2D_ARRAY && "Texture::setLayers(): Layers are sent to array textures");
+  assert(not layers.empty() && "Texture::setLayers(): No layer");
+  const BakedTexture & first = layers.front();
+  bind();
+  std::vector<char> levelData;
+  for (size_t k = 0; k < first.levels.size(); k++) {
+    // the layers of a level are contiguous
+    levelData.clear();
+    for (const BakedTexture & layer : layers) {
+      assert(layer.format == first.format && layer.levels.size() == first.levels.size() && layer.levels[k].width == first.levels[k].width &&
+             layer.levels[k].height == first.levels[k].height && "Texture::setLayers(): Incompatible layers");
+      levelData.insert(levelData.end(), layer.levels[k].data.begin(), layer.levels[k].data.end());
+    }
+    const BakedTextureLevel & level = first.levels[k];
+    if (first.format == TextureFormat::RGBA8) {
+      glTexImage3D(m_target, GLint(k), GL_RGBA8, level.width, level.height, GLsizei(layers.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, levelData.data());
+    } else {
+      glCompressedTexImage3D(m_target, GLint(k), compressedInternalFormat(first.format), level.width, level.height, GLsizei(layers.size()), 0, GLsizei(levelData.size()), levelData.data());
+    }
+  }
+  if (mipmaps and first.levels.size() == 1 and first.format == TextureFormat::RGBA8) {
+    glGenerateMipmap(m_target);
+  } else {
+    glTexParameteri(m_target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, GLint(first.levels.size()) - 1);
+  }
+  unbind();
+}
+
 Sampler::Sampler(int texUnit) : m_location(0), m_texUnit(texUnit)
 {
   FAIL_BECAUSE_INCOMPLETE;
@@ -4,23 +4,191 @@
 #include <cassert>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 typedef GLuint uint;
 
 #include "AttributeProperties.hpp"
 #include "Image.hpp"
+#include "TextureCompression.hpp"
 
 #define FAIL_BECAUSE_INCOMPLETE                                                                                                                                                                        \
   std::cerr << "Failure in file " << __FILE__ << ":" << __LINE__ << std::endl;                                                                                                                         \
   std::cerr << __PRETTY_FUNCTION__ << ": You must complete the implementation (look at the documentation in the header)" << std::endl;                                                                 \
   exit(EXIT_FAILURE);
 
+/**
+ * @brief Shadow of the OpenGL bindings, which skips the redundant bind and unbind calls
+ *
+ * All the glApi objects bind themselves through this cache (e.g. GLState::useProgram rather
+ * than ::glUseProgram). A binding is only sent to OpenGL when it differs from the shadow, and
+ * unbinding (binding 0) is lazy: the object stays bound in OpenGL, so that the usual
+ * bind / work / unbind / bind sequence of consecutive draw calls only binds once.
+ *
+ * Lazy unbinding is safe for the bindings that are only read by the calls that bind their
+ * own object first. Two bindings are exceptions. Binding an element array buffer is recorded
+ * by the bound VAO: a VAO that is only logically unbound is really unbound before (element
+ * array bindings are never skipped). A sampler bound to a texture unit overrides the parameters
+ * of the textures of the unit: samplers are unbound immediately.
+ *
+ * The shadow must be invalidated (GLState::invalidate) when an object is deleted, since
+ * OpenGL then resets its bindings and may reuse its location. In validation mode (meant
+ * for debugging, enabled by setting the GLITTER_VALIDATE_GL_STATE environment variable or by
+ * GLState::setValidation), the shadow is compared with the real OpenGL state before every call
+ * and at the end of every frame. The shadow is then read back from OpenGL instead of being
+ * invalidated, so that a binding made by calling OpenGL directly (e.g. a ::glBindBuffer in a
+ * bind method instead of GLState::bindBuffer) is reported.
+ *
+ * @note The cache must only be used by the thread owning the OpenGL context.
+ */
+class GLState {
+public:
+  /**
+   * @brief Counters of the binding requests
+   */
+  struct Statistics {
+    size_t calls = 0;   ///< requests sent to OpenGL
+    size_t avoided = 0; ///< redundant requests skipped
+  };
+
+  GLState(const GLState &) = delete;
+  GLState & operator=(const GLState &) = delete;
+
+  /**
+   * @brief the shadow of the OpenGL context of the application
+   * @return a cache living as long as the program
+   */
+  static GLState & shared();
+
+  /**
+   * @brief binds a program (see ::glUseProgram)
+   * @param program the GPU location of the program (0 unbinds lazily)
+   */
+  void useProgram(uint program);
+
+  /**
+   * @brief binds a VAO (see ::glBindVertexArray)
+   * @param vao the GPU location of the VAO (0 unbinds lazily)
+   */
+  void bindVertexArray(uint vao);
+
+  /**
+   * @brief binds a buffer (see ::glBindBuffer)
+   * @param target the binding target
+   * @param buffer the GPU location of the buffer (0 unbinds lazily, except for GL_ELEMENT_ARRAY_BUFFER)
+   */
+  void bindBuffer(GLenum target, uint buffer);
+
+  /**
+   * @brief selects the active texture unit (see ::glActiveTexture)
+   * @param unit the texture unit
+   */
+  void activeTexture(uint unit);
+
+  /**
+   * @brief binds a texture to the active texture unit (see ::glBindTexture)
+   * @param target the binding target
+   * @param texture the GPU location of the texture (0 unbinds lazily)
+   */
+  void bindTexture(GLenum target, uint texture);
+
+  /**
+   * @brief binds a sampler to a texture unit (see ::glBindSampler)
+   * @param unit the texture unit
+   * @param sampler the GPU location of the sampler (0 unbinds immediately, so that the unit uses the parameters of its textures)
+   */
+  void bindSampler(uint unit, uint sampler);
+
+  /**
+   * @brief program
+   * @return the program bound by the last call to GLState::useProgram (0 if it was an unbinding)
+   */
+  uint program() const;
+
+  /**
+   * @brief forgets the shadow: the next bindings are all sent to OpenGL
+   *
+   * To be called when objects are deleted, or when OpenGL is called directly.
+   */
+  void invalidate();
+
+  /**
+   * @brief toggles the comparison of the shadow with the real OpenGL state (slow, meant for debugging)
+   * @param enabled whether the comparison is enabled
+   */
+  void setValidation(bool enabled);
+
+  /**
+   * @brief ends a frame (see Application::mainLoop): the counters of the frame are saved and reset (and the shadow is validated)
+   */
+  void endFrame();
+
+  /**
+   * @brief getter for the counters of the last frame
+   * @return the counters of the last frame ended by GLState::endFrame
+   */
+  const Statistics & lastFrame() const;
+
+private:
+  /// A binding point
+  struct Binding {
+    uint actual = unknown; ///< the object bound in OpenGL
+    uint logical = 0;      ///< the object bound for the application (0 once lazily unbound)
+  };
+
+  /// Location meaning that the binding in OpenGL is unknown
+  static const uint unknown = ~0u;
+
+  /// Number of texture units shadowed
+  static const uint nbUnits = 32;
+
+  /// Number of texture targets shadowed per unit (see GLState::textureIndex)
+  static const uint nbTextureTargets = 4;
+
+  /// Number of buffer targets shadowed (see GLState::bufferIndex)
+  static const uint nbBufferTargets = 4;
+
+  /// enables the validation if the GLITTER_VALIDATE_GL_STATE environment variable is set (to anything but 0)
+  GLState();
+
+  /// updates a binding, and tells whether OpenGL must be called
+  bool update(Binding & binding, uint location);
+
+  /// index of a buffer target in m_buffers (or nbBufferTargets if it is not shadowed)
+  static uint bufferIndex(GLenum target);
+
+  /// index of a texture target in m_textures (or nbTextureTargets if it is not shadowed)
+  static uint textureIndex(GLenum target);
+
+  /// compares the shadow with the real OpenGL state and reports the differences
+  void validate() const;
+
+  /// reads the shadow back from the real OpenGL state
+  void synchronize();
+
+private:
+  Binding m_program;                             ///< GL_CURRENT_PROGRAM
+  Binding m_vertexArray;                         ///< GL_VERTEX_ARRAY_BINDING
+  Binding m_buffers[nbBufferTargets];            ///< GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_SHADER_STORAGE_BUFFER
+  uint m_activeUnit = unknown;                   ///< GL_ACTIVE_TEXTURE (minus GL_TEXTURE0)
+  Binding m_textures[nbUnits][nbTextureTargets]; ///< GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP of each unit
+  Binding m_samplers[nbUnits];                   ///< sampler of each unit
+  bool m_validation = false;                     ///< whether the shadow is compared with OpenGL
+  Statistics m_frame;                            ///< counters of the current frame
+  Statistics m_lastFrame;                        ///< counters of the last frame
+};
+
 /**
  * @brief Tiny abstraction for OpenGL objects that can be bound to
  * the current openGL state (like VBOs, VAOs, Programs, Textures, ...)
  *
- * This interface exposes bind / unbind mechanisms.
+ * This interface exposes bind / unbind mechanisms. The implementations must bind
+ * through the GLState cache, which skips the redundant calls: a binding made by
+ * calling OpenGL directly leaves the cache out of date (the next bindings may then be
+ * wrongly skipped), which is reported in validation mode (see GLState).
  */
 class OGLStateObject {
 public:
@@ -58,21 +226,21 @@ public:
   /**
    * @brief destructor
    *
-   * @note PA1: At destruction, the GPU memory should be released
+   * @note PA1: At destruction, the GPU memory should be released (and the GLState invalidated, see GLState::invalidate)
    */
   ~Buffer();
 
   /**
    * @brief binds this Buffer to the current state
    *
-   * @note PA1
+   * @note PA1: use GLState::bindBuffer rather than ::glBindBuffer
    */
   void bind() const override;
 
   /**
    * @brief unbinds this Buffer from the current state
    *
-   * @note PA1
+   * @note PA1: use GLState::bindBuffer rather than ::glBindBuffer
    */
   void unbind() const override;
 
@@ -94,6 +262,37 @@ public:
    */
   template <typename T> void setData(const std::vector<T> & values);
 
+  /**
+   * @brief Sends data to the GPU location attached to this instance.
+   * @param values a view on the data to be sent (e.g. into a memory mapped file)
+   *
+   * The values are copied, then sent by Buffer::setData(const std::vector<T> &).
+   *
+   * @note The implementation of this method is already complete.
+   */
+  template <typename T> void setData(std::span<const T> values);
+
+  /**
+   * @brief Sends raw bytes (e.g. interleaved vertices) to the GPU location attached to this instance.
+   * @param bytes the data to be sent
+   * @param count the number of attributes (e.g. vertices) stored in @p bytes
+   *
+   * The type and size of the attributes are left undefined (0): the formatting
+   * of such a buffer is described by a VertexLayout.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setRawData(std::span<const char> bytes, uint count);
+
+  /**
+   * @brief attaches this Buffer to an indexed binding point of its target (e.g. a GL_SHADER_STORAGE_BUFFER
+   * binding point, see Program::setStorageBlockBinding)
+   * @param bindingPoint the binding point
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void bindBase(uint bindingPoint) const;
+
   /**
    * @brief attributeCount
    * @return the number of attributes
@@ -120,6 +319,311 @@ private:
   uint m_attributeSize;   ///< Buffer formatting : components per attribute
 };
 
+/**
+ * @brief A buffer rewritten every frame (e.g. text overlays, animated vertices), split into regions used in turn
+ *
+ * The storage is allocated once with ::glBufferStorage and stays mapped (persistent and coherent
+ * mapping): the CPU writes straight into memory read by the GPU, without reallocation nor driver
+ * copies. While the GPU reads a region (during frame n), the CPU fills the next one (frame n + 1).
+ * A fence (::glFenceSync) is inserted after the draw calls reading a region, and waited for before
+ * the region is written again, which only blocks if the GPU is more than nbRegions - 1 frames late.
+ * A frame thus looks like:
+ * @code
+ * std::span<char> region = buffer.beginWrite();
+ * // ... fill the first n bytes of region
+ * size_t offset = buffer.endWrite(n);
+ * // ... draw calls reading the bytes at offset
+ * buffer.fence();
+ * @endcode
+ *
+ * Without ::glBufferStorage (OpenGL < 4.4, e.g. macOS), the regions are written to a staging
+ * copy and sent with ::glBufferSubData by StreamingBuffer::endWrite.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class StreamingBuffer : public OGLStateObject {
+public:
+  /**
+   * @brief allocates and maps the buffer
+   * @param target the binding target of the buffer (e.g. GL_ARRAY_BUFFER)
+   * @param regionSize the size of a region in bytes (the most that can be written per frame)
+   * @param nbRegions the number of regions (3 lets the CPU run 2 frames ahead of the GPU)
+   *
+   * @note The implementation of this method is already complete.
+   */
+  StreamingBuffer(GLenum target, size_t regionSize, unsigned int nbRegions = 3);
+
+  StreamingBuffer(const StreamingBuffer &) = delete;
+  StreamingBuffer & operator=(const StreamingBuffer &) = delete;
+
+  /**
+   * @brief unmaps and releases the buffer
+   *
+   * @note The implementation of this method is already complete.
+   */
+  ~StreamingBuffer();
+
+  /**
+   * @brief binds this StreamingBuffer to the current state
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void bind() const override;
+
+  /**
+   * @brief unbinds this StreamingBuffer from the current state
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void unbind() const override;
+
+  /**
+   * @brief gives access to the current region (waits until the GPU does not read it anymore)
+   * @return the memory of the region (StreamingBuffer::regionSize bytes)
+   *
+   * @note The implementation of this method is already complete.
+   */
+  std::span<char> beginWrite();
+
+  /**
+   * @brief ends the writing of the current region
+   * @param size the number of bytes written at the beginning of the region
+   * @return the offset (in bytes) of the region in the buffer, to be used by the draw calls
+   *
+   * @note The implementation of this method is already complete.
+   */
+  size_t endWrite(size_t size);
+
+  /**
+   * @brief protects the current region until the draw calls issued so far are executed, and moves to the next region
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void fence();
+
+  /**
+   * @brief attaches a range of this StreamingBuffer to an indexed binding point of its target (e.g. a GL_SHADER_STORAGE_BUFFER block)
+   * @param bindingPoint the binding point
+   * @param offset the offset of the range (e.g. returned by StreamingBuffer::endWrite), aligned as required by the target
+   * @param size the size of the range in bytes
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void bindRange(uint bindingPoint, size_t offset, size_t size) const;
+
+  /**
+   * @brief regionSize
+   * @return the size of a region in bytes
+   */
+  size_t regionSize() const;
+
+private:
+  uint m_location;              ///< GPU location of the buffer
+  GLenum m_target;              ///< binding target of the buffer
+  size_t m_regionSize;          ///< size of a region
+  unsigned int m_region;        ///< index of the current region
+  char * m_mapping;             ///< persistent mapping of the whole buffer (nullptr without ::glBufferStorage)
+  std::vector<char> m_staging;  ///< copy of the current region (only without ::glBufferStorage)
+  std::vector<GLsync> m_fences; ///< fence of each region (nullptr if not read by pending draw calls)
+};
+
+/**
+ * @brief Packs values into the memory of a uniform block declared with layout(std140)
+ *
+ * The std140 rules are: 4 bytes scalars, vec2 aligned on 8 bytes, vec3 and vec4 aligned on
+ * 16 bytes (a vec3 followed by a scalar shares its 16 bytes), matrices stored as arrays of
+ * columns, and array elements and structures aligned on 16 bytes. The values must be added
+ * in the order of the declaration of the block:
+ * @code
+ * // layout(std140) uniform Lights { DirLight lights[2]; };  with struct DirLight { vec3 direction; vec3 intensity; };
+ * Std140Writer writer;
+ * for (const Light & light : lights) {
+ *   writer.beginStruct().add(light.direction).add(light.intensity).endStruct();
+ * }
+ * uniformBuffer.setData(writer.data());
+ * @endcode
+ */
+class Std140Writer {
+public:
+  Std140Writer & add(float value);             ///< appends a float
+  Std140Writer & add(int value);               ///< appends an int
+  Std140Writer & add(uint value);              ///< appends an uint
+  Std140Writer & add(bool value);              ///< appends a bool (4 bytes)
+  Std140Writer & add(const glm::vec2 & value); ///< appends a vec2
+  Std140Writer & add(const glm::vec3 & value); ///< appends a vec3
+  Std140Writer & add(const glm::vec4 & value); ///< appends a vec4
+  Std140Writer & add(const glm::mat3 & value); ///< appends a mat3 (three 16 bytes columns)
+  Std140Writer & add(const glm::mat4 & value); ///< appends a mat4
+
+  /**
+   * @brief appends an array (each element being aligned on 16 bytes)
+   * @param values the elements
+   * @return this writer (calls can be chained)
+   */
+  template <typename T> Std140Writer & addArray(std::span<const T> values);
+
+  /**
+   * @brief starts a structure (or an element of an array of structures)
+   * @return this writer (calls can be chained)
+   */
+  Std140Writer & beginStruct();
+
+  /**
+   * @brief ends a structure (its size is rounded up to a multiple of 16 bytes)
+   * @return this writer (calls can be chained)
+   */
+  Std140Writer & endStruct();
+
+  /**
+   * @brief data
+   * @return the bytes of the block written so far
+   */
+  std::span<const char> data() const;
+
+  /**
+   * @brief removes all the values (the memory is kept for the next block)
+   */
+  void clear();
+
+private:
+  /// pads the block up to a multiple of @p alignment, then appends @p size bytes
+  Std140Writer & write(const void * value, size_t size, size_t alignment);
+
+private:
+  std::vector<char> m_data; ///< the bytes of the block
+};
+
+/**
+ * @brief Uniform Buffer Object: the memory of a uniform block shared by several programs
+ *
+ * The buffer is attached once for all to a binding point, and the uniform blocks of the
+ * programs are associated with the same binding point (see Program::setUniformBlockBinding).
+ * Updating the buffer then updates the block of all these programs at once.
+ *
+ * Copy constructor and assignment operator are disabled.
+ */
+class UniformBuffer : public OGLStateObject {
+public:
+  /**
+   * @brief allocates the buffer and attaches it to a binding point
+   * @param bindingPoint the binding point (less than GL_MAX_UNIFORM_BUFFER_BINDINGS, at least 36)
+   * @param size the size of the block in bytes
+   *
+   * @note The implementation of this method is already complete.
+   */
+  UniformBuffer(uint bindingPoint, size_t size);
+
+  UniformBuffer(const UniformBuffer &) = delete;
+  UniformBuffer & operator=(const UniformBuffer &) = delete;
+
+  /**
+   * @brief releases the buffer
+   *
+   * @note The implementation of this method is already complete.
+   */
+  ~UniformBuffer();
+
+  /**
+   * @brief binds this UniformBuffer to the current state (GL_UNIFORM_BUFFER)
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void bind() const override;
+
+  /**
+   * @brief unbinds this UniformBuffer from the current state
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void unbind() const override;
+
+  /**
+   * @brief updates the block (without reallocating the buffer)
+   * @param bytes the block (e.g. Std140Writer::data, at most the size of the buffer)
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setData(std::span<const char> bytes) const;
+
+  /**
+   * @brief bindingPoint
+   * @return the binding point the buffer is attached to
+   */
+  uint bindingPoint() const;
+
+private:
+  uint m_location;     ///< GPU location of the buffer
+  uint m_bindingPoint; ///< binding point of the buffer
+  size_t m_size;       ///< size of the buffer
+};
+
+/**
+ * @brief Runtime description of interleaved vertex attributes
+ *
+ * Each attribute is stored at a fixed offset inside a vertex, and all the vertices
+ * are packed one after the other (stride = size of a vertex). Attributes are appended
+ * in their storage order, their type and number of components being deduced from
+ * AttributeProperties:
+ * @code
+ * VertexLayout layout;
+ * layout.add<glm::vec3>(0).add<glm::vec2>(1).add<glm::vec3>(2);
+ * @endcode
+ */
+class VertexLayout {
+public:
+  /// An attribute of the layout
+  struct Attribute {
+    uint index;           ///< anchor point of the attribute in the VAO
+    GLenum type;          ///< type of the components
+    uint components;      ///< number of components
+    uint offset;          ///< offset (in bytes) of the attribute from the beginning of a vertex
+    GLboolean normalized; ///< whether integer components are normalized to [0, 1] (or [-1, 1])
+
+    bool operator==(const Attribute &) const = default;
+  };
+
+  /**
+   * @brief appends an attribute at the end of a vertex
+   * @param attributeIndex the anchor point of the attribute in the VAO
+   * @param normalized whether integer components are normalized when fetched as floats (defaults to the AttributeProperties of @a T)
+   * @return this layout (calls can be chained)
+   */
+  template <typename T> VertexLayout & add(uint attributeIndex, bool normalized = attributeNormalized<T>());
+
+  /**
+   * @brief stride
+   * @return the size (in bytes) of a vertex
+   */
+  uint stride() const;
+
+  /**
+   * @brief attributes
+   * @return the attributes, in their storage order
+   */
+  const std::vector<Attribute> & attributes() const;
+
+  /**
+   * @brief compares two layouts
+   * @return true if both layouts have the same attributes (anchor points, types, offsets and normalization) and the same stride
+   */
+  bool operator==(const VertexLayout &) const = default;
+
+private:
+  std::vector<Attribute> m_attributes; ///< the attributes
+  uint m_stride = 0;                   ///< the size of a vertex
+};
+
+/**
+ * @brief A draw call of ::glMultiDrawElementsIndirect, as laid out in a GL_DRAW_INDIRECT_BUFFER
+ */
+struct DrawElementsIndirectCommand {
+  uint count;         ///< number of indices
+  uint instanceCount; ///< number of instances
+  uint firstIndex;    ///< index of the first index in the IBO
+  int baseVertex;     ///< value added to the indices
+  uint baseInstance;  ///< first instance (offsets the per-instance attributes)
+};
+
 /**
  * @brief The VAO class.
  *
@@ -147,21 +651,21 @@ public:
   /**
    * @brief Destructor
    *
-   * @note PA1: at destruction all allocated GPU memory must be released
+   * @note PA1: at destruction all allocated GPU memory must be released (and the GLState invalidated, see GLState::invalidate)
    */
   ~VAO();
 
   /**
    * @brief binds this VAO to the current state
    *
-   * @note PA1
+   * @note PA1: use GLState::bindVertexArray rather than ::glBindVertexArray
    */
   void bind() const override;
 
   /**
    * @brief unbinds this VAO from the current state
    *
-   * @note PA1
+   * @note PA1: use GLState::bindVertexArray rather than ::glBindVertexArray
    */
   void unbind() const override;
 
@@ -179,6 +683,61 @@ public:
    */
   template <typename T> void setVBO(uint attributeIndex, const std::vector<T> & values);
 
+  /**
+   * @brief sets up a given VBO from a view on the values
+   * @param attributeIndex the anchor point of the VBO to set-up
+   * @param values a view on the values to be sent to the VBO location.
+   *
+   * The values are copied, then set up by VAO::setVBO(uint, const std::vector<T> &).
+   *
+   * @note The implementation of this method is already complete.
+   */
+  template <typename T> void setVBO(uint attributeIndex, std::span<const T> values);
+
+  /**
+   * @brief sets up a single VBO holding several interleaved attributes
+   * @param layout the description of the interleaved attributes
+   * @param vertices the packed vertices (whose size is a multiple of the stride of @p layout)
+   *
+   * The same VBO is then shared by all the anchor points of @p layout.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setInterleavedVBO(const VertexLayout & layout, std::span<const char> vertices);
+
+  /**
+   * @brief updates a range of the interleaved VBO in place (see VAO::setInterleavedVBO)
+   * @param offset the offset (in bytes) of the first vertex updated
+   * @param vertices the packed vertices, that must fit in the VBO
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void updateInterleavedVBO(size_t offset, std::span<const char> vertices);
+
+  /**
+   * @brief sources interleaved attributes from a StreamingBuffer
+   * @param layout the description of the interleaved attributes
+   * @param buffer the buffer (must outlive this VAO, and its regions must hold a whole number of vertices)
+   *
+   * The attributes point to the beginning of the buffer: the vertices written in a region are drawn
+   * with VAO::drawArrays, starting at the region offset divided by the stride of @p layout.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setStreamingVBO(const VertexLayout & layout, const StreamingBuffer & buffer);
+
+  /**
+   * @brief sets up a VBO of per-instance attributes (see VAO::drawInstanced)
+   * @param layout the description of the interleaved attributes of an instance (a matrix takes one anchor point per column)
+   * @param instances the packed attributes of the instances (whose size is a multiple of the stride of @p layout)
+   *
+   * The attributes advance once per instance instead of once per vertex (see ::glVertexAttribDivisor).
+   * The VBO is only reallocated when it grows, so that the instances may be updated every frame.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setInstanceVBO(const VertexLayout & layout, std::span<const char> instances);
+
   /**
    * @brief sets up the IBO
    * @param values the values to be sent to the IBO location.
@@ -191,6 +750,27 @@ public:
    */
   template <typename T> void setIBO(const std::vector<T> & values);
 
+  /**
+   * @brief sets up the IBO from a view on the values
+   * @param values a view on the values to be sent to the IBO location.
+   *
+   * 32 bits indices are narrowed to 16 bits when all of them fit, which halves
+   * the memory and bandwidth used by the IBO. The indices are then set up by
+   * VAO::setIBO(const std::vector<T> &).
+   *
+   * @note The implementation of this method is already complete.
+   */
+  template <typename T> void setIBO(std::span<const T> values);
+
+  /**
+   * @brief updates a range of the IBO in place
+   * @param first the first index updated
+   * @param values the indices, that must fit in the IBO (set up with 32 bits indices by VAO::setIBO(const std::vector<T> &))
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void updateIBO(uint first, std::span<const glm::uint32> values);
+
   /**
    * @brief makes a VAO sharing the same VBOs and with an empty IBO
    * @return the slave VAO
@@ -204,9 +784,42 @@ public:
    * @param mode primitive type
    *
    * @note PA1 (part 2): in addition to the draw call, make sure to bind and unbind the VAO correctly.
+   * The type of the indices must be taken from the IBO formatting (Buffer::attributeType), since
+   * an IBO may hold 16 bits (GL_UNSIGNED_SHORT) or 32 bits (GL_UNSIGNED_INT) indices.
    */
   void draw(GLenum mode = GL_TRIANGLES) const;
 
+  /**
+   * @brief Make a draw call for a range of vertices, without the IBO
+   * @param mode primitive type
+   * @param first the index of the first vertex
+   * @param count the number of vertices
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void drawArrays(GLenum mode, uint first, uint count) const;
+
+  /**
+   * @brief Make a single draw call rendering the VAO several times
+   * @param count the number of instances (at most the number of instances of VAO::setInstanceVBO)
+   * @param mode primitive type
+   *
+   * The instances only differ by their per-instance attributes (and ::gl_InstanceID).
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void drawInstanced(uint count, GLenum mode = GL_TRIANGLES) const;
+
+  /**
+   * @brief Make a single draw call for several ranges of the IBO (see ::glMultiDrawElementsIndirect)
+   * @param first the index of the first DrawElementsIndirectCommand in the bound GL_DRAW_INDIRECT_BUFFER
+   * @param count the number of commands
+   * @param mode primitive type
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void multiDrawIndirect(uint first, uint count, GLenum mode = GL_TRIANGLES) const;
+
 private:
   /**
    * @brief encapsulates the VBO in this VAO
@@ -223,10 +836,32 @@ private:
    */
   void encapsulateVBO(unsigned int attributeIndex) const;
 
+  /**
+   * @brief encapsulates the interleaved VBO in this VAO (one anchor point per attribute of the layout)
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void encapsulateInterleavedVBO() const;
+
+  /**
+   * @brief describes interleaved attributes to the currently bound VAO and VBO
+   * @param layout the description of the attributes
+   * @param divisor 0 for per-vertex attributes, 1 for per-instance ones (see ::glVertexAttribDivisor)
+   */
+  void setAttributePointers(const VertexLayout & layout, uint divisor) const;
+
+  /**
+   * @brief encapsulates the per-instance VBO in this VAO
+   */
+  void encapsulateInstanceVBO() const;
+
 private:
-  uint m_location;                             ///< GPU location of the VAO
-  std::vector<std::shared_ptr<Buffer>> m_vbos; ///< List of the VBOs
-  Buffer m_ibo;                                ///< IBO
+  uint m_location;                                      ///< GPU location of the VAO
+  std::vector<std::shared_ptr<Buffer>> m_vbos;          ///< List of the VBOs
+  Buffer m_ibo;                                         ///< IBO
+  std::shared_ptr<const VertexLayout> m_layout;         ///< Layout of the interleaved VBO (if any)
+  std::shared_ptr<Buffer> m_instanceVBO;                ///< VBO of the per-instance attributes (if any)
+  std::shared_ptr<const VertexLayout> m_instanceLayout; ///< Layout of the per-instance VBO
 };
 
 /**
@@ -237,6 +872,41 @@ private:
  */
 class Shader {
 public:
+  /**
+   * @brief Sets the preprocessor definitions inserted by Shader::source while it lives
+   *
+   * The shaders constructed during the lifetime of an instance are compiled with its definitions
+   * (see Shader::Shader(GLenum, const std::string &, const std::vector<std::string> &)).
+   */
+  class Definitions {
+  public:
+    /**
+     * @brief Constructor
+     * @param defines the definitions (e.g. "NB_LIGHTS 3"), that must outlive this instance
+     */
+    explicit Definitions(const std::vector<std::string> & defines);
+    Definitions(const Definitions &) = delete;
+    Definitions & operator=(const Definitions &) = delete;
+
+    /**
+     * @brief Destructor (the previous definitions, if any, apply again)
+     */
+    ~Definitions();
+
+    /**
+     * @brief read
+     * @return true if Shader::source inserted these definitions in a source
+     */
+    bool read() const;
+
+  private:
+    friend class Shader;
+    const std::vector<std::string> & m_defines; ///< the definitions
+    const Definitions * m_previous;             ///< the definitions replaced by these ones
+    mutable bool m_read = false;                ///< whether Shader::source inserted the definitions
+    static const Definitions * s_current;       ///< the definitions inserted by Shader::source (or nullptr)
+  };
+
   /**
    * @brief Constructor from a filename
    * @param type Vertex or Fragment shader
@@ -244,11 +914,24 @@ public:
    *
    * @note PA1: At construction, the following actions must take place:
    * 	- GPU memory allocation
-   * 	- reading the content of the file named @p filename (see utils.hpp ::fileContent)
+   * 	- reading the source of the file named @p filename (see Shader::source(const std::string &))
    * 	- setting the source code of the shader
    *  - compiling the shader
    */
   Shader(GLenum type, const std::string & filename);
+
+  /**
+   * @brief Constructor from a filename and a list of preprocessor definitions
+   * @param type Vertex or Fragment shader
+   * @param filename the name of the source file
+   * @param defines the definitions (e.g. "NB_LIGHTS 3"), inserted after the version directive
+   *
+   * The shader is built by the constructor above, the definitions being inserted by Shader::source.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  Shader(GLenum type, const std::string & filename, const std::vector<std::string> & defines);
+
   Shader(const Shader &) = delete;
   Shader & operator=(const Shader &) = delete;
 
@@ -265,10 +948,50 @@ public:
    */
   uint location() const;
 
+  /**
+   * @brief reads the source of a shader (see utils.hpp ::fileContent), and inserts the current Shader::Definitions if any
+   * @param filename the name of the source file
+   * @return the source code to be compiled by the shader
+   *
+   * @note The implementation of this method is already complete.
+   */
+  static std::string source(const std::string & filename);
+
+  /**
+   * @brief reads the source of a shader and inserts preprocessor definitions
+   * @param filename the name of the source file
+   * @param defines the definitions, inserted as "#define ..." lines after the version directive
+   * @return the source code compiled by the shader
+   */
+  static std::string source(const std::string & filename, const std::vector<std::string> & defines);
+
+private:
+  /// builds the shader with the PA1 constructor while the definitions are current
+  Shader(GLenum type, const std::string & filename, const Definitions & definitions);
+
 private:
   uint m_location; ///< GPU location of the shader
 };
 
+/**
+ * @brief A uniform variable of a Program, resolved once (see Program::uniformHandle)
+ *
+ * Setting a uniform through its handle involves no string lookup nor OpenGL query.
+ * The type @a T of the handle is the type of the values it is set with.
+ */
+template <typename T> class UniformHandle {
+public:
+  /**
+   * @brief valid
+   * @return false if the uniform does not exist (setting it is then ignored)
+   */
+  bool valid() const { return m_location >= 0; }
+
+private:
+  friend class Program;
+  int m_location = -1; ///< location of the uniform in its program
+};
+
 /**
  * @brief The Program class.
  *
@@ -288,30 +1011,46 @@ public:
    * 	- attach the fragment and vertex shaders
    * 	- link the program
    * 	- detach the fragment and vertex shaders (so they can be deleted)
+   *
+   * The active uniforms of the linked program are then enumerated once (see Program::uniformHandle).
    */
   Program(const std::string & vname, const std::string & fname);
 
+  /**
+   * @brief Constructs a program from two filenames and preprocessor definitions shared by both shaders
+   *
+   * @param vname filename of the vertex shader
+   * @param fname filename of the fragment shader
+   * @param defines the definitions (see Shader::source)
+   *
+   * The program is built by the constructor above, while the definitions are current (see Shader::Definitions).
+   * Programs are usually obtained from a ProgramCache, so that identical programs are only built once.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  Program(const std::string & vname, const std::string & fname, const std::vector<std::string> & defines);
+
   Program(const Program &) = delete;
   Program & operator=(const Program &) = delete;
 
   /**
    * @brief Destructor
    *
-   * @note PA1: At destruction, GPU memory must be released.
+   * @note PA1: At destruction, GPU memory must be released (and the GLState invalidated, see GLState::invalidate).
    */
   ~Program();
 
   /**
    * @brief binds this Program to the current state
    *
-   * @note PA1
+   * @note PA1: use GLState::useProgram rather than ::glUseProgram (see Program::bound)
    */
   void bind() const override;
 
   /**
    * @brief unbinds this Program from the current state
    *
-   * @note PA1
+   * @note PA1: use GLState::useProgram rather than ::glUseProgram (see Program::bound)
    */
   void unbind() const override;
 
@@ -324,6 +1063,42 @@ public:
    */
   template <typename T> void setUniform(const std::string & name, const T & val) const;
 
+  /**
+   * @brief assigns the value of a uniform variable of this program through its handle (the program must be bound)
+   * @param handle the handle of the uniform variable
+   * @param val the value to be assign
+   *
+   * @note The implementation of this method is already complete.
+   */
+  template <typename T> void setUniform(UniformHandle<T> handle, const T & val) const;
+
+  /**
+   * @brief resolves a uniform variable of this program once for all
+   * @param name the uniform variable name (e.g. "lightsInWorld[1].direction")
+   * @return the handle of the uniform (invalid if it does not exist)
+   *
+   * @note The implementation of this method is already complete.
+   */
+  template <typename T> UniformHandle<T> uniformHandle(const std::string & name) const;
+
+  /**
+   * @brief associates a uniform block of this program with a binding point (see UniformBuffer)
+   * @param blockName the name of the uniform block
+   * @param bindingPoint the binding point
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setUniformBlockBinding(const std::string & blockName, uint bindingPoint) const;
+
+  /**
+   * @brief associates a shader storage block of this program with a binding point (see Buffer::bindBase)
+   * @param blockName the name of the shader storage block
+   * @param bindingPoint the binding point
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setStorageBlockBinding(const std::string & blockName, uint bindingPoint) const;
+
 private:
   /**
    * @brief a template wrapper for glUniform functions
@@ -344,16 +1119,41 @@ private:
    */
   bool getUniformLocation(const std::string & name, int & location) const;
 
+  /**
+   * @brief Retrieves the location of a uniform variable among the active uniforms of this program (no OpenGL query)
+   * @param name the name of the uniform variable
+   * @param location the retrived location
+   * @return true if the uniform is active and false otherwise
+   *
+   * @note The implementation of this method is already complete.
+   */
+  bool findUniformLocation(const std::string & name, int & location) const;
+
+  /**
+   * @brief enumerates the active uniforms of this program (and of the elements of its uniform arrays)
+   *
+   * The locations are retrieved once per uniform by Program::getUniformLocation.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void reflectUniforms() const;
+
   /**
    * @brief bound
-   * @return true if this Program is already bound to the current openGL state
+   * @return true if this Program is already bound to the current openGL state (according to the GLState)
    */
   bool bound() const;
 
 private:
-  uint m_location;  ///< GPU location of the program
-  Shader m_vshader; ///< Vertex shader
-  Shader m_fshader; ///< Fragment shader
+  /// builds the program with the PA1 constructor while the definitions are current
+  Program(const std::string & vname, const std::string & fname, const Shader::Definitions & definitions);
+
+private:
+  uint m_location;                                         ///< GPU location of the program
+  Shader m_vshader;                                        ///< Vertex shader
+  Shader m_fshader;                                        ///< Fragment shader
+  mutable std::unordered_map<std::string, int> m_uniforms; ///< locations of the active uniforms
+  mutable bool m_reflected = false;                        ///< whether m_uniforms has been filled
 };
 
 /**
@@ -377,21 +1177,21 @@ public:
   /**
    * @brief Destructor
    *
-   * @note PA4 (part 1): At destruction, GPU memory must be released.
+   * @note PA4 (part 1): At destruction, GPU memory must be released (and the GLState invalidated, see GLState::invalidate).
    */
   ~Texture();
 
   /**
    * @brief binds this Texture to the current state (more precisely to the currently active texture)
    *
-   * @note PA4 (part1)
+   * @note PA4 (part1): use GLState::bindTexture rather than ::glBindTexture
    */
   void bind() const override;
 
   /**
    * @brief unbinds this Texture
    *
-   * @note PA4 (part 1)
+   * @note PA4 (part 1): use GLState::bindTexture rather than ::glBindTexture
    */
   void unbind() const override;
 
@@ -409,6 +1209,30 @@ public:
    */
   template <typename T> void setData(const Image<T> & image, bool mipmaps = false) const;
 
+  /**
+   * @brief Sends a texture prepared offline (e.g. block compressed by obj2glitter) to the GPU location attached to this instance.
+   * @param texture the levels to be sent, in their own format
+   *
+   * The texture must be a GL_TEXTURE_2D. Block compressed levels are sent with ::glCompressedTexImage2D
+   * and stay compressed in GPU memory (4 to 8 times smaller than RGBA8). Only the levels of @p texture
+   * are defined: no mipmap is generated at runtime (see ::generateMipmaps to precompute them).
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setData(const BakedTexture & texture) const;
+
+  /**
+   * @brief Sends textures of the same size and format as the layers of the array texture attached to this instance.
+   * @param layers the textures (same format, same number of levels, same level sizes)
+   * @param mipmaps toggles mipmap generation (only for RGBA8 layers without precomputed mipmaps)
+   *
+   * The texture must be a GL_TEXTURE_2D_ARRAY. Shaders sample it with a sampler2DArray, the
+   * third texture coordinate being the layer.
+   *
+   * @note The implementation of this method is already complete.
+   */
+  void setLayers(std::span<const BakedTexture> layers, bool mipmaps = false) const;
+
 private:
   uint m_location; ///< GPU location of the texture
   GLenum m_target; ///< Texture target type (e.g. GL_TEXTURE_2D)
@@ -443,21 +1267,21 @@ public:
   /**
    * @brief Destructor
    *
-   * @note PA4 (part 3): At destruction, GPU memory must be released.
+   * @note PA4 (part 3): At destruction, GPU memory must be released (and the GLState invalidated, see GLState::invalidate).
    */
   ~Sampler();
 
   /**
    * @brief binds this Sampler to the current state
    *
-   * @note PA4 (part 3): bind this sampler onto its texture unit
+   * @note PA4 (part 3): bind this sampler onto its texture unit (use GLState::bindSampler rather than ::glBindSampler)
    */
   void bind() const override;
 
   /**
    * @brief unbinds this Sampler from its texture unit
    *
-   * @note PA4 (part 3)
+   * @note PA4 (part 3): use GLState::bindSampler rather than ::glBindSampler
    */
   void unbind() const override;
 
@@ -477,7 +1301,7 @@ public:
    * @brief attaches a texture to this sampler (more precisely to its texture unit)
    * @param texture the target texture
    *
-   * @note PA4 (part 3): this method must activate this Sampler texture unit, and bind the Texture given
+   * @note PA4 (part 3): this method must activate this Sampler texture unit (GLState::activeTexture), and bind the Texture given
    * in parameter
    */
   void attachTexture(const Texture & texture) const;
@@ -511,26 +1335,90 @@ template <typename T> void Buffer::setData(const std::vector<T> & values)
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+template <typename T> void Buffer::setData(std::span<const T> values)
+{
+  setData(std::vector<T>(values.begin(), values.end()));
+}
+
+template <typename T> Std140Writer & Std140Writer::addArray(std::span<const T> values)
+{
+  for (const T & value : values) {
+    beginStruct().add(value).endStruct();
+  }
+  return *this;
+}
+
+template <typename T> VertexLayout & VertexLayout::add(uint attributeIndex, bool normalized)
+{
+  Attribute attribute;
+  attribute.index = attributeIndex;
+  attribute.type = AttributeProperties<T>::typeEnum;
+  attribute.components = AttributeProperties<T>::components;
+  attribute.offset = m_stride;
+  attribute.normalized = normalized ? GL_TRUE : GL_FALSE;
+  m_attributes.push_back(attribute);
+  m_stride += sizeof(T);
+  return *this;
+}
+
 template <typename T> void VAO::setVBO(uint attributeIndex, const std::vector<T> & values)
 {
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+template <typename T> void VAO::setVBO(uint attributeIndex, std::span<const T> values)
+{
+  setVBO(attributeIndex, std::vector<T>(values.begin(), values.end()));
+}
+
 template <typename T> void VAO::setIBO(const std::vector<T> & values)
 {
   FAIL_BECAUSE_INCOMPLETE;
 }
 
+template <typename T> void VAO::setIBO(std::span<const T> values)
+{
+  if constexpr (std::is_same_v<T, glm::uint32>) {
+    bool fitsShort = true;
+    for (glm::uint32 value : values) {
+      fitsShort = fitsShort and value <= 0xFFFF;
+    }
+    if (fitsShort and not values.empty()) {
+      setIBO(std::vector<glm::uint16>(values.begin(), values.end()));
+      return;
+    }
+  }
+  setIBO(std::vector<T>(values.begin(), values.end()));
+}
+
 template <typename T> void Program::setUniform(const std::string & name, const T & val) const
 {
   int location;
-  if (getUniformLocation(name, location) and bound()) {
-    uniformDispatcher<T>(location, val);
-  } else if (not bound()) {
+  if (not bound()) {
     std::cerr << "===== Program is not attached (for uniform '" << name << "')\n";
+  } else if (findUniformLocation(name, location)) {
+    uniformDispatcher<T>(location, val);
   } else {
     std::cerr << "=====" << name << " uniform was queried but does not exist\n";
   }
 }
 
+template <typename T> void Program::setUniform(UniformHandle<T> handle, const T & val) const
+{
+  assert(bound() && "Program::setUniform(): Program is not attached");
+  if (handle.valid()) {
+    uniformDispatcher<T>(handle.m_location, val);
+  }
+}
+
+template <typename T> UniformHandle<T> Program::uniformHandle(const std::string & name) const
+{
+  UniformHandle<T> handle;
+  if (not findUniformLocation(name, handle.m_location)) {
+    std::cerr << "=====" << name << " uniform was queried but does not exist\n";
+    handle.m_location = -1;
+  }
+  return handle;
+}
+
 #endif /* end of include guard: __GLAPI__HPP */